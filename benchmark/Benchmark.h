@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace torrentsync
+{
+namespace benchmark
+{
+
+//! Number of iterations, can be overridden by the first command line argument
+static inline size_t iterations( int argc, char** argv, const size_t fallback )
+{
+    return argc > 1 ? static_cast<size_t>(atol(argv[1])) : fallback;
+}
+
+/** Runs func count times and prints the operations per second.
+ * @param name the benchmark name
+ * @param count the number of times func is called
+ * @param func called with the iteration number
+ * @return the operations per second
+ */
+template <class Function>
+double run( const std::string& name, const size_t count, Function func )
+{
+    typedef std::chrono::steady_clock clock;
+
+    const auto start = clock::now();
+    for( size_t i = 0; i < count; ++i )
+    {
+        func(i);
+    }
+    const std::chrono::duration<double> elapsed = clock::now() - start;
+
+    const double rate = elapsed.count() > 0 ? count / elapsed.count() : 0;
+    std::cout << name << ": " << count << " in " << elapsed.count() << "s, "
+        << static_cast<size_t>(rate) << " ops/sec" << std::endl;
+    return rate;
+}
+
+//! prevents the compiler from optimizing away the computation of value
+template <class T>
+inline void doNotOptimize( const T& value )
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+}; // benchmark
+}; // torrentsync
@@ -0,0 +1,100 @@
+#include <benchmark/Benchmark.h>
+
+#include <torrentsync/dht/Node.h>
+#include <torrentsync/dht/NodeData.h>
+#include <torrentsync/dht/NodeTree.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace torrentsync;
+
+//! Allocates random nodes, adds them to the routing table and looks them
+//! up, plus a random address for each of them, with 10k, 100k and 1M nodes.
+//! The first command line argument overrides the biggest size.
+int main( int argc, char** argv )
+{
+    const size_t sizes[] = { 10000, 100000, benchmark::iterations(argc,argv,1000000) };
+
+    for( const size_t count : sizes )
+    {
+        std::vector<dht::NodeData> ids;
+        ids.reserve(count);
+        for( size_t i = 0; i < count; ++i )
+        {
+            ids.push_back(dht::NodeData::getRandom());
+        }
+
+        std::ostringstream name;
+        name << count;
+
+        // the allocation of the nodes, shared_ptr from the heap and
+        // intrusive from the pool
+        {
+            std::vector<std::shared_ptr<dht::Node> > allocated(count);
+            benchmark::run("make_shared Node " + name.str(), count, [&](size_t i)
+            {
+                allocated[i] = std::make_shared<dht::Node>(ids[i]);
+            });
+        }
+
+        std::vector<dht::NodeSPtr> nodes(count);
+        benchmark::run("makeNode " + name.str(), count, [&](size_t i)
+        {
+            nodes[i] = dht::makeNode(ids[i]);
+        });
+
+        std::vector<dht::NodeData> missing;
+        missing.reserve(count);
+        for( size_t i = 0; i < count; ++i )
+        {
+            missing.push_back(dht::NodeData::getRandom());
+        }
+
+        dht::NodeTree tree(dht::NodeData::getRandom());
+
+        benchmark::run("addNode " + name.str(), count, [&](size_t i)
+        {
+            benchmark::doNotOptimize(tree.addNode(nodes[i]));
+        });
+
+        benchmark::run("getNode " + name.str(), count, [&](size_t i)
+        {
+            benchmark::doNotOptimize(tree.getNode(*nodes[i]));
+        });
+
+        benchmark::run("getNode missing " + name.str(), count, [&](size_t i)
+        {
+            benchmark::doNotOptimize(tree.getNode(missing[i]));
+        });
+
+        // the readers don't lock, the rate should grow with the threads
+        const size_t threads = std::max(2u,std::thread::hardware_concurrency());
+        std::ostringstream threadsName;
+        threadsName << "getNode " << count << " " << threads << " threads";
+        benchmark::run(threadsName.str(), count*threads, [&](size_t i)
+        {
+            // the first call runs all the lookups, the count is for the rate
+            if (i != 0)
+                return;
+            std::vector<std::thread> readers;
+            for( size_t t = 0; t < threads; ++t )
+            {
+                readers.push_back(std::thread([&]()
+                {
+                    for( size_t j = 0; j < count; ++j )
+                        benchmark::doNotOptimize(tree.getNode(*nodes[j]));
+                }));
+            }
+            for( std::thread& reader : readers )
+                reader.join();
+        });
+
+        std::cout << "  " << tree.size() << " nodes stored" << std::endl;
+    }
+
+    return 0;
+}
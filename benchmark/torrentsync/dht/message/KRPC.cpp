@@ -0,0 +1,62 @@
+#include <benchmark/Benchmark.h>
+
+#include <torrentsync/dht/message/BEncodeDecoder.h>
+#include <torrentsync/dht/message/KRPC.h>
+#include <torrentsync/dht/message/Message.h>
+#include <torrentsync/utils/Buffer.h>
+
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
+
+using namespace torrentsync;
+using namespace torrentsync::dht::message;
+
+namespace bio = boost::iostreams;
+
+//! Compares parsing a find_node query through the flattened DataMap with
+//! the schema driven KRPC structure.
+int main( int argc, char** argv )
+{
+    const size_t count = benchmark::iterations(argc,argv,200000);
+
+    const utils::Buffer packet = utils::makeBuffer(
+        "d1:ad2:id20:abcdefghij01234567896:target20:mnopqrstuvwxyz123456e"
+        "1:q9:find_node1:t2:aa1:v4:UT011:y1:qe");
+
+    benchmark::run("DataMap", count, [&](size_t)
+    {
+        bio::array_source source(reinterpret_cast<const char*>(packet.data()),packet.size());
+        bio::stream<bio::array_source> in(source);
+        BEncodeDecoder decoder;
+        decoder.parseMessage(in);
+
+        const DataMap& data = decoder.getData();
+        const bool isQuery = data.find(Field::Type)->second == Type::Query;
+        const std::string prefix = isQuery ? Field::Arguments : Field::Reply;
+        benchmark::doNotOptimize(data.find(Field::TransactionID)->second);
+        benchmark::doNotOptimize(data.find(Field::Query)->second);
+        benchmark::doNotOptimize(data.find(prefix + "/" + Field::PeerID)->second);
+        benchmark::doNotOptimize(data.find(prefix + "/" + Field::Target)->second);
+    });
+
+    BEncodeDecoder decoder;
+    benchmark::run("KRPC", count, [&](size_t)
+    {
+        KRPC message;
+        decoder.parseKRPC(packet.data(),packet.size(),message);
+
+        benchmark::doNotOptimize(*message.y == Type::Query);
+        benchmark::doNotOptimize(*message.txid);
+        benchmark::doNotOptimize(*message.q);
+        benchmark::doNotOptimize(*message.id);
+        benchmark::doNotOptimize(*message.target);
+    });
+
+    benchmark::run("Message::parseMessage", count, [&](size_t)
+    {
+        const auto message = Message::parseMessage(packet);
+        benchmark::doNotOptimize(message->getID());
+    });
+
+    return 0;
+}
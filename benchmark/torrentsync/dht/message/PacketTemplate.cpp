@@ -0,0 +1,47 @@
+#include <benchmark/Benchmark.h>
+
+#include <torrentsync/dht/NodeData.h>
+#include <torrentsync/dht/message/BEncodeEncoder.h>
+#include <torrentsync/dht/message/Message.h>
+#include <torrentsync/dht/message/query/FindNode.h>
+#include <torrentsync/utils/Buffer.h>
+
+using namespace torrentsync;
+using namespace torrentsync::dht::message;
+
+//! Compares encoding a find_node query field by field with patching the
+//! pre-encoded packet template.
+int main( int argc, char** argv )
+{
+    const size_t count = benchmark::iterations(argc,argv,1000000);
+
+    const dht::NodeData source = dht::NodeData::getRandom();
+    const dht::NodeData target = dht::NodeData::getRandom();
+    const utils::Buffer transaction = utils::makeBuffer("aa");
+
+    uint8_t output[256];
+
+    benchmark::run("BEncodeEncoder", count, [&](size_t)
+    {
+        BEncodeEncoder enc(output,sizeof(output));
+        enc.startDictionary();
+        enc.addElement(Field::Arguments);
+        enc.startDictionary();
+        source.writeTo(enc.reserveDictionaryElement(Field::PeerID,dht::NodeData::addressDataLength));
+        target.writeTo(enc.reserveDictionaryElement(Field::Target,dht::NodeData::addressDataLength));
+        enc.endDictionary();
+        enc.addDictionaryElement(Field::Query,Messages::FindNode);
+        enc.addDictionaryElement(Field::TransactionID,transaction);
+        enc.addDictionaryElement(Field::Type,Type::Query);
+        enc.endDictionary();
+        benchmark::doNotOptimize(output);
+    });
+
+    benchmark::run("PacketTemplate", count, [&](size_t)
+    {
+        query::FindNode::make(output,sizeof(output),transaction,source,target);
+        benchmark::doNotOptimize(output);
+    });
+
+    return 0;
+}
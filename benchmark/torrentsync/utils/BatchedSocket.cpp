@@ -0,0 +1,129 @@
+#include <benchmark/Benchmark.h>
+
+#include <torrentsync/dht/DHTConstants.h>
+#include <torrentsync/utils/BatchedSocket.h>
+#include <torrentsync/utils/Buffer.h>
+
+#include <functional>
+#include <iostream>
+#include <memory>
+
+using namespace torrentsync;
+using boost::asio::ip::udp;
+
+//! datagrams in flight, well below what the socket buffers hold
+static const size_t WINDOW = 64;
+
+//! size of the datagrams, a find_node reply is around 200 bytes
+static const size_t DATAGRAM_SIZE = 200;
+
+//! a socket bound to a random port of the loopback
+static void bindLoopback( udp::socket& socket )
+{
+    socket.open(udp::v4());
+    socket.bind(udp::endpoint(boost::asio::ip::address_v4::loopback(),0));
+}
+
+//! the previous path: a receive and a send per datagram, with a new
+//! buffer for each receive
+class PerDatagram
+{
+public:
+    PerDatagram( udp::socket& in, udp::socket& out ) : _in(in), _out(out), received(0) {}
+
+    void receive()
+    {
+        std::shared_ptr<utils::Buffer> buff(new utils::Buffer(MESSAGE_BUFFER_SIZE,0));
+        std::shared_ptr<udp::endpoint> sender(new udp::endpoint());
+        _in.async_receive_from(boost::asio::buffer(*buff),*sender,
+            [this,buff,sender]( const boost::system::error_code& error, size_t )
+            {
+                if (error)
+                    return;
+                ++received;
+                receive();
+            });
+    }
+
+    void send( const utils::Buffer& buff, const udp::endpoint& to )
+    {
+        _out.async_send_to(boost::asio::buffer(buff),to,
+            [buff]( const boost::system::error_code&, size_t ) {});
+    }
+
+private:
+    udp::socket& _in;
+    udp::socket& _out;
+
+public:
+    size_t received;
+};
+
+//! sends WINDOW datagrams at a time and waits for them
+template <class Send>
+static void pingPong(
+    const std::string& name,
+    const size_t count,
+    boost::asio::io_service& service,
+    const size_t& received,
+    Send send )
+{
+    benchmark::run(name, count, [&](size_t i)
+    {
+        // the first datagram of a window runs all of it, the count is for the rate
+        if (i % WINDOW != 0)
+            return;
+        const size_t window = std::min(WINDOW,count-i);
+        for( size_t j = 0; j < window; ++j )
+            send();
+        while (received < i+window)
+            service.run_one();
+    });
+}
+
+//! Sends datagrams between 2 sockets on the loopback, a datagram per system
+//! call and in batches. The first command line argument is the number of
+//! datagrams.
+int main( int argc, char** argv )
+{
+    const size_t count = benchmark::iterations(argc,argv,200000);
+    const utils::Buffer datagram(DATAGRAM_SIZE,'d');
+
+    {
+        boost::asio::io_service service;
+        udp::socket in(service), out(service);
+        bindLoopback(in);
+        bindLoopback(out);
+        const udp::endpoint to = in.local_endpoint();
+
+        PerDatagram path(in,out);
+        path.receive();
+        pingPong("per datagram", count, service, path.received,
+            [&]() { path.send(datagram,to); });
+    }
+
+    for( const size_t batch : { static_cast<size_t>(8), utils::BatchedSocket::DEFAULT_BATCH_SIZE } )
+    {
+        boost::asio::io_service service;
+        udp::socket in(service), out(service);
+        bindLoopback(in);
+        bindLoopback(out);
+        const udp::endpoint to = in.local_endpoint();
+
+        utils::BatchedSocket batchIn(in,MESSAGE_BUFFER_SIZE,utils::SendQueue::Config(WINDOW),batch);
+        utils::BatchedSocket batchOut(out,MESSAGE_BUFFER_SIZE,utils::SendQueue::Config(WINDOW),batch);
+        size_t received = 0;
+        batchIn.startReceive([&](
+            const boost::system::error_code& error,
+            const utils::ReceiveRing::Slot&)
+            {
+                if (!error)
+                    ++received;
+            });
+
+        pingPong("batch of " + std::to_string(batch), count, service, received,
+            [&]() { batchOut.send(datagram,to); });
+    }
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/dht/EndpointIndex.h>
+
+#include <vector>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_dht_EndpointIndex);
+
+using namespace torrentsync;
+using namespace torrentsync::dht;
+
+namespace
+{
+NodeSPtr newNode( const uint32_t address, const uint16_t port )
+{
+    return NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode()),
+        udp::endpoint(boost::asio::ip::address_v4(address),port)));
+}
+};
+
+BOOST_AUTO_TEST_CASE(insert_find_erase)
+{
+    EndpointIndex index(4);
+    BOOST_REQUIRE_EQUAL(index.capacity(),4);
+
+    // close addresses and ports, to make clusters
+    std::vector<NodeSPtr> nodes;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        nodes.push_back(newNode(0x7F000001+i/4,1000+i%4));
+        BOOST_REQUIRE(index.insert(nodes.back()));
+    }
+    BOOST_REQUIRE_EQUAL(index.size(),TEST_LOOP_COUNT);
+    BOOST_REQUIRE(index.capacity() >= 2*TEST_LOOP_COUNT);
+
+    for( const NodeSPtr& node : nodes )
+    {
+        const auto found = index.find(*node->getEndpoint());
+        BOOST_REQUIRE(!!found);
+        BOOST_REQUIRE_EQUAL(found->get(),node.get());
+    }
+
+    // every other one removed, the others must still be found
+    for( size_t i = 0; i < nodes.size(); i += 2 )
+    {
+        BOOST_REQUIRE(index.erase(*nodes[i]));
+        BOOST_REQUIRE(!index.erase(*nodes[i]));
+    }
+    BOOST_REQUIRE_EQUAL(index.size(),TEST_LOOP_COUNT/2);
+    for( size_t i = 0; i < nodes.size(); ++i )
+    {
+        const auto found = index.find(*nodes[i]->getEndpoint());
+        BOOST_REQUIRE_EQUAL(!!found,i%2 == 1);
+        if (!!found)
+            BOOST_REQUIRE_EQUAL(found->get(),nodes[i].get());
+    }
+
+    index.clear();
+    BOOST_REQUIRE_EQUAL(index.size(),0);
+    BOOST_REQUIRE(!index.find(*nodes[1]->getEndpoint()));
+}
+
+BOOST_AUTO_TEST_CASE(same_endpoint)
+{
+    EndpointIndex index;
+    const NodeSPtr first  = newNode(0x0A000001,6881);
+    const NodeSPtr second = newNode(0x0A000001,6881);
+
+    BOOST_REQUIRE(index.insert(first));
+    BOOST_REQUIRE(index.insert(second));
+    BOOST_REQUIRE_EQUAL(index.size(),1);
+    BOOST_REQUIRE_EQUAL(index.find(*first->getEndpoint())->get(),second.get());
+
+    // the replaced node doesn't remove the new one
+    BOOST_REQUIRE(!index.erase(*first));
+    BOOST_REQUIRE(index.erase(*second));
+    BOOST_REQUIRE(!index.find(*first->getEndpoint()));
+}
+
+BOOST_AUTO_TEST_CASE(not_indexed)
+{
+    EndpointIndex index;
+    const NodeSPtr node(new Node(utils::parseIDFromHex(generateRandomNode())));
+    BOOST_REQUIRE(!index.insert(node));
+    BOOST_REQUIRE(!index.erase(*node));
+    BOOST_REQUIRE(!index.find(udp::endpoint(boost::asio::ip::address_v6::loopback(),6881)));
+    BOOST_REQUIRE_EQUAL(index.size(),0);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -155,5 +155,35 @@ BOOST_AUTO_TEST_CASE(serialization)
     BOOST_CHECK(data == node2.getPackedNode());
 }
 
+BOOST_AUTO_TEST_CASE(compact_endpoint)
+{
+    const dht::NodeData id = utils::parseIDFromHex(generateRandomNode());
+    const boost::asio::ip::udp::endpoint endpoint(
+        boost::asio::ip::address_v4(0x01020304),0x0506);
+
+    const dht::NodeSPtr node = dht::makeNode(id,endpoint);
+    BOOST_REQUIRE(*node == id);
+    BOOST_REQUIRE(!!node->getEndpoint());
+    BOOST_REQUIRE_EQUAL(*node->getEndpoint(),endpoint);
+    BOOST_REQUIRE(!dht::makeNode(id)->getEndpoint());
+
+    // the reference count is in the node, shared through a single pointer
+    BOOST_REQUIRE_LT(sizeof(dht::Node),48);
+    BOOST_REQUIRE_EQUAL(sizeof(dht::NodeSPtr),sizeof(void*));
+
+    const size_t used = utils::PoolAllocator<dht::Node>::pool().used();
+    {
+        dht::NodeSPtr copy = dht::makeNode(id);
+        const dht::NodeSPtr other = copy;
+        BOOST_REQUIRE_EQUAL(utils::PoolAllocator<dht::Node>::pool().used(),used+1);
+        copy.reset();
+        BOOST_REQUIRE_EQUAL(utils::PoolAllocator<dht::Node>::pool().used(),used+1);
+    }
+    BOOST_REQUIRE_EQUAL(utils::PoolAllocator<dht::Node>::pool().used(),used);
+
+    BOOST_REQUIRE_THROW(dht::Node(id,boost::asio::ip::udp::endpoint(
+        boost::asio::ip::address_v6::loopback(),1)),std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
@@ -43,7 +43,7 @@ BOOST_AUTO_TEST_CASE(constructor)
     for ( int i = 0; i < TEST_LOOP_COUNT; ++i )
     {
         const std::string str = generateRandomNode();
-        std::shared_ptr<Node> addr(new Node(utils::parseIDFromHex(str)));
+        NodeSPtr addr(new Node(utils::parseIDFromHex(str)));
         BOOST_REQUIRE_EQUAL(true,bucket.inBounds(addr));
     }
 
@@ -68,7 +68,7 @@ BOOST_AUTO_TEST_CASE(outside)
     for ( int i = 0; i < TEST_LOOP_COUNT; ++i )
     {
         std::string str = generateRandomNode("F");
-        std::shared_ptr<Node> addr(new Node(utils::parseIDFromHex(str)));
+        NodeSPtr addr(new Node(utils::parseIDFromHex(str)));
         BOOST_REQUIRE_EQUAL(false,bucket.inBounds(addr));
     }
 
@@ -92,7 +92,7 @@ BOOST_AUTO_TEST_CASE(inside)
     for ( int i = 0; i < TEST_LOOP_COUNT; ++i )
     {
         std::string str = generateRandomNode("000002003400");
-        std::shared_ptr<Node> addr(new Node(utils::parseIDFromHex(str)));
+        NodeSPtr addr(new Node(utils::parseIDFromHex(str)));
         BOOST_REQUIRE_EQUAL(true,bucket.inBounds(addr));
     }
 
@@ -127,27 +127,27 @@ BOOST_AUTO_TEST_CASE(add_remove)
     {
         NodeBucket<10> bucket(bot,top);
 
-        std::vector<std::shared_ptr<Node> > addresses;
+        std::vector<NodeSPtr > addresses;
 
         for( int i = 0; i < 10; ++i)
         {
-            std::shared_ptr<Node> a = std::shared_ptr<Node>(new Node(utils::parseIDFromHex(generateRandomNode("0"))));
+            NodeSPtr a = NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode("0"))));
             addresses.push_back(a);
             BOOST_REQUIRE_NO_THROW(BOOST_REQUIRE(bucket.add(a)));
-            std::shared_ptr<Node> f = std::shared_ptr<Node>(new Node(utils::parseIDFromHex(generateRandomNode("F"))));
+            NodeSPtr f = NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode("F"))));
             BOOST_REQUIRE_THROW(bucket.add(f),std::invalid_argument);
 
-            std::for_each( addresses.begin(), addresses.end(), [&] (const std::shared_ptr<Node>& va)
+            std::for_each( addresses.begin(), addresses.end(), [&] (const NodeSPtr& va)
             {
                 BOOST_REQUIRE(std::find(bucket.cbegin(), bucket.cend(), va ) != bucket.cend());
             });
             BOOST_REQUIRE_EQUAL(bucket.size(),i+1);
         }
-        std::shared_ptr<Node> a = std::shared_ptr<Node>(new Node(utils::parseIDFromHex(generateRandomNode("0"))));
+        NodeSPtr a = NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode("0"))));
         BOOST_REQUIRE_EQUAL(false,bucket.add(a));
         BOOST_REQUIRE_EQUAL(bucket.size(),10);
 
-        std::for_each( addresses.begin(), addresses.end(), [&] (const std::shared_ptr<Node>& va)
+        std::for_each( addresses.begin(), addresses.end(), [&] (const NodeSPtr& va)
         {
             BOOST_REQUIRE(std::find( bucket.cbegin(), bucket.cend(), va ) != bucket.cend());
         });
@@ -157,15 +157,15 @@ BOOST_AUTO_TEST_CASE(add_remove)
             BOOST_REQUIRE(addresses.size() > 0);
             const int index = rand()%addresses.size();
             const int start_size = addresses.size();
-            std::shared_ptr<Node> a = addresses[index];
+            NodeSPtr a = addresses[index];
             addresses.erase(addresses.begin()+index);
-            BOOST_REQUIRE(a.get() > 0);
+            BOOST_REQUIRE(a.get() != nullptr);
 
             BOOST_REQUIRE_NO_THROW(
                     BOOST_REQUIRE(bucket.remove(*a)));
             BOOST_REQUIRE_EQUAL( bucket.size(), start_size-1);
 
-            std::for_each( addresses.begin(), addresses.end(), [&] (const std::shared_ptr<Node>& va)
+            std::for_each( addresses.begin(), addresses.end(), [&] (const NodeSPtr& va)
             {
                 BOOST_REQUIRE(std::find(bucket.cbegin(), bucket.cend(), va ) != bucket.cend());
             });
@@ -181,8 +181,8 @@ class FakeNode : public Node
 public:
     FakeNode( const std::string& str ) : Node( utils::parseIDFromHex(str)) {}
     
-    time_t& getTime() { return Node::_last_time_good; }
-    size_t& getLastUnansweredQueries() { return Node::_last_unanswered_queries; }
+    uint32_t& getTime() { return Node::_last_time_good; }
+    uint16_t& getLastUnansweredQueries() { return Node::_last_unanswered_queries; }
 };
 
 BOOST_AUTO_TEST_CASE(removeBad)
@@ -192,20 +192,20 @@ BOOST_AUTO_TEST_CASE(removeBad)
 
     for ( int i = 0; i < TEST_LOOP_COUNT; ++i )
     {
-        std::vector<std::shared_ptr<Node> > addresses;
+        std::vector<NodeSPtr > addresses;
 
         for( int i = 0; i < 10; ++i)
         {
-            std::shared_ptr<Node> a = std::shared_ptr<Node>(new FakeNode(generateRandomNode()));
+            NodeSPtr a = NodeSPtr(new FakeNode(generateRandomNode()));
             addresses.push_back(a);
         }
 
         for( int j = 0; j < TEST_LOOP_COUNT; ++j )
         {
             NodeBucket<10> bucket(bot,top);
-            std::for_each( addresses.begin(), addresses.end(), [&] (std::shared_ptr<Node>& a)
+            std::for_each( addresses.begin(), addresses.end(), [&] (NodeSPtr& a)
             {   // deep copy into bucket
-                std::shared_ptr<Node> new_a(new Node(*a));
+                NodeSPtr new_a(new Node(*a));
                 BOOST_REQUIRE_NO_THROW(BOOST_REQUIRE(bucket.add(new_a)));
             });
 
@@ -215,7 +215,7 @@ BOOST_AUTO_TEST_CASE(removeBad)
             int setbad = 0;
             for( int bad = 0; bad < setbad_count; ++bad)
             {
-                std::shared_ptr<Node> a = *(bucket.cbegin()+rand()%bucket.size());
+                NodeSPtr a = *(bucket.cbegin()+rand()%bucket.size());
                 FakeNode* af = reinterpret_cast<FakeNode*>(a.get());
                 if (af->getTime() > 0)
                     ++setbad;
@@ -236,20 +236,20 @@ BOOST_AUTO_TEST_CASE(removeBad_2)
 
     for ( int i = 0; i < TEST_LOOP_COUNT; ++i )
     {
-        std::vector<std::shared_ptr<Node> > addresses;
+        std::vector<NodeSPtr > addresses;
 
         for( int i = 0; i < 10; ++i)
         {
-            std::shared_ptr<Node> a = std::shared_ptr<Node>(new FakeNode(generateRandomNode()));
+            NodeSPtr a = NodeSPtr(new FakeNode(generateRandomNode()));
             addresses.push_back(a);
         }
 
         NodeBucket<10> bucket(bot,top);
         while (bucket.size() > 0)
         {
-            std::for_each( addresses.begin(), addresses.end(), [&] (std::shared_ptr<Node>& a)
+            std::for_each( addresses.begin(), addresses.end(), [&] (NodeSPtr& a)
             {   // deep copy into bucket
-                std::shared_ptr<Node> new_a(new Node(*a));
+                NodeSPtr new_a(new Node(*a));
                 BOOST_REQUIRE_NO_THROW(BOOST_REQUIRE(bucket.add(new_a)));
             });
 
@@ -259,7 +259,7 @@ BOOST_AUTO_TEST_CASE(removeBad_2)
             int setbad = 0;
             for( int bad = 0; bad < setbad_count; ++bad)
             {
-                std::shared_ptr<Node> a = *(bucket.cbegin()+rand()%bucket.size());
+                NodeSPtr a = *(bucket.cbegin()+rand()%bucket.size());
                 FakeNode* af = reinterpret_cast<FakeNode*>(a.get());
                 if (af->getTime() > 0)
                     ++setbad;
@@ -294,7 +294,7 @@ BOOST_AUTO_TEST_CASE(addIsSorted)
         NodeBucket<10> bucket(bot,top);
         std::for_each( addresses.begin(), addresses.end(), [&] (const Node& addr)
         {
-            std::shared_ptr<Node> a(new Node(addr));
+            NodeSPtr a(new Node(addr));
             bucket.add(a);
         });
         std::vector<Node>::iterator it2 = sorted_addresses.begin();
@@ -324,7 +324,7 @@ BOOST_AUTO_TEST_CASE(addIsSortedRandom)
         NodeBucket<10> bucket(bot,top);
         std::for_each( addresses.begin(), addresses.end(), [&] (const Node& addr)
         {
-            std::shared_ptr<Node> a(new Node(addr));
+            NodeSPtr a(new Node(addr));
             bucket.add(a);
         });
         std::vector<Node>::iterator it2 = sorted_addresses.begin();
@@ -355,7 +355,7 @@ BOOST_AUTO_TEST_CASE(add_and_find)
         NodeBucket<10> bucket(bot,top);
         std::for_each( addresses.begin(), addresses.end(), [&] (const Node& addr)
         {
-            std::shared_ptr<Node> a(new Node(addr));
+            NodeSPtr a(new Node(addr));
             bucket.add(a);
         });
         std::for_each( addresses.begin(), addresses.end(), [&] (const Node& addr)
@@ -392,7 +392,7 @@ BOOST_AUTO_TEST_CASE(addRandom_and_find)
         NodeBucket<10> bucket(bot,top);
         std::for_each( addresses.begin(), addresses.end(), [&] (const Node& addr)
         {
-            std::shared_ptr<Node> a(new Node(addr));
+            NodeSPtr a(new Node(addr));
             bucket.add(a);
         });
         std::for_each( addresses.begin(), addresses.end(), [&] (const Node& addr)
@@ -411,4 +411,148 @@ BOOST_AUTO_TEST_CASE(addRandom_and_find)
     }
 }
 
+template <size_t Size>
+static void fillFindRemove( const std::string& prefix )
+{
+    NodeData bot = utils::parseIDFromHex("0000000000000000000000000000000000000000");
+    NodeData top = utils::parseIDFromHex("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+
+    NodeBucket<Size> bucket(bot,top);
+    std::vector<NodeSPtr> v;
+    while (v.size() < Size)
+    {
+        NodeSPtr n(new Node(utils::parseIDFromHex(generateRandomNode(prefix))));
+        if (!bucket.find(*n))
+        {
+            BOOST_REQUIRE(bucket.add(n));
+            v.push_back(n);
+        }
+    }
+
+    for( size_t i = 0; i < bucket.size(); ++i )
+    {
+        BOOST_REQUIRE_EQUAL(bucket.getID(i),**(bucket.cbegin()+i));
+        if (i > 0)
+            BOOST_REQUIRE_LT(bucket.getID(i-1),bucket.getID(i));
+    }
+
+    std::random_shuffle(v.begin(),v.end());
+    while (!v.empty())
+    {
+        for( const NodeSPtr& n : v )
+        {
+            boost::optional<NodeSPtr> b = bucket.find(*n);
+            BOOST_REQUIRE(!!b);
+            BOOST_REQUIRE_EQUAL(b->get(),n.get());
+        }
+        BOOST_REQUIRE(bucket.remove(*v.back()));
+        BOOST_REQUIRE(!bucket.find(*v.back()));
+        BOOST_REQUIRE(!bucket.remove(*v.back()));
+        v.pop_back();
+        BOOST_REQUIRE_EQUAL(bucket.size(),v.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(inline_scan)
+{
+    for( int i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        // unrolled scans
+        fillFindRemove<8>("");
+        fillFindRemove<16>("");
+        fillFindRemove<32>("");
+        // generic scan
+        fillFindRemove<10>("");
+
+        // same first 64 bits, the prefix scan matches every node
+        fillFindRemove<8>("0123456789abcdef");
+        fillFindRemove<32>("0123456789abcdef");
+        fillFindRemove<10>("0123456789abcdef");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(replacements)
+{
+    NodeData bot = utils::parseIDFromHex("0000000000000000000000000000000000000000");
+    NodeData top = utils::parseIDFromHex("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+
+    for( int loop = 0; loop < TEST_LOOP_COUNT; ++loop )
+    {
+        NodeBucket<8> bucket(bot,top);
+        std::vector<NodeSPtr> nodes;
+        while (bucket.size() < bucket.maxSize())
+        {
+            NodeSPtr n(new Node(utils::parseIDFromHex(generateRandomNode())));
+            BOOST_REQUIRE(bucket.add(n));
+            nodes.push_back(n);
+        }
+
+        // nodes in the bucket are not candidates
+        bucket.addReplacement(nodes[0]);
+        BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),0);
+
+        std::vector<NodeSPtr> candidates;
+        for( int i = 0; i < 12; ++i )
+        {
+            NodeSPtr n(new Node(utils::parseIDFromHex(generateRandomNode())));
+            BOOST_REQUIRE(!bucket.add(n));
+            bucket.addReplacement(n);
+            candidates.push_back(n);
+        }
+
+        // bounded, the oldest dropped
+        BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),8);
+        BOOST_REQUIRE_EQUAL(bucket.getReplacement(0).get(),candidates[4].get());
+        BOOST_REQUIRE_EQUAL(bucket.getReplacement(7).get(),candidates[11].get());
+
+        // seen again, it becomes the freshest
+        bucket.addReplacement(candidates[5]);
+        BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),8);
+        BOOST_REQUIRE_EQUAL(bucket.getReplacement(7).get(),candidates[5].get());
+        BOOST_REQUIRE_EQUAL(bucket.getReplacement(1).get(),candidates[6].get());
+
+        // a missing node doesn't promote
+        BOOST_REQUIRE(!bucket.replace(*candidates[0]));
+        BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),8);
+
+        boost::optional<NodeSPtr> promoted = bucket.replace(*nodes[3]);
+        BOOST_REQUIRE(!!promoted);
+        BOOST_REQUIRE_EQUAL(promoted->get(),candidates[5].get());
+        BOOST_REQUIRE(!bucket.find(*nodes[3]));
+        BOOST_REQUIRE(!!bucket.find(*candidates[5]));
+        BOOST_REQUIRE_EQUAL(bucket.size(),8);
+        BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),7);
+
+        promoted = bucket.replace(*nodes[4]);
+        BOOST_REQUIRE(!!promoted);
+        BOOST_REQUIRE_EQUAL(promoted->get(),candidates[11].get());
+
+        bucket.clear();
+        BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(replacements_skip_bad)
+{
+    NodeData bot = utils::parseIDFromHex("0000000000000000000000000000000000000000");
+    NodeData top = utils::parseIDFromHex("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+
+    NodeBucket<8> bucket(bot,top);
+    NodeSPtr node(new Node(utils::parseIDFromHex(generateRandomNode())));
+    BOOST_REQUIRE(bucket.add(node));
+
+    boost::intrusive_ptr<FakeNode> good(new FakeNode(generateRandomNode()));
+    boost::intrusive_ptr<FakeNode> bad(new FakeNode(generateRandomNode()));
+    bucket.addReplacement(good);
+    bucket.addReplacement(bad);
+    bad->getTime() = 0;
+    bad->getLastUnansweredQueries() = Node::allowed_unanswered_queries+1;
+
+    boost::optional<NodeSPtr> promoted = bucket.replace(*node);
+    BOOST_REQUIRE(!!promoted);
+    BOOST_REQUIRE_EQUAL(promoted->get(),good.get());
+    BOOST_REQUIRE_EQUAL(bucket.replacementsSize(),0);
+    BOOST_REQUIRE_EQUAL(bucket.size(),1);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
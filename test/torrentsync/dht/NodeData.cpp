@@ -3,6 +3,7 @@
 #include <boost/algorithm/string.hpp>
 #include <cstdlib>
 #include <sstream>
+#include <algorithm>
 
 #include <stdexcept>
 #include <torrentsync/dht/NodeData.h>
@@ -207,5 +208,88 @@ BOOST_AUTO_TEST_CASE(bytestring_parsing_special)
     BOOST_REQUIRE(b == s);
 }
 
+BOOST_AUTO_TEST_CASE(unaligned_read_write)
+{
+    const utils::Buffer s =
+        {'1','2','3','4','5','6','7','8','a','b','c','d','e','f','g','h','A','B','C','D'};
+    for( size_t offset = 0; offset < 8; ++offset )
+    {
+        uint8_t data[NodeData::addressDataLength+8] = {0};
+        std::copy(s.begin(),s.end(),data+offset);
+
+        NodeData d;
+        d.readFrom(data+offset);
+        BOOST_REQUIRE(d.write() == s);
+
+        uint8_t out[NodeData::addressDataLength+8] = {0};
+        d.writeTo(out+offset);
+        BOOST_REQUIRE(std::equal(s.begin(),s.end(),out+offset));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(common_prefix_length)
+{
+    const NodeData a = utils::parseIDFromHex("0000000000000000000000000000000000000000");
+    BOOST_REQUIRE_EQUAL(a.commonPrefixLength(a),NodeData::ADDRESS_BITS);
+    BOOST_REQUIRE_EQUAL(a.commonPrefixLength(NodeData::maxValue),0);
+
+    BOOST_REQUIRE_EQUAL(a.commonPrefixLength(
+        utils::parseIDFromHex("0100000000000000000000000000000000000000")),7);
+    BOOST_REQUIRE_EQUAL(a.commonPrefixLength(
+        utils::parseIDFromHex("0000000000000000100000000000000000000000")),67);
+    BOOST_REQUIRE_EQUAL(a.commonPrefixLength(
+        utils::parseIDFromHex("0000000000000000000000000000000080000000")),128);
+    BOOST_REQUIRE_EQUAL(a.commonPrefixLength(
+        utils::parseIDFromHex("0000000000000000000000000000000000000001")),159);
+
+    for( int i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const NodeData x = utils::parseIDFromHex(generateRandomNode());
+        const NodeData y = utils::parseIDFromHex(generateRandomNode());
+        BOOST_REQUIRE_EQUAL(x.commonPrefixLength(y),y.commonPrefixLength(x));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(random_at_prefix)
+{
+    for( int i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const NodeData x = utils::parseIDFromHex(generateRandomNode());
+        for( size_t prefix = 0; prefix <= NodeData::ADDRESS_BITS; ++prefix )
+        {
+            BOOST_REQUIRE_EQUAL(x.commonPrefixLength(x.getRandomAtPrefix(prefix)),prefix);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(random_in_range)
+{
+    for( int i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        NodeData low = utils::parseIDFromHex(generateRandomNode());
+        NodeData high = utils::parseIDFromHex(generateRandomNode());
+        if (low > high)
+            std::swap(low,high);
+
+        const NodeData random = NodeData::getRandomInRange(low,high);
+        BOOST_REQUIRE(low <= random);
+        BOOST_REQUIRE(random <= high);
+
+        // a range narrower than the low bits
+        const NodeData near = low.getRandomAtPrefix(NodeData::ADDRESS_BITS-3);
+        const NodeData& first = std::min(low,near);
+        const NodeData& last = std::max(low,near);
+        const NodeData small = NodeData::getRandomInRange(first,last);
+        BOOST_REQUIRE(first <= small);
+        BOOST_REQUIRE(small <= last);
+
+        BOOST_REQUIRE(NodeData::getRandomInRange(low,low) == low);
+        BOOST_REQUIRE_THROW(NodeData::getRandomInRange(high,low),std::invalid_argument);
+    }
+
+    // the whole address space
+    NodeData::getRandomInRange(NodeData::minValue,NodeData::maxValue);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
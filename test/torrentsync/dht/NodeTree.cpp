@@ -8,6 +8,9 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
 
+#include <atomic>
+#include <thread>
+
 using namespace torrentsync;
 
 namespace
@@ -426,7 +429,7 @@ BOOST_AUTO_TEST_CASE(getClosestNode_1)
         });
         BOOST_REQUIRE_EQUAL(size(),v.size());
 
-        std::list<NodeSPtr> nodes = getClosestNodes(utils::parseIDFromHex(generateRandomNode()));
+        ClosestNodes nodes = getClosestNodes(utils::parseIDFromHex(generateRandomNode()));
         BOOST_REQUIRE_LE(nodes.size(),DHT_FIND_NODE_COUNT);
         clear();
     }
@@ -447,7 +450,7 @@ BOOST_AUTO_TEST_CASE(getClosestNode_2)
 
         // take a random address and get the close nodes
         Node addr = utils::parseIDFromHex(generateRandomNode());
-        std::list<NodeSPtr> nodes = getClosestNodes(addr);
+        ClosestNodes nodes = getClosestNodes(addr);
 
         // sort the nodes for easy search
         std::sort(v.begin(),v.end(),[](const NodeSPtr& a, const NodeSPtr& b){
@@ -491,11 +494,213 @@ BOOST_AUTO_TEST_CASE(getClosestNode_perfectmatch)
         BOOST_REQUIRE_EQUAL(size(),v.size());
 
         // take a random address and get the close nodes
-        std::list<NodeSPtr> nodes = getClosestNodes(*v[rand()%v.size()]);
+        ClosestNodes nodes = getClosestNodes(*v[rand()%v.size()]);
         BOOST_REQUIRE_LE(nodes.size(),1);
         
         clear();
     }
 }
 
+BOOST_AUTO_TEST_CASE(buckets_by_prefix)
+{
+    // buckets are split only towards our own address, so every stored node
+    // must be found through its common prefix with it
+    for( size_t _i = 0; _i < TEST_LOOP_COUNT; ++_i )
+    {
+        std::vector<NodeSPtr> v;
+        for( size_t _t = 0; _t < 1000; ++_t )
+        {
+            NodeSPtr n = NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode())));
+            if (addNode(n))
+                v += n;
+        }
+        BOOST_REQUIRE_EQUAL(size(),v.size());
+        BOOST_REQUIRE_GT(getBucketsCount(),1);
+        BOOST_REQUIRE_LE(getBucketsCount(),NodeData::ADDRESS_BITS+1);
+
+        for( const NodeSPtr& n : v )
+        {
+            const size_t index = findBucket(*n);
+            BOOST_REQUIRE_LT(index,getBucketsCount());
+            if (index < getBucketsCount()-1)
+                BOOST_REQUIRE_EQUAL(getTableNode().commonPrefixLength(*n),index);
+            BOOST_REQUIRE(!!getNode(*n));
+        }
+
+        BOOST_REQUIRE_EQUAL(findBucket(getTableNode()),getBucketsCount()-1);
+        clear();
+        BOOST_REQUIRE_EQUAL(getBucketsCount(),1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(getClosestNode_exact)
+{
+    for( size_t _i = 0; _i < TEST_LOOP_COUNT; ++_i )
+    {
+        std::vector<NodeSPtr> v;
+        const size_t count = rand()%2000;
+        for( size_t _t = 0; _t < count; ++_t )
+        {
+            NodeSPtr n = NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode())));
+            if (addNode(n))
+                v += n;
+        }
+
+        // the target is sometimes close to our own address, to reach the
+        // deepest buckets
+        const NodeData target = _i%2 ? getTableNode() ^
+            NodeData(utils::parseIDFromHex(generateRandomNode("00000"))) :
+            NodeData(utils::parseIDFromHex(generateRandomNode()));
+
+        // the brute force result
+        std::sort(v.begin(),v.end(),[&](const NodeSPtr& a, const NodeSPtr& b){
+                return (*a ^ target) < (*b ^ target);
+            });
+        if (!v.empty() && *v.front() == target)
+            v.resize(1);
+
+        const ClosestNodes nodes = getClosestNodes(target);
+        BOOST_REQUIRE_EQUAL(nodes.size(),std::min(v.size(),(size_t)DHT_FIND_NODE_COUNT));
+        for( size_t i = 0; i < nodes.size(); ++i )
+        {
+            BOOST_REQUIRE_EQUAL(*nodes[i],*v[i]);
+        }
+
+        clear();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_readers)
+{
+    std::vector<NodeSPtr> v;
+    for( size_t i = 0; i < 2000; ++i )
+    {
+        v.push_back(NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode()))));
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> errors(0);
+    std::vector<std::thread> readers;
+    for( int i = 0; i < 4; ++i )
+    {
+        readers.push_back(std::thread([&]()
+        {
+            size_t j = 0;
+            while (!stop)
+            {
+                const NodeData& target = *v[j++ % v.size()];
+                const boost::optional<NodeSPtr> node = getNode(target);
+                if (!!node && **node != target)
+                    ++errors;
+                if (getClosestNodes(target).size() > DHT_FIND_NODE_COUNT)
+                    ++errors;
+            }
+        }));
+    }
+
+    std::vector<NodeSPtr> added;
+    for( const NodeSPtr& n : v )
+    {
+        if (addNode(n))
+            added.push_back(n);
+    }
+    for( size_t i = 0; i < added.size(); i += 2 )
+    {
+        removeNode(added[i]);
+    }
+
+    stop = true;
+    for( std::thread& reader : readers )
+        reader.join();
+
+    BOOST_REQUIRE_EQUAL(errors,0);
+    BOOST_REQUIRE_EQUAL(size(),added.size()/2);
+    for( size_t i = 0; i < added.size(); ++i )
+    {
+        BOOST_REQUIRE_EQUAL(!!getNode(*added[i]),i%2 == 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(replaceNode_promotes_candidate)
+{
+    // 8 nodes in the half without our own address fill its bucket, the
+    // next ones are candidates
+    const std::string far = getTableNode().string()[0] < '8' ? "f" : "0";
+
+    std::vector<NodeSPtr> v;
+    for( int i = 0; i < 8; ++i )
+    {
+        NodeSPtr n(new Node(utils::parseIDFromHex(generateRandomNode(far))));
+        BOOST_REQUIRE(addNode(n));
+        v += n;
+    }
+    // splits, our own half is still empty
+    NodeSPtr candidate(new Node(utils::parseIDFromHex(generateRandomNode(far))));
+    BOOST_REQUIRE(!addNode(candidate));
+    BOOST_REQUIRE_EQUAL(getBucketsCount(),2);
+    BOOST_REQUIRE(!getNode(*candidate));
+
+    NodeSPtr freshest(new Node(utils::parseIDFromHex(generateRandomNode(far))));
+    BOOST_REQUIRE(!addNode(freshest));
+
+    boost::optional<NodeSPtr> promoted = replaceNode(v[2]);
+    BOOST_REQUIRE(!!promoted);
+    BOOST_REQUIRE_EQUAL(promoted->get(),freshest.get());
+    BOOST_REQUIRE(!getNode(*v[2]));
+    BOOST_REQUIRE(!!getNode(*freshest));
+    BOOST_REQUIRE_EQUAL(size(),8);
+
+    promoted = replaceNode(v[3]);
+    BOOST_REQUIRE(!!promoted);
+    BOOST_REQUIRE_EQUAL(promoted->get(),candidate.get());
+
+    // no more candidates, plain removal
+    BOOST_REQUIRE(!replaceNode(v[4]));
+    BOOST_REQUIRE_EQUAL(size(),7);
+
+    // not in the tree
+    BOOST_REQUIRE(!replaceNode(v[4]));
+    BOOST_REQUIRE_THROW(replaceNode(NodeSPtr()),std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(getNodeByEndpoint_follows_the_buckets)
+{
+    const std::string far = getTableNode().string()[0] < '8' ? "f" : "0";
+    const auto endpoint = [](const int i)
+    {
+        return udp::endpoint(boost::asio::ip::address_v4(0x0A000000+i),6881);
+    };
+
+    std::vector<NodeSPtr> v;
+    for( int i = 0; i < 9; ++i )
+    {
+        v += NodeSPtr(new Node(
+            utils::parseIDFromHex(generateRandomNode(far)),endpoint(i)));
+        addNode(v.back());
+    }
+
+    // the ninth is only a candidate, split across 2 buckets
+    for( int i = 0; i < 8; ++i )
+    {
+        BOOST_REQUIRE(!!getNodeByEndpoint(endpoint(i)));
+        BOOST_REQUIRE_EQUAL(getNodeByEndpoint(endpoint(i))->get(),v[i].get());
+    }
+    BOOST_REQUIRE(!getNodeByEndpoint(endpoint(8)));
+
+    // the candidate takes the place and the endpoint of the replaced node
+    BOOST_REQUIRE(!!replaceNode(v[0]));
+    BOOST_REQUIRE(!getNodeByEndpoint(endpoint(0)));
+    BOOST_REQUIRE_EQUAL(getNodeByEndpoint(endpoint(8))->get(),v[8].get());
+
+    removeNode(v[1]);
+    BOOST_REQUIRE(!getNodeByEndpoint(endpoint(1)));
+
+    // a node without an endpoint isn't indexed
+    addNode(NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode(far)))));
+    BOOST_REQUIRE(!getNodeByEndpoint(udp::endpoint()));
+
+    clear();
+    BOOST_REQUIRE(!getNodeByEndpoint(endpoint(2)));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -1,10 +1,21 @@
 #include <boost/test/unit_test.hpp>
+#include <cstdio>
 #include <cstdlib>
+#include <memory>
 #include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/time.h>
 
 #include <turtle/mock.hpp>
 
 #include <torrentsync/dht/RoutingTable.h>
+#include <torrentsync/dht/message/Message.h>
+#include <torrentsync/dht/message/query/Ping.h>
+#include <torrentsync/dht/message/reply/FindNode.h>
+#include <torrentsync/dht/message/reply/Ping.h>
+#include <torrentsync/utils/Yield.h>
 #include <test/torrentsync/dht/CommonNodeTest.h>
 #include <torrentsync/utils/log/Logger.h>
 
@@ -21,9 +32,10 @@ public:
 
     MockRoutingTable() : RoutingTable(_service) {}
 
-    MOCK_METHOD_EXT(sendMessage, 2, void (
+    MOCK_METHOD_EXT(sendMessage, 3, void (
         const torrentsync::utils::Buffer&,
-        const udp::endpoint& addr), sendMessage);
+        const udp::endpoint& addr,
+        const torrentsync::utils::SendQueue::class_t), sendMessage);
 };
 
 
@@ -56,4 +68,274 @@ BOOST_AUTO_TEST_CASE(initializing_addresses2)
     BOOST_REQUIRE_EQUAL( 1, _initial_addresses.size() );
 }
 
+BOOST_AUTO_TEST_CASE(load_table)
+{
+    const std::string path = "routing_table_test.snapshot";
+
+    std::vector<NodeSPtr> nodes;
+    for ( size_t i = 0; i < TEST_LOOP_COUNT; ++i)
+    {
+        nodes.push_back(NodeSPtr(new Node(
+            torrentsync::utils::parseIDFromHex(generateRandomNode()),
+            udp::endpoint(boost::asio::ip::address_v4(i+1),i+1))));
+    }
+    TableSnapshot::save(path,NodeData::getRandom(),nodes);
+
+    // the closest nodes of the snapshot replace the bootstrap
+    loadTable(TableSnapshot(path));
+    std::remove(path.c_str());
+    BOOST_REQUIRE_EQUAL(DHT_FIND_NODE_COUNT,_initial_addresses.size());
+}
+
+//! the IDs of the nodes saved by the table
+static std::vector<NodeData> savedNodes( const RoutingTable& table )
+{
+    const std::string path = "routing_table_saved.snapshot";
+    table.saveTable(path);
+    std::vector<NodeData> ids;
+    {
+        const TableSnapshot snapshot(path);
+        for( const SnapshotRecord& record : snapshot.getRecords() )
+            ids.push_back(record.id);
+    }
+    std::remove(path.c_str());
+    return ids;
+}
+
+BOOST_AUTO_TEST_CASE(new_id_at_known_endpoint)
+{
+    namespace msg = torrentsync::dht::message;
+
+    const std::string path = "routing_table_test.snapshot";
+    const udp::endpoint endpoint(boost::asio::ip::address_v4(0x7f000002),6881);
+    const NodeData previous = NodeData::getRandom();
+    const NodeData next = NodeData::getRandom();
+
+    TableSnapshot::save(path,NodeData::getRandom(),
+        std::vector<NodeSPtr>(1,NodeSPtr(new Node(previous,endpoint))));
+    loadTable(TableSnapshot(path));
+    std::remove(path.c_str());
+
+    // a query with a new ID only gets a reply and a ping
+    torrentsync::utils::Buffer ping;
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::REPLY).once();
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::MAINTENANCE).once().calls(
+        [&ping]( const torrentsync::utils::Buffer& buff, const udp::endpoint&,
+                 const torrentsync::utils::SendQueue::class_t ) { ping = buff; });
+
+    torrentsync::utils::Buffer query = msg::query::Ping::make(
+        torrentsync::utils::makeBuffer("aa"),next);
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{query.data(),query.size(),endpoint},nullptr);
+    BOOST_REQUIRE(!ping.empty());
+    std::vector<NodeData> saved = savedNodes(*this);
+    BOOST_REQUIRE_EQUAL(saved.size(),1);
+    BOOST_REQUIRE(saved[0] == previous);
+
+    // the answer to the ping replaces the node
+    const std::shared_ptr<msg::Message> sent = msg::Message::parseMessage(ping,ping.size());
+    torrentsync::utils::Buffer reply = msg::reply::Ping::make(sent->getTransactionID(),next);
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{reply.data(),reply.size(),endpoint},nullptr);
+    saved = savedNodes(*this);
+    BOOST_REQUIRE_EQUAL(saved.size(),1);
+    BOOST_REQUIRE(saved[0] == next);
+}
+
+BOOST_AUTO_TEST_CASE(new_id_pinged_once)
+{
+    namespace msg = torrentsync::dht::message;
+
+    const std::string path = "routing_table_test.snapshot";
+    const udp::endpoint endpoint(boost::asio::ip::address_v4(0x7f000002),6881);
+    const NodeData previous = NodeData::getRandom();
+    const NodeData next = NodeData::getRandom();
+
+    TableSnapshot::save(path,NodeData::getRandom(),
+        std::vector<NodeSPtr>(1,NodeSPtr(new Node(previous,endpoint))));
+    loadTable(TableSnapshot(path));
+    std::remove(path.c_str());
+
+    // every query is answered, the endpoint is pinged once
+    torrentsync::utils::Buffer ping;
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::REPLY).exactly(TEST_LOOP_COUNT);
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::MAINTENANCE).once().calls(
+        [&ping]( const torrentsync::utils::Buffer& buff, const udp::endpoint&,
+                 const torrentsync::utils::SendQueue::class_t ) { ping = buff; });
+
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        torrentsync::utils::Buffer query = msg::query::Ping::make(
+            torrentsync::utils::makeBuffer("aa"),next);
+        recvMessage(boost::system::error_code(),
+            torrentsync::utils::ReceiveRing::Slot{query.data(),query.size(),endpoint},nullptr);
+    }
+    BOOST_REQUIRE(!ping.empty());
+    MOCK_VERIFY(sendMessage);
+    MOCK_RESET(sendMessage);
+
+    // once answered, a later change is verified again
+    const std::shared_ptr<msg::Message> sent = msg::Message::parseMessage(ping,ping.size());
+    torrentsync::utils::Buffer reply = msg::reply::Ping::make(sent->getTransactionID(),next);
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{reply.data(),reply.size(),endpoint},nullptr);
+
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::REPLY).once();
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::MAINTENANCE).once();
+    torrentsync::utils::Buffer query = msg::query::Ping::make(
+        torrentsync::utils::makeBuffer("aa"),NodeData::getRandom());
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{query.data(),query.size(),endpoint},nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(error_ends_the_transaction)
+{
+    namespace msg = torrentsync::dht::message;
+    using torrentsync::utils::makeBuffer;
+
+    const std::string path = "routing_table_test.snapshot";
+    const udp::endpoint endpoint(boost::asio::ip::address_v4(0x7f000002),6881);
+    const NodeData previous = NodeData::getRandom();
+    const NodeData next = NodeData::getRandom();
+
+    TableSnapshot::save(path,NodeData::getRandom(),
+        std::vector<NodeSPtr>(1,NodeSPtr(new Node(previous,endpoint))));
+    loadTable(TableSnapshot(path));
+    std::remove(path.c_str());
+
+    // a query with a new ID opens a transaction for the ping
+    torrentsync::utils::Buffer ping;
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::REPLY).once();
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::MAINTENANCE).once().calls(
+        [&ping]( const torrentsync::utils::Buffer& buff, const udp::endpoint&,
+                 const torrentsync::utils::SendQueue::class_t ) { ping = buff; });
+
+    torrentsync::utils::Buffer query = msg::query::Ping::make(makeBuffer("aa"),next);
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{query.data(),query.size(),endpoint},nullptr);
+    BOOST_REQUIRE(!ping.empty());
+    const std::shared_ptr<msg::Message> sent = msg::Message::parseMessage(ping,ping.size());
+
+    // the error has no node ID, it ends the transaction
+    torrentsync::utils::Buffer error = makeBuffer("d1:eli201e5:Errore1:t2:");
+    error.insert(error.end(),sent->getTransactionID().begin(),sent->getTransactionID().end());
+    const torrentsync::utils::Buffer end = makeBuffer("1:y1:ee");
+    error.insert(error.end(),end.begin(),end.end());
+    BOOST_REQUIRE_NO_THROW(recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{error.data(),error.size(),endpoint},nullptr));
+
+    // a late reply finds no transaction, the node isn't replaced
+    torrentsync::utils::Buffer reply = msg::reply::Ping::make(sent->getTransactionID(),next);
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{reply.data(),reply.size(),endpoint},nullptr);
+    const std::vector<NodeData> saved = savedNodes(*this);
+    BOOST_REQUIRE_EQUAL(saved.size(),1);
+    BOOST_REQUIRE(saved[0] == previous);
+
+    // an error without transaction ID and a reply without node ID are dropped
+    torrentsync::utils::Buffer noTransaction = makeBuffer("d1:eli201e5:Errore1:y1:ee");
+    BOOST_REQUIRE_NO_THROW(recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{
+            noTransaction.data(),noTransaction.size(),endpoint},nullptr));
+    torrentsync::utils::Buffer noID = makeBuffer("d1:rd1:xi1ee1:t2:aa1:y1:re");
+    BOOST_REQUIRE_NO_THROW(recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{noID.data(),noID.size(),endpoint},nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(refresh_adds_the_nodes_found)
+{
+    namespace msg = torrentsync::dht::message;
+
+    const std::string path = "routing_table_test.snapshot";
+    const udp::endpoint endpoint(boost::asio::ip::address_v4(0x7f000002),6881);
+    const NodeData known = NodeData::getRandom();
+
+    TableSnapshot::save(path,NodeData::getRandom(),
+        std::vector<NodeSPtr>(1,NodeSPtr(new Node(known,endpoint))));
+    loadTable(TableSnapshot(path));
+    std::remove(path.c_str());
+
+    // the only node of the table is asked for the bucket
+    torrentsync::utils::Buffer query;
+    MOCK_EXPECT(sendMessage).with(mock::any,endpoint,
+        torrentsync::utils::SendQueue::MAINTENANCE).once().calls(
+        [&query]( const torrentsync::utils::Buffer& buff, const udp::endpoint&,
+                  const torrentsync::utils::SendQueue::class_t ) { query = buff; });
+    refreshBucket(0);
+    BOOST_REQUIRE(!query.empty());
+
+    // the nodes of its reply join the table
+    std::vector<NodeSPtr> found;
+    for( size_t i = 0; i < DHT_FIND_NODE_COUNT; ++i )
+    {
+        found.push_back(makeNode(NodeData::getRandom(),
+            udp::endpoint(boost::asio::ip::address_v4(0x7f000003+i),6881)));
+    }
+    const std::shared_ptr<msg::Message> sent = msg::Message::parseMessage(query,query.size());
+    torrentsync::utils::Buffer reply = msg::reply::FindNode::make(
+        sent->getTransactionID(),known,
+        torrentsync::utils::makeYield<NodeSPtr>(found.begin(),found.end()).function());
+    recvMessage(boost::system::error_code(),
+        torrentsync::utils::ReceiveRing::Slot{reply.data(),reply.size(),endpoint},nullptr);
+    BOOST_REQUIRE_GT(savedNodes(*this).size(),1);
+}
+
+BOOST_AUTO_TEST_CASE(sharded_receivers)
+{
+    namespace msg = torrentsync::dht::message;
+
+    boost::asio::io_service service;
+    const NodeData tableNode = NodeData::getRandom();
+    RoutingTable table(service,tableNode);
+    table.initializeNetwork(udp::endpoint(boost::asio::ip::address_v4::loopback(),0),4);
+    BOOST_REQUIRE_EQUAL(table.getReceiversCount(),4);
+    const udp::endpoint endpoint = table.getEndpoint();
+
+    // the first socket is served by the io_service of the table
+    std::thread owner([&](){ service.run(); });
+
+    // every sender has its own port, the senders are spread over the sockets
+    std::vector<std::unique_ptr<udp::socket> > senders;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        senders.push_back(std::unique_ptr<udp::socket>(new udp::socket(service)));
+        udp::socket& sender = *senders.back();
+        sender.open(udp::v4());
+        sender.bind(udp::endpoint(boost::asio::ip::address_v4::loopback(),0));
+
+        // fails instead of blocking if a reply is missing
+        const timeval timeout = { 5, 0 };
+        setsockopt(sender.native_handle(),SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+
+        const torrentsync::utils::Buffer transaction = { static_cast<uint8_t>(i), 'x' };
+        sender.send_to(boost::asio::buffer(
+            msg::query::Ping::make(transaction,NodeData::getRandom())),endpoint);
+    }
+
+    // every query is answered from the port of the table
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        torrentsync::utils::Buffer reply(MESSAGE_BUFFER_SIZE);
+        udp::endpoint from;
+        const size_t size = senders[i]->receive_from(boost::asio::buffer(reply),from);
+        BOOST_REQUIRE_EQUAL(from,endpoint);
+
+        const std::shared_ptr<msg::Message> message = msg::Message::parseMessage(reply,size);
+        const torrentsync::utils::Buffer transaction = { static_cast<uint8_t>(i), 'x' };
+        BOOST_REQUIRE(transaction == message->getTransactionID());
+        BOOST_REQUIRE(tableNode == NodeData(message->getID()));
+    }
+
+    service.stop();
+    owner.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END();
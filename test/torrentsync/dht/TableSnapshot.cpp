@@ -0,0 +1,106 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/dht/TableSnapshot.h>
+#include <torrentsync/utils/Buffer.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_dht_TableSnapshot);
+
+using namespace torrentsync;
+using namespace torrentsync::dht;
+
+//! a snapshot file removed at the end of the test
+struct SnapshotFile
+{
+    SnapshotFile() : path("table_snapshot_test." + std::to_string(getpid())) {}
+    ~SnapshotFile() { std::remove(path.c_str()); }
+
+    void write( const std::string& data ) const
+    {
+        std::ofstream(path,std::ios::binary) << data;
+    }
+
+    const std::string path;
+};
+
+BOOST_AUTO_TEST_CASE(save_and_load)
+{
+    SnapshotFile file;
+    const NodeData table = utils::parseIDFromHex(generateRandomNode());
+
+    std::vector<NodeSPtr> nodes;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const udp::endpoint endpoint(
+            boost::asio::ip::address_v4(static_cast<uint32_t>(rand())),
+            static_cast<uint16_t>(rand()));
+        NodeSPtr node(new Node(utils::parseIDFromHex(generateRandomNode()),endpoint));
+        node->restore(rand(),i%16);
+        node->setRTT(static_cast<uint16_t>(rand()));
+        nodes.push_back(node);
+    }
+
+    // not saved, without an endpoint
+    nodes.push_back(NodeSPtr(new Node(utils::parseIDFromHex(generateRandomNode()))));
+
+    TableSnapshot::save(file.path,table,nodes);
+
+    const TableSnapshot snapshot(file.path);
+    BOOST_REQUIRE(snapshot.getTableNode() == table);
+    BOOST_REQUIRE_EQUAL(snapshot.getRecords().size(),TEST_LOOP_COUNT);
+
+    size_t i = 0;
+    for( const SnapshotRecord& record : snapshot.getRecords() )
+    {
+        const Node& node = *nodes[i++];
+        BOOST_REQUIRE(record.id == node);
+        BOOST_REQUIRE_EQUAL(record.endpoint,*node.getEndpoint());
+        BOOST_REQUIRE_EQUAL(record.rtt,node.getRTT());
+        BOOST_REQUIRE_EQUAL(record.failures,node.getUnansweredQueries());
+        BOOST_REQUIRE_EQUAL(record.lastSeen,node.getLastTimeGood());
+
+        const NodeSPtr loaded = record.toNode();
+        BOOST_REQUIRE(*loaded == node);
+        BOOST_REQUIRE_EQUAL(loaded->getLastTimeGood(),node.getLastTimeGood());
+        BOOST_REQUIRE_EQUAL(loaded->getUnansweredQueries(),node.getUnansweredQueries());
+        BOOST_REQUIRE_EQUAL(loaded->getRTT(),node.getRTT());
+    }
+
+    // saving again replaces the file
+    TableSnapshot::save(file.path,table,std::vector<NodeSPtr>());
+    BOOST_REQUIRE(TableSnapshot(file.path).getRecords().empty());
+}
+
+BOOST_AUTO_TEST_CASE(invalid_files)
+{
+    SnapshotFile file;
+    BOOST_REQUIRE_THROW(TableSnapshot(file.path),std::system_error);
+
+    file.write("");
+    BOOST_REQUIRE_THROW(TableSnapshot(file.path),std::invalid_argument);
+
+    file.write(std::string("XXXX\0\x01\0\x28\0\0\0\0",12) + std::string(20,'a'));
+    BOOST_REQUIRE_THROW(TableSnapshot(file.path),std::invalid_argument);
+
+    // a newer version
+    file.write(std::string("TSRT\0\x02\0\x28\0\0\0\0",12) + std::string(20,'a'));
+    BOOST_REQUIRE_THROW(TableSnapshot(file.path),std::invalid_argument);
+
+    // a record announced but missing
+    file.write(std::string("TSRT\0\x01\0\x28\0\0\0\x01",12) + std::string(20,'a'));
+    BOOST_REQUIRE_THROW(TableSnapshot(file.path),std::invalid_argument);
+
+    file.write(std::string("TSRT\0\x01\0\x28\0\0\0\0",12) + std::string(20,'a'));
+    BOOST_REQUIRE(TableSnapshot(file.path).getRecords().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
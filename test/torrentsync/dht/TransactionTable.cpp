@@ -0,0 +1,206 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/dht/TransactionTable.h>
+
+#include <chrono>
+#include <set>
+#include <vector>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_dht_TransactionTable);
+
+using namespace torrentsync;
+using namespace torrentsync::dht;
+using boost::asio::ip::udp;
+
+static const utils::TimerWheel::duration TICK = std::chrono::milliseconds(10);
+
+namespace
+{
+//! a table counting what it sends, on a wheel moved by hand
+struct Fixture
+{
+    Fixture() :
+        wheel(service,TICK),
+        table(wheel,
+            [this]( const utils::Buffer&, const udp::endpoint&,
+                    const utils::SendQueue::class_t ) { ++sent; }),
+        destination(boost::asio::ip::address_v4::loopback(),6881),
+        sent(0),
+        timedOut(0),
+        answered(0)
+    {
+    }
+
+    //! opens a transaction counting how it ends
+    void open(
+        const TransactionTable::id_t id,
+        const boost::optional<NodeData>& source = boost::optional<NodeData>(),
+        const size_t ticks = 1 )
+    {
+        table.open(id,utils::Buffer(1,'q'),destination,utils::SendQueue::LOOKUP,
+            [this]( boost::optional<TransactionTable::payload_type> data )
+            {
+                if (!data)
+                    ++timedOut;
+                else
+                    ++answered;
+            }, source, ticks*TICK);
+    }
+
+    boost::asio::io_service service;
+    utils::TimerWheel wheel;
+    TransactionTable table;
+    udp::endpoint destination;
+
+    size_t sent;
+    size_t timedOut;
+    size_t answered;
+};
+};
+
+BOOST_AUTO_TEST_CASE(reply_closes_the_transaction)
+{
+    Fixture f;
+    const NodeData node = NodeData::getRandom();
+
+    std::vector<TransactionTable::id_t> ids;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        ids.push_back(f.table.next());
+        f.open(ids.back(),node);
+    }
+    BOOST_REQUIRE_EQUAL(f.sent,TEST_LOOP_COUNT);
+    BOOST_REQUIRE_EQUAL(f.table.size(),TEST_LOOP_COUNT);
+
+    for( const TransactionTable::id_t i : ids )
+    {
+        const utils::Buffer id = TransactionTable::toBuffer(i);
+
+        // only the node queried, from the endpoint queried
+        BOOST_REQUIRE(!f.table.close(id,f.destination,NodeData::getRandom()));
+        BOOST_REQUIRE(!f.table.close(id,udp::endpoint(f.destination.address(),6882),node));
+
+        const TransactionTable::callback_t callback = f.table.close(id,f.destination,node);
+        BOOST_REQUIRE(!!callback);
+        BOOST_REQUIRE(!f.table.isOpen(i));
+
+        // a duplicated reply finds nothing
+        BOOST_REQUIRE(!f.table.close(id,f.destination,node));
+    }
+    BOOST_REQUIRE_EQUAL(f.table.size(),0);
+    BOOST_REQUIRE_EQUAL(f.table.getCounters().answered,TEST_LOOP_COUNT);
+
+    // the timers were cancelled
+    BOOST_REQUIRE_EQUAL(f.wheel.size(),0);
+    f.wheel.advance(4);
+    BOOST_REQUIRE_EQUAL(f.timedOut,0);
+    BOOST_REQUIRE_EQUAL(f.sent,TEST_LOOP_COUNT);
+}
+
+BOOST_AUTO_TEST_CASE(retry_then_timeout)
+{
+    Fixture f;
+    f.open(42);
+    BOOST_REQUIRE_EQUAL(f.sent,1);
+
+    // the first deadline sends the query again
+    f.wheel.advance(1);
+    BOOST_REQUIRE_EQUAL(f.sent,2);
+    BOOST_REQUIRE_EQUAL(f.timedOut,0);
+    BOOST_REQUIRE(f.table.isOpen(42));
+
+    // the second one ends it
+    f.wheel.advance(1);
+    BOOST_REQUIRE_EQUAL(f.sent,2);
+    BOOST_REQUIRE_EQUAL(f.timedOut,1);
+    BOOST_REQUIRE(!f.table.isOpen(42));
+    BOOST_REQUIRE_EQUAL(f.table.getCounters().retried,1);
+    BOOST_REQUIRE_EQUAL(f.table.getCounters().timedOut,1);
+
+    // once only
+    f.wheel.advance(4);
+    BOOST_REQUIRE_EQUAL(f.timedOut,1);
+    BOOST_REQUIRE_EQUAL(f.wheel.size(),0);
+}
+
+BOOST_AUTO_TEST_CASE(error_ends_the_transaction)
+{
+    Fixture f;
+    const NodeData node = NodeData::getRandom();
+    f.open(42,node);
+    const utils::Buffer id = TransactionTable::toBuffer(42);
+
+    // only from the endpoint queried, the error has no node ID to check
+    BOOST_REQUIRE(!f.table.fail(id,udp::endpoint(f.destination.address(),6882)));
+    const TransactionTable::callback_t callback = f.table.fail(id,f.destination);
+    BOOST_REQUIRE(!!callback);
+    BOOST_REQUIRE(!f.table.isOpen(42));
+    BOOST_REQUIRE_EQUAL(f.table.getCounters().failed,1);
+
+    // a late reply finds nothing, and the query is not sent again
+    BOOST_REQUIRE(!f.table.close(id,f.destination,node));
+    BOOST_REQUIRE(!f.table.fail(id,f.destination));
+    f.wheel.advance(4);
+    BOOST_REQUIRE_EQUAL(f.sent,1);
+    BOOST_REQUIRE_EQUAL(f.timedOut,0);
+}
+
+BOOST_AUTO_TEST_CASE(reopened_slot)
+{
+    Fixture f;
+
+    // an open transaction is timed out by a new one with the same ID
+    f.open(7);
+    f.open(7,boost::optional<NodeData>(),3);
+    BOOST_REQUIRE_EQUAL(f.timedOut,1);
+    BOOST_REQUIRE_EQUAL(f.table.size(),1);
+
+    // the deadlines of the earlier use of the slot are ignored
+    f.wheel.advance(2);
+    BOOST_REQUIRE_EQUAL(f.sent,2);
+    f.wheel.advance(1);
+    BOOST_REQUIRE_EQUAL(f.sent,3);
+    BOOST_REQUIRE_EQUAL(f.timedOut,1);
+}
+
+BOOST_AUTO_TEST_CASE(next_skips_the_open_transactions)
+{
+    Fixture f;
+
+    // random, not a sequence
+    std::set<TransactionTable::id_t> given;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        given.insert(f.table.next());
+    }
+    BOOST_REQUIRE_GT(given.size(),TEST_LOOP_COUNT/2);
+
+    // the only free slot is found
+    for( size_t i = 0; i < TransactionTable::SLOTS; ++i )
+    {
+        if (i != 1234)
+            f.open(i);
+    }
+    BOOST_REQUIRE_EQUAL(f.table.next(),1234);
+    f.open(1234);
+    BOOST_REQUIRE_EQUAL(f.table.size(),TransactionTable::SLOTS);
+}
+
+BOOST_AUTO_TEST_CASE(transaction_id_on_the_wire)
+{
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const TransactionTable::id_t id = rand();
+        const utils::Buffer buff = TransactionTable::toBuffer(id);
+        BOOST_REQUIRE_EQUAL(buff.size(),TransactionTable::ID_SIZE);
+        BOOST_REQUIRE_EQUAL(*TransactionTable::fromBuffer(buff),id);
+    }
+
+    // not one of ours
+    BOOST_REQUIRE(!TransactionTable::fromBuffer(utils::makeBuffer("abc")));
+    BOOST_REQUIRE(!TransactionTable::fromBuffer(utils::makeBuffer("a")));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -17,6 +17,15 @@ using namespace torrentsync;
     BOOST_REQUIRE(map.find(key)->second == \
         utils::makeBuffer(value));}
 
+#define TEST_VIEW(key,value) { \
+    BOOST_REQUIRE(!!decoder.findView(key)); \
+    BOOST_REQUIRE(*decoder.findView(key) == std::string(value));}
+
+static const uint8_t* bytes( const std::string& str )
+{
+    return reinterpret_cast<const uint8_t*>(str.data());
+}
+
 BOOST_AUTO_TEST_CASE(constructor_destructor)
 {
     BEncodeDecoder dec;
@@ -181,4 +190,195 @@ BOOST_AUTO_TEST_CASE(parse_error3)
     BOOST_REQUIRE_THROW(decoder.parseMessage(str),BEncodeException);
 }
 
+BOOST_AUTO_TEST_CASE(parseInPlace_emptyDictionary)
+{
+    const std::string str("de");
+
+    BEncodeDecoder decoder;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str),str.size()));
+    BOOST_REQUIRE_EQUAL(decoder.getViews().size(),1);
+    BOOST_REQUIRE(decoder.getViews()[0].value == str);
+}
+
+BOOST_AUTO_TEST_CASE(parseInPlace_dictionary)
+{
+    const std::string str("d1:a2:bb2:yy4:plple");
+
+    BEncodeDecoder decoder;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str),str.size()));
+    BOOST_REQUIRE_EQUAL(decoder.getViews().size(),3);
+    TEST_VIEW("a","bb");
+    TEST_VIEW("yy","plpl");
+    BOOST_REQUIRE(!decoder.findView("b"));
+
+    // values reference the parsed data
+    BOOST_REQUIRE(decoder.findView("a")->data() == bytes(str)+6);
+}
+
+BOOST_AUTO_TEST_CASE(parseInPlace_list)
+{
+    const std::string str("l1:a2:bb2:yy4:plple");
+
+    BEncodeDecoder decoder;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str),str.size()));
+    TEST_VIEW("0","a");
+    TEST_VIEW("1","bb");
+    TEST_VIEW("2","yy");
+    TEST_VIEW("3","plpl");
+}
+
+BOOST_AUTO_TEST_CASE(parseInPlace_dictionaryWithStructures)
+{
+    const std::string str("d1:a2:bb1:ql1:a1:b1:ce1:rd1:a1:b1:c4:ababe2:yyi-42ee");
+
+    BEncodeDecoder decoder;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str),str.size()));
+
+    TEST_VIEW("a","bb");
+    TEST_VIEW("q/0","a");
+    TEST_VIEW("q/1","b");
+    TEST_VIEW("q/2","c");
+    TEST_VIEW("r/a","b");
+    TEST_VIEW("r/c","abab");
+    TEST_VIEW("yy","-42");
+    TEST_VIEW("r","d1:a1:b1:c4:ababe");
+    BOOST_REQUIRE(!decoder.findView("q/3"));
+    BOOST_REQUIRE(!decoder.findView("a/c"));
+    BOOST_REQUIRE(!decoder.findView("c"));
+
+    BOOST_REQUIRE_EQUAL(decoder.getPath(decoder.getViews()[3]),"q/0");
+}
+
+BOOST_AUTO_TEST_CASE(parseInPlace_listWithList)
+{
+    const std::string str("l1:a2:aa1:ql1:b2:ceee");
+
+    BEncodeDecoder decoder;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str),str.size()));
+
+    TEST_VIEW("0","a");
+    TEST_VIEW("1","aa");
+    TEST_VIEW("2","q");
+    TEST_VIEW("3/0","b");
+    TEST_VIEW("3/1","ce");
+}
+
+BOOST_AUTO_TEST_CASE(parseInPlace_reuse)
+{
+    const std::string str1("d1:a2:bbe");
+    const std::string str2("d1:b2:cce");
+
+    BEncodeDecoder decoder;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str1),str1.size()));
+    TEST_VIEW("a","bb");
+    BOOST_REQUIRE_NO_THROW(decoder.parseMessage(bytes(str2),str2.size()));
+    TEST_VIEW("b","cc");
+    BOOST_REQUIRE(!decoder.findView("a"));
+}
+
+BOOST_AUTO_TEST_CASE(parseInPlace_errors)
+{
+    const std::string errors[] = {
+        "", "aaaaa", "d1:a2:be", "d1:ab:be", "d1:a1:b", "d1:ae",
+        "d1:ai12e", "d1:aie", "d99999999999:ae", "1:a" };
+
+    for( const std::string& str : errors )
+    {
+        BEncodeDecoder decoder;
+        BOOST_REQUIRE_THROW(decoder.parseMessage(bytes(str),str.size()),BEncodeException);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parseKRPC_findNodeQuery)
+{
+    const std::string str("d1:ad2:id20:abcdefghij01234567896:target20:mnopqrstuvwxyz123456e1:q9:find_node1:t2:aa1:y1:qe");
+
+    BEncodeDecoder decoder;
+    KRPC message;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseKRPC(bytes(str),str.size(),message));
+    BOOST_REQUIRE(!!message.txid && *message.txid == "aa");
+    BOOST_REQUIRE(!!message.y && *message.y == "q");
+    BOOST_REQUIRE(!!message.q && *message.q == "find_node");
+    BOOST_REQUIRE(!!message.id && *message.id == "abcdefghij0123456789");
+    BOOST_REQUIRE(!!message.target && *message.target == "mnopqrstuvwxyz123456");
+    BOOST_REQUIRE(!message.nodes);
+    BOOST_REQUIRE(!message.port);
+    BOOST_REQUIRE(!message.v);
+    BOOST_REQUIRE_EQUAL(message.kind,KRPC::FIND_NODE_QUERY);
+}
+
+BOOST_AUTO_TEST_CASE(parseKRPC_skipUnknown)
+{
+    const std::string str("d1:ad2:id20:abcdefghij01234567891:xld1:ai1eee4:porti6881e5:token2:zze1:q13:announce_peer1:t2:aa1:v4:UT011:y1:q1:zd1:al1:beee");
+
+    BEncodeDecoder decoder;
+    KRPC message;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseKRPC(bytes(str),str.size(),message));
+    BOOST_REQUIRE(!!message.id && *message.id == "abcdefghij0123456789");
+    BOOST_REQUIRE(!!message.token && *message.token == "zz");
+    BOOST_REQUIRE(!!message.port && *message.port == 6881);
+    BOOST_REQUIRE(!!message.v && *message.v == "UT01");
+    BOOST_REQUIRE(!!message.y && *message.y == "q");
+    BOOST_REQUIRE_EQUAL(message.kind,KRPC::UNKNOWN_QUERY);
+}
+
+BOOST_AUTO_TEST_CASE(parseKRPC_error)
+{
+    const std::string str("d1:eli201e23:A Generic Error Ocurrede1:t2:aa1:y1:ee");
+
+    BEncodeDecoder decoder;
+    KRPC message;
+
+    BOOST_REQUIRE_NO_THROW(decoder.parseKRPC(bytes(str),str.size(),message));
+    BOOST_REQUIRE(!!message.y && *message.y == "e");
+    BOOST_REQUIRE(!!message.error && *message.error == "li201e23:A Generic Error Ocurrede");
+    BOOST_REQUIRE(!message.id);
+    BOOST_REQUIRE_EQUAL(message.kind,KRPC::ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(parseKRPC_kind)
+{
+    const std::pair<std::string,KRPC::kind_t> kinds[] = {
+        std::make_pair("d1:q4:ping1:y1:qe",KRPC::PING_QUERY),
+        std::make_pair("d1:q9:find_node1:y1:qe",KRPC::FIND_NODE_QUERY),
+        std::make_pair("d1:q5:ping_1:y1:qe",KRPC::UNKNOWN_QUERY),
+        std::make_pair("d1:y1:qe",KRPC::UNKNOWN_QUERY),
+        std::make_pair("d1:y1:re",KRPC::REPLY),
+        std::make_pair("d1:q4:ping1:y1:re",KRPC::REPLY),
+        std::make_pair("d1:y1:ee",KRPC::ERROR),
+        std::make_pair("d1:y2:qqe",KRPC::UNKNOWN),
+        std::make_pair("d1:y1:xe",KRPC::UNKNOWN),
+        std::make_pair("de",KRPC::UNKNOWN) };
+
+    for( const auto& kind : kinds )
+    {
+        BEncodeDecoder decoder;
+        KRPC message;
+        BOOST_REQUIRE_NO_THROW(decoder.parseKRPC(bytes(kind.first),kind.first.size(),message));
+        BOOST_REQUIRE_EQUAL(message.kind,kind.second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parseKRPC_malformed)
+{
+    const std::string errors[] = {
+        "", "le", "d1:t", "d1:ti1ee", "d1:ad2:idi1eee",
+        "d1:ad4:porti70000eee", "d1:ad4:porti-1eee", "d1:xd1:ae" };
+
+    for( const std::string& str : errors )
+    {
+        BEncodeDecoder decoder;
+        KRPC message;
+        BOOST_REQUIRE_THROW(decoder.parseKRPC(bytes(str),str.size(),message),BEncodeException);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -98,4 +98,55 @@ BOOST_AUTO_TEST_CASE(bep005_find_node_example_r)
 "d1:rd2:id20:0123456789abcdefghij5:nodes26:0123456789abcdefghij....11e1:t2:aa1:y1:re"));
 }
 
+BOOST_AUTO_TEST_CASE(fixed_output)
+{
+    const std::string expected("d1:ad2:id20:abcdefghij0123456789e1:q4:ping1:t2:aa1:y1:qe");
+    uint8_t output[128];
+
+    BEncodeEncoder c(output,expected.size());
+
+    c.startDictionary();
+    c.addElement("a");
+    c.startDictionary();
+    uint8_t* id = c.reserveDictionaryElement("id",20);
+    const std::string idValue("abcdefghij0123456789");
+    std::copy(idValue.cbegin(),idValue.cend(),id);
+    c.endDictionary();
+    c.addDictionaryElement("q","ping");
+    c.addDictionaryElement("t","aa");
+    c.addDictionaryElement("y","q");
+    c.endDictionary();
+
+    BOOST_REQUIRE_EQUAL(c.size(),expected.size());
+    BOOST_REQUIRE(std::equal(expected.cbegin(),expected.cend(),output));
+    BOOST_REQUIRE(c.value() == utils::makeBuffer(expected));
+
+    BOOST_REQUIRE_THROW(c.endDictionary(),std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(fixed_output_overflow)
+{
+    uint8_t output[8];
+
+    BEncodeEncoder c(output,sizeof(output));
+    c.startDictionary();
+    c.addDictionaryElement("a","b");
+    BOOST_REQUIRE_THROW(c.addDictionaryElement("c","d"),std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(element_size)
+{
+    BOOST_REQUIRE_EQUAL(BEncodeEncoder::elementSize(0),2);
+    BOOST_REQUIRE_EQUAL(BEncodeEncoder::elementSize(9),11);
+    BOOST_REQUIRE_EQUAL(BEncodeEncoder::elementSize(10),13);
+    BOOST_REQUIRE_EQUAL(BEncodeEncoder::elementSize(208),212);
+    BOOST_REQUIRE_EQUAL(BEncodeEncoder::elementSize(std::string("ping")),6);
+
+    std::string longValue(1234,'x');
+    BEncodeEncoder c;
+    c.addElement(longValue);
+    BOOST_REQUIRE_EQUAL(c.size(),BEncodeEncoder::elementSize(longValue));
+    BOOST_REQUIRE(c.value() == utils::makeBuffer("1234:"+longValue));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
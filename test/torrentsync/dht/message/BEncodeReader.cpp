@@ -0,0 +1,166 @@
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include <torrentsync/dht/message/BEncodeReader.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_dht_message_BEncodeReader);
+
+using namespace torrentsync::dht::message;
+using namespace torrentsync;
+
+//! writes every event received in a readable form
+class RecordingHandler : public BEncodeHandler
+{
+public:
+    std::stringstream events;
+
+    std::string value;
+
+    void beginDictionary( const size_t offset ) { events << "d" << offset << " "; }
+    void beginList( const size_t offset )       { events << "l" << offset << " "; }
+    void end( const size_t offset )             { events << "e" << offset << " "; }
+
+    void key( const utils::BufferView& key, const size_t offset )
+    {
+        events << "k" << offset << ":" << key << " ";
+    }
+
+    void string(
+        const utils::BufferView& data,
+        const size_t offset,
+        const size_t remaining )
+    {
+        value.append(data.begin(),data.end());
+        if (remaining == 0)
+        {
+            events << "s:" << value << " ";
+            value.clear();
+        }
+    }
+
+    void integer( const int64_t value, const size_t offset )
+    {
+        events << "i" << offset << ":" << value << " ";
+    }
+};
+
+static const uint8_t* bytes( const std::string& str )
+{
+    return reinterpret_cast<const uint8_t*>(str.data());
+}
+
+//! parses the document in chunks of chunkSize and returns the events
+static std::string parse( const std::string& document, const size_t chunkSize )
+{
+    RecordingHandler handler;
+    BEncodeReader reader(handler);
+
+    for( size_t i = 0; i < document.size(); i += chunkSize )
+    {
+        const size_t length = std::min(chunkSize,document.size()-i);
+        BOOST_REQUIRE_EQUAL(reader.feed(bytes(document)+i,length),length);
+    }
+    BOOST_REQUIRE(reader.finished());
+    BOOST_REQUIRE_EQUAL(reader.offset(),document.size());
+    return handler.events.str();
+}
+
+BOOST_AUTO_TEST_CASE(parse_dictionary)
+{
+    const std::string document("d1:a2:bb2:yyi-42e1:ql1:a0:ee");
+    const std::string expected("d0 k1:a s:bb k8:yy i12:-42 k17:q l20 s:a s: e26 e27 ");
+
+    BOOST_REQUIRE_EQUAL(parse(document,document.size()),expected);
+}
+
+BOOST_AUTO_TEST_CASE(parse_chunks)
+{
+    const std::string document(
+        "d8:announce15:http://tracker/4:infod6:lengthi1234567e4:name4:file"
+        "6:pieces20:aaaaaaaaaaaaaaaaaaaaee");
+    const std::string expected = parse(document,document.size());
+
+    for( size_t chunk = 1; chunk < document.size(); ++chunk )
+    {
+        BOOST_REQUIRE_EQUAL(parse(document,chunk),expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(info_offsets)
+{
+    class InfoHandler : public BEncodeHandler
+    {
+    public:
+        InfoHandler( const BEncodeReader*& reader ) : _reader(reader) {}
+
+        void key( const utils::BufferView& key, const size_t )
+        {
+            _info = _reader->depth() == 1 && key == std::string("info");
+        }
+        void beginDictionary( const size_t offset )
+        {
+            if (_info)
+                begin = offset;
+            _info = false;
+        }
+        void end( const size_t offset )
+        {
+            if (_reader->depth() == 1)
+                last = offset;
+        }
+
+        size_t begin = 0;
+        size_t last = 0;
+
+    private:
+        const BEncodeReader*& _reader;
+        bool _info = false;
+    };
+
+    const std::string document("d8:announce1:x4:infod4:name4:filee1:zi0ee");
+
+    const BEncodeReader* readerPtr = nullptr;
+    InfoHandler handler(readerPtr);
+    BEncodeReader reader(handler);
+    readerPtr = &reader;
+
+    for( size_t i = 0; i < document.size(); ++i )
+        reader.feed(bytes(document)+i,1);
+
+    BOOST_REQUIRE(reader.finished());
+    BOOST_REQUIRE_EQUAL(
+        document.substr(handler.begin,handler.last-handler.begin+1),
+        "d4:name4:filee");
+}
+
+BOOST_AUTO_TEST_CASE(trailing_data)
+{
+    const std::string document("d1:a1:bexyz");
+
+    RecordingHandler handler;
+    BEncodeReader reader(handler);
+    BOOST_REQUIRE_EQUAL(reader.feed(bytes(document),document.size()),8);
+    BOOST_REQUIRE(reader.finished());
+
+    reader.reset();
+    BOOST_REQUIRE(!reader.finished());
+    BOOST_REQUIRE_EQUAL(reader.feed(bytes(document),document.size()),8);
+}
+
+BOOST_AUTO_TEST_CASE(parse_errors)
+{
+    const std::string errors[] = {
+        "x", "e", "d1:ae", "di1ei2ee", "d1:a1:b1e", "1x", ":a", "i-e", "i1-e",
+        "i99999999999999999999e", "lllle" };
+
+    for( const std::string& document : errors )
+    {
+        RecordingHandler handler;
+        BEncodeReader reader(handler,3);
+        BOOST_REQUIRE_THROW(reader.feed(bytes(document),document.size()),BEncodeException);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/dht/message/DatagramFilter.h>
+#include <torrentsync/dht/message/Message.h>
+#include <torrentsync/utils/Buffer.h>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_dht_message_DatagramFilter);
+
+using namespace torrentsync;
+using namespace torrentsync::dht::message;
+
+static DatagramFilter::reason_t check( DatagramFilter& filter, const std::string& data )
+{
+    return filter.check(reinterpret_cast<const uint8_t*>(data.data()),data.size());
+}
+
+BOOST_AUTO_TEST_CASE(accepted)
+{
+    DatagramFilter filter;
+
+    const std::string messages[] = {
+        "d1:y1:re",
+        "d1:ad2:id20:GGGGGGGGHHHHHHHHIIIIe1:q4:ping1:t2:aa1:y1:qe",
+        "d1:rd2:id20:0123456789abcdefghij5:nodes26:0123456789abcdefghij....11e1:t2:aa1:y1:re",
+        "d1:eli201e23:A Generic Error Ocurrede1:t2:aa1:y1:ee" };
+
+    for( const std::string& message : messages )
+    {
+        BOOST_REQUIRE_EQUAL(check(filter,message),DatagramFilter::ACCEPTED);
+    }
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::ACCEPTED),4);
+}
+
+BOOST_AUTO_TEST_CASE(rejected)
+{
+    DatagramFilter filter;
+
+    const std::pair<std::string,DatagramFilter::reason_t> datagrams[] = {
+        std::make_pair("",DatagramFilter::EMPTY),
+        std::make_pair("d1:y1:e",DatagramFilter::TOO_SHORT),
+        std::make_pair("l1:y1:qe",DatagramFilter::NOT_DICTIONARY),
+        std::make_pair("d1:y1:q1:t",DatagramFilter::NOT_DICTIONARY),
+        std::make_pair(std::string("\x41\x01\x00\x00\x00\x00\x00\x00\x00",9),DatagramFilter::NOT_DICTIONARY),
+        std::make_pair("dx:y1:qe",DatagramFilter::BAD_LENGTH),
+        std::make_pair("d1y1:qee",DatagramFilter::BAD_LENGTH),
+        std::make_pair("d0:1:y1:qe",DatagramFilter::BAD_LENGTH),
+        std::make_pair("d99:y1:qe",DatagramFilter::BAD_LENGTH),
+        std::make_pair("d1234:yqe",DatagramFilter::BAD_LENGTH),
+        std::make_pair("d1:t2:aa1:y1:xe",DatagramFilter::MISSING_TYPE),
+        std::make_pair("d1:t2:aa1:z1:qe",DatagramFilter::MISSING_TYPE),
+        std::make_pair("d1:t2:aa1:y1:e",DatagramFilter::MISSING_TYPE) };
+
+    for( const auto& datagram : datagrams )
+    {
+        BOOST_REQUIRE_EQUAL(check(filter,datagram.first),datagram.second);
+    }
+
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::ACCEPTED),0);
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::EMPTY),1);
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::TOO_SHORT),1);
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::NOT_DICTIONARY),3);
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::BAD_LENGTH),5);
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::MISSING_TYPE),3);
+
+    filter.count(DatagramFilter::MALFORMED);
+    BOOST_REQUIRE_EQUAL(filter.getCount(DatagramFilter::MALFORMED),1);
+}
+
+BOOST_AUTO_TEST_CASE(accepted_messages_parse)
+{
+    // everything the parser accepts must pass the filter
+    DatagramFilter filter;
+
+    const std::string messages[] = {
+        "d1:ad2:id20:abcdefghij01234567896:target20:mnopqrstuvwxyz123456e1:q9:find_node1:t2:aa1:y1:qe",
+        "d1:ad2:id20:GGGGGGGGHHHHHHHHIIIIe1:q4:ping1:t2:aa1:y1:qe",
+        "d1:rd2:id20:0123456789abcdefghij5:nodes26:0123456789abcdefghij....11e1:t2:aa1:y1:re" };
+
+    for( const std::string& message : messages )
+    {
+        BOOST_REQUIRE_NO_THROW(Message::parseMessage(utils::makeBuffer(message)));
+        BOOST_REQUIRE_EQUAL(check(filter,message),DatagramFilter::ACCEPTED);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/dht/message/BEncodeEncoder.h>
+#include <torrentsync/dht/message/Message.h>
+#include <torrentsync/dht/message/PacketTemplate.h>
+#include <torrentsync/dht/message/query/FindNode.h>
+#include <torrentsync/dht/message/query/Ping.h>
+#include <torrentsync/dht/message/reply/Ping.h>
+#include <torrentsync/dht/NodeData.h>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_dht_message_PacketTemplate);
+
+using namespace torrentsync;
+using namespace torrentsync::dht::message;
+
+//! transaction IDs of several lengths, including ones needing 2 digits
+static std::vector<utils::Buffer> transactions()
+{
+    return {
+        utils::makeBuffer("a"),
+        utils::makeBuffer("aa"),
+        utils::makeBuffer("abcd"),
+        utils::makeBuffer("0123456789"),
+        utils::makeBuffer("0123456789abcdef") };
+}
+
+BOOST_AUTO_TEST_CASE(ping_query)
+{
+    for ( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const auto id = dht::NodeData::getRandom();
+        for ( const utils::Buffer& transaction : transactions() )
+        {
+            BEncodeEncoder enc;
+            enc.startDictionary();
+            enc.addElement(Field::Arguments);
+            enc.startDictionary();
+            enc.addDictionaryElement(Field::PeerID,id.write());
+            enc.endDictionary();
+            enc.addDictionaryElement(Field::Query,Messages::Ping);
+            enc.addDictionaryElement(Field::TransactionID,transaction);
+            enc.addDictionaryElement(Field::Type,Type::Query);
+            enc.endDictionary();
+
+            BOOST_REQUIRE(query::Ping::make(transaction,id) == enc.value());
+            BOOST_REQUIRE_EQUAL(query::Ping::encodedSize(transaction),enc.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ping_reply)
+{
+    for ( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const auto id = dht::NodeData::getRandom();
+        for ( const utils::Buffer& transaction : transactions() )
+        {
+            BEncodeEncoder enc;
+            enc.startDictionary();
+            enc.addElement(Field::Reply);
+            enc.startDictionary();
+            enc.addDictionaryElement(Field::PeerID,id.write());
+            enc.endDictionary();
+            enc.addDictionaryElement(Field::TransactionID,transaction);
+            enc.addDictionaryElement(Field::Type,Type::Reply);
+            enc.endDictionary();
+
+            BOOST_REQUIRE(reply::Ping::make(transaction,id) == enc.value());
+            BOOST_REQUIRE_EQUAL(reply::Ping::encodedSize(transaction),enc.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(find_node_query)
+{
+    for ( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const auto id = dht::NodeData::getRandom();
+        const auto target = dht::NodeData::getRandom();
+        for ( const utils::Buffer& transaction : transactions() )
+        {
+            BEncodeEncoder enc;
+            enc.startDictionary();
+            enc.addElement(Field::Arguments);
+            enc.startDictionary();
+            enc.addDictionaryElement(Field::PeerID,id.write());
+            enc.addDictionaryElement(Field::Target,target.write());
+            enc.endDictionary();
+            enc.addDictionaryElement(Field::Query,Messages::FindNode);
+            enc.addDictionaryElement(Field::TransactionID,transaction);
+            enc.addDictionaryElement(Field::Type,Type::Query);
+            enc.endDictionary();
+
+            BOOST_REQUIRE(query::FindNode::make(transaction,id,target) == enc.value());
+            BOOST_REQUIRE_EQUAL(query::FindNode::encodedSize(transaction),enc.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(output_too_small)
+{
+    const auto id = dht::NodeData::getRandom();
+    const auto transaction = utils::makeBuffer("aa");
+
+    uint8_t output[128];
+    const size_t size = query::Ping::encodedSize(transaction);
+
+    BOOST_REQUIRE_THROW(
+        query::Ping::make(output,size-1,transaction,id),std::length_error);
+    BOOST_REQUIRE_EQUAL(query::Ping::make(output,size,transaction,id),size);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
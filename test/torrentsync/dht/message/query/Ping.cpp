@@ -29,6 +29,27 @@ BOOST_AUTO_TEST_CASE(generation_1)
         utils::makeBuffer("d1:ad2:id20:GGGGGGGGHHHHHHHHIIIIe1:q4:ping1:t2:aa1:y1:qe") == ret);
 }
 
+BOOST_AUTO_TEST_CASE(generation_fixed_output)
+{
+    auto transaction = utils::makeBuffer("aa");
+    auto expected = utils::makeBuffer("d1:ad2:id20:GGGGGGGGHHHHHHHHIIIIe1:q4:ping1:t2:aa1:y1:qe");
+    utils::Buffer b = {71,71,71,71,71,71,71,71,72,72,72,72,72,72,72,72,73,73,73,73};
+    dht::NodeData data;
+    data.read(b.cbegin(),b.cend());
+
+    BOOST_REQUIRE_EQUAL(Ping::encodedSize(transaction),expected.size());
+
+    uint8_t output[128];
+    size_t size = 0;
+    BOOST_REQUIRE_NO_THROW(
+        size = Ping::make(output,sizeof(output),transaction,data));
+    BOOST_REQUIRE_EQUAL(size,expected.size());
+    BOOST_REQUIRE(std::equal(expected.cbegin(),expected.cend(),output));
+
+    BOOST_REQUIRE_THROW(
+        Ping::make(output,expected.size()-1,transaction,data),std::length_error);
+}
+
 BOOST_AUTO_TEST_CASE(parse)
 {
     auto b = utils::makeBuffer("d1:ad2:id20:GGGGGGGGHHHHHHHHIIIIe1:q4:ping1:t2:aa1:y1:qe");
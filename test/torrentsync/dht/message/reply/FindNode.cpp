@@ -1,12 +1,14 @@
 #include <boost/test/unit_test.hpp>
 
 #include <torrentsync/dht/message/reply/FindNode.h>
+#include <torrentsync/dht/DHTConstants.h>
 #include <torrentsync/dht/Node.h>
 #include <torrentsync/utils/Yield.h>
 
 #include <test/torrentsync/dht/CommonNodeTest.h>
 
 #include <sstream>
+#include <vector>
 
 
 BOOST_AUTO_TEST_SUITE(torrentsync_dht_message_reply_FindNode);
@@ -25,12 +27,12 @@ BOOST_AUTO_TEST_CASE(reply_perfectMatch)
     dht::NodeData source(utils::parseIDFromHex(id1));
     dht::NodeData target(utils::parseIDFromHex(id2));
     
-    // 0x4747 => 'GG', 0x45454545 => 'EEEE'
+    // network order: 0x47474545 => 'GGEE', 0x4446 => 'DF'
     boost::optional<boost::asio::ip::udp::endpoint> endpoint(
         boost::asio::ip::udp::endpoint(
-             boost::asio::ip::address_v4(0x45454747),0x4644));
+             boost::asio::ip::address_v4(0x47474545),0x4446));
     
-    std::shared_ptr<dht::Node> match(new dht::Node(target.write(),endpoint));
+    dht::NodeSPtr match(new dht::Node(target.write(),endpoint));
     
     std::list<dht::NodeSPtr> nodes;
     nodes.push_back(match);
@@ -57,8 +59,8 @@ BOOST_AUTO_TEST_CASE(reply_perfectMatch)
     BOOST_CHECK(find_node.getTransactionID() == transaction);
     
     BOOST_REQUIRE(peers[0]->write() == utils::makeBuffer("HHHHHHHHHHHHHHHHHHHH"));
-    BOOST_REQUIRE_EQUAL(peers[0]->getEndpoint()->address().to_v4().to_ulong(), 0x45454747);
-    BOOST_REQUIRE_EQUAL(peers[0]->getEndpoint()->port(), 0x4644);
+    BOOST_REQUIRE_EQUAL(peers[0]->getEndpoint()->address().to_v4().to_ulong(), 0x47474545);
+    BOOST_REQUIRE_EQUAL(peers[0]->getEndpoint()->port(), 0x4446);
 }
 
 BOOST_AUTO_TEST_CASE(reply_multiple)
@@ -78,7 +80,7 @@ BOOST_AUTO_TEST_CASE(reply_multiple)
     
     boost::optional<boost::asio::ip::udp::endpoint> endpoint(
         boost::asio::ip::udp::endpoint(
-             boost::asio::ip::address_v4(0x45454747),0x4644));
+             boost::asio::ip::address_v4(0x47474545),0x4446));
     
     std::list<dht::NodeSPtr> nodes;
     BOOST_REQUIRE_NO_THROW(
@@ -94,6 +96,7 @@ BOOST_AUTO_TEST_CASE(reply_multiple)
             utils::makeYield(nodes.cbegin(),nodes.cend()).function()));
 
     BOOST_REQUIRE(ret == buff);
+    BOOST_REQUIRE_EQUAL(reply::FindNode::encodedSize(transaction,nodes.size()),buff.size());
     
     const auto m = dht::message::Message::parseMessage(ret);
     BOOST_REQUIRE(!!m);
@@ -108,16 +111,78 @@ BOOST_AUTO_TEST_CASE(reply_multiple)
     BOOST_CHECK(find_node.getTransactionID() == transaction);
     
     BOOST_CHECK(peers[0]->write() == utils::makeBuffer("HHHHHHHHHHHHHHHHHHHH"));
-    BOOST_CHECK_EQUAL(peers[0]->getEndpoint()->address().to_v4().to_ulong(), 0x45454747);
-    BOOST_CHECK_EQUAL(peers[0]->getEndpoint()->port(), 0x4644);
+    BOOST_CHECK_EQUAL(peers[0]->getEndpoint()->address().to_v4().to_ulong(), 0x47474545);
+    BOOST_CHECK_EQUAL(peers[0]->getEndpoint()->port(), 0x4446);
     
     BOOST_CHECK(peers[1]->write() == utils::makeBuffer("AAAAAAAAAAAAAAAAAAAA"));
-    BOOST_CHECK_EQUAL(peers[1]->getEndpoint()->address().to_v4().to_ulong(), 0x45454747);
-    BOOST_CHECK_EQUAL(peers[1]->getEndpoint()->port(), 0x4644);
+    BOOST_CHECK_EQUAL(peers[1]->getEndpoint()->address().to_v4().to_ulong(), 0x47474545);
+    BOOST_CHECK_EQUAL(peers[1]->getEndpoint()->port(), 0x4446);
     
     BOOST_CHECK(peers[2]->write() == utils::makeBuffer("BBBBBBBBBBBBBBBBBBBB"));
-    BOOST_CHECK_EQUAL(peers[2]->getEndpoint()->address().to_v4().to_ulong(), 0x45454747);
-    BOOST_CHECK_EQUAL(peers[2]->getEndpoint()->port(), 0x4644);
+    BOOST_CHECK_EQUAL(peers[2]->getEndpoint()->address().to_v4().to_ulong(), 0x47474545);
+    BOOST_CHECK_EQUAL(peers[2]->getEndpoint()->port(), 0x4446);
+}
+
+BOOST_AUTO_TEST_CASE(reply_too_many_nodes)
+{
+    const auto transaction = utils::makeBuffer("aa");
+
+    std::vector<dht::NodeSPtr> nodes;
+    for( size_t i = 0; i < DHT_FIND_NODE_COUNT*2; ++i )
+    {
+        nodes.push_back(dht::makeNode(dht::NodeData::getRandom(),
+            boost::asio::ip::udp::endpoint(
+                boost::asio::ip::address_v4(0x47474545),0x4446)));
+    }
+
+    // the first nodes fill the reply, the others are left out
+    const utils::Buffer ret = reply::FindNode::make(
+        transaction,
+        dht::NodeData::getRandom(),
+        utils::makeYield(nodes.cbegin(),nodes.cend()).function());
+    BOOST_REQUIRE_EQUAL(reply::FindNode::encodedSize(transaction,DHT_FIND_NODE_COUNT),ret.size());
+
+    const reply::FindNode find_node(*dht::message::Message::parseMessage(ret));
+    const std::vector<dht::NodeSPtr> peers = find_node.getNodes();
+    BOOST_REQUIRE_EQUAL(peers.size(),DHT_FIND_NODE_COUNT);
+    for( size_t i = 0; i < peers.size(); ++i )
+    {
+        BOOST_REQUIRE(*peers[i] == *nodes[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compact_nodes_view)
+{
+    auto buff = utils::makeBuffer("d1:rd2:id20:GGGGGGGGGGGGGGGGGGGG5:nodes80:HHHHHHHHHHHHHHHHHHHHGGEEDFAAAAAAAAAAAAAAAAAAAAGGEEDFBBBBBBBBBBBBBBBBBBBBGGEEDFxxe1:t2:aa1:y1:re");
+
+    const auto m = dht::message::Message::parseMessage(buff);
+    BOOST_REQUIRE(!!m);
+    const reply::FindNode find_node(*m);
+
+    // the trailing incomplete record is ignored
+    const CompactNodeView view = find_node.getCompactNodes();
+    BOOST_REQUIRE_EQUAL(view.size(),3);
+    BOOST_REQUIRE_EQUAL(std::distance(view.begin(),view.end()),3);
+
+    const char ids[] = { 'H', 'A', 'B' };
+    size_t i = 0;
+    for( const CompactNode& node : view )
+    {
+        BOOST_REQUIRE(node.id.write() == utils::makeBuffer(std::string(20,ids[i])));
+        BOOST_REQUIRE_EQUAL(node.endpoint.address().to_v4().to_ulong(), 0x47474545);
+        BOOST_REQUIRE_EQUAL(node.endpoint.port(), 0x4446);
+        BOOST_REQUIRE(view[i].id == node.id);
+        ++i;
+    }
+
+    // same result as the allocated nodes
+    const std::vector<dht::NodeSPtr> nodes = find_node.getNodes();
+    BOOST_REQUIRE_EQUAL(nodes.size(),view.size());
+    for( i = 0; i < nodes.size(); ++i )
+    {
+        BOOST_REQUIRE(*nodes[i] == view[i].id);
+        BOOST_REQUIRE(*nodes[i]->getEndpoint() == view[i].endpoint);
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END();
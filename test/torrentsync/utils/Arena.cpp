@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/Arena.h>
+#include <torrentsync/dht/message/Message.h>
+#include <torrentsync/dht/message/query/Ping.h>
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_Arena);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+BOOST_AUTO_TEST_CASE(alignment)
+{
+    Arena arena(256);
+
+    for( size_t alignment = 1; alignment <= 64; alignment *= 2 )
+    {
+        arena.allocate(1,1);
+        void* p = arena.allocate(8,alignment);
+        BOOST_REQUIRE_EQUAL(reinterpret_cast<uintptr_t>(p) % alignment,0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(reset_reuses_memory)
+{
+    Arena arena(128);
+
+    void* first = arena.allocate(100);
+    arena.allocate(100);
+    arena.allocate(1000);
+    BOOST_REQUIRE(arena.used() >= 1200);
+    const size_t capacity = arena.capacity();
+
+    arena.reset();
+    BOOST_REQUIRE_EQUAL(arena.used(),0);
+    BOOST_REQUIRE_EQUAL(arena.allocate(100),first);
+    arena.allocate(100);
+    arena.allocate(1000);
+    BOOST_REQUIRE_EQUAL(arena.capacity(),capacity);
+}
+
+BOOST_AUTO_TEST_CASE(allocator)
+{
+    Arena arena(64);
+    {
+        std::vector<int,ArenaAllocator<int> > v{ArenaAllocator<int>(arena)};
+        for( int i = 0; i < 1000; ++i )
+            v.push_back(i);
+        for( int i = 0; i < 1000; ++i )
+            BOOST_REQUIRE_EQUAL(v[i],i);
+    }
+    BOOST_REQUIRE(arena.used() >= 1000*sizeof(int));
+}
+
+BOOST_AUTO_TEST_CASE(message_in_place)
+{
+    using namespace torrentsync::dht::message;
+
+    Arena arena;
+    const utils::Buffer packet = utils::makeBuffer(
+        "d1:ad2:id20:GGGGGGGGHHHHHHHHIIIIe1:q4:ping1:t2:aa1:y1:qe");
+
+    std::shared_ptr<Message> copy;
+    {
+        auto m = Message::parseMessage(packet.data(),packet.size(),arena);
+        BOOST_REQUIRE(!!m);
+        BOOST_REQUIRE(arena.used() > 0);
+        BOOST_REQUIRE_EQUAL(m->getKind(),KRPC::PING_QUERY);
+        BOOST_REQUIRE(dynamic_cast<query::Ping*>(m.get()));
+
+        // fields reference the packet, no copy
+        BOOST_REQUIRE(m->getID().data() == packet.data()+12);
+        BOOST_REQUIRE(m->getTransactionID() == "aa");
+
+        copy.reset(new Message(*m));
+    }
+    arena.reset();
+
+    BOOST_REQUIRE(copy->getID().data() != packet.data()+12);
+    BOOST_REQUIRE(copy->getID() == "GGGGGGGGHHHHHHHHIIII");
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,228 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/BatchedSocket.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_BatchedSocket);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+using boost::asio::ip::udp;
+
+namespace
+{
+//! a socket bound to a random port of the loopback
+struct LoopbackSocket
+{
+    LoopbackSocket( boost::asio::io_service& service ) : socket(service)
+    {
+        socket.open(udp::v4());
+        socket.bind(udp::endpoint(boost::asio::ip::address_v4::loopback(),0));
+    }
+
+    udp::socket socket;
+};
+};
+
+BOOST_AUTO_TEST_CASE(send_and_receive)
+{
+    boost::asio::io_service service;
+    LoopbackSocket receiver(service);
+    LoopbackSocket sender(service);
+
+    BatchedSocket in(receiver.socket,64,SendQueue::Config(TEST_LOOP_COUNT),8);
+    BatchedSocket out(sender.socket,64,SendQueue::Config(TEST_LOOP_COUNT),8);
+
+    std::vector<std::string> received;
+    in.startReceive([&](
+        const boost::system::error_code& error,
+        const ReceiveRing::Slot& slot)
+        {
+            BOOST_REQUIRE(!error);
+            BOOST_REQUIRE_EQUAL(slot.sender,sender.socket.local_endpoint());
+            received.push_back(std::string(slot.data,slot.data+slot.length));
+        });
+
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const std::string data = std::to_string(i);
+        BOOST_REQUIRE(out.send(Buffer(data.begin(),data.end()),
+            receiver.socket.local_endpoint()));
+    }
+    BOOST_REQUIRE_EQUAL(out.queued(),TEST_LOOP_COUNT);
+
+    // the queue is full
+    BOOST_REQUIRE(!out.send(Buffer(1,'x'),receiver.socket.local_endpoint()));
+
+    while (received.size() < TEST_LOOP_COUNT)
+    {
+        service.run_one();
+    }
+    BOOST_REQUIRE_EQUAL(out.queued(),0);
+
+    // the order is kept on the loopback
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        BOOST_REQUIRE_EQUAL(received[i],std::to_string(i));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(failed_send_is_dropped)
+{
+    boost::asio::io_service service;
+    LoopbackSocket receiver(service);
+    LoopbackSocket sender(service);
+
+    BatchedSocket in(receiver.socket,64);
+    BatchedSocket out(sender.socket,64);
+
+    size_t received = 0;
+    in.startReceive([&](
+        const boost::system::error_code& error,
+        const ReceiveRing::Slot&)
+        {
+            BOOST_REQUIRE(!error);
+            ++received;
+        });
+
+    // an IPv6 destination from an IPv4 socket fails, the next are sent
+    BOOST_REQUIRE(out.send(Buffer(1,'x'),
+        udp::endpoint(boost::asio::ip::address_v6::loopback(),6881)));
+    BOOST_REQUIRE(out.send(Buffer(1,'y'),receiver.socket.local_endpoint()));
+
+    while (received < 1)
+    {
+        service.run_one();
+    }
+    BOOST_REQUIRE_EQUAL(out.queued(),0);
+    BOOST_REQUIRE_THROW(BatchedSocket(sender.socket,64,SendQueue::Config(),0),std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(handler_exception_is_contained)
+{
+    boost::asio::io_service service;
+    LoopbackSocket receiver(service);
+    LoopbackSocket sender(service);
+
+    BatchedSocket in(receiver.socket,64,SendQueue::Config(TEST_LOOP_COUNT),8);
+    BatchedSocket out(sender.socket,64,SendQueue::Config(TEST_LOOP_COUNT),8);
+
+    // every other datagram fails, the rest of the batch and the next
+    // batches are still received
+    size_t received = 0;
+    in.startReceive([&](
+        const boost::system::error_code& error,
+        const ReceiveRing::Slot&)
+        {
+            BOOST_REQUIRE(!error);
+            if (received++ % 2 == 0)
+                throw std::runtime_error("handler failure");
+        });
+
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        BOOST_REQUIRE(out.send(Buffer(1,'x'),receiver.socket.local_endpoint()));
+    }
+
+    while (received < TEST_LOOP_COUNT)
+    {
+        BOOST_REQUIRE_NO_THROW(service.run_one());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rate_limited_class_waits)
+{
+    boost::asio::io_service service;
+    LoopbackSocket receiver(service);
+    LoopbackSocket sender(service);
+
+    // a datagram every 10ms after the first
+    SendQueue::Config config;
+    config.limits[SendQueue::MAINTENANCE] = SendQueue::Limits{100,1};
+
+    BatchedSocket in(receiver.socket,64);
+    BatchedSocket out(sender.socket,64,config);
+
+    size_t received = 0;
+    in.startReceive([&](
+        const boost::system::error_code& error,
+        const ReceiveRing::Slot&)
+        {
+            BOOST_REQUIRE(!error);
+            ++received;
+        });
+
+    const auto start = SendQueue::clock::now();
+    for( size_t i = 0; i < 4; ++i )
+    {
+        BOOST_REQUIRE(out.send(Buffer(1,'m'),receiver.socket.local_endpoint(),
+            SendQueue::MAINTENANCE));
+    }
+
+    while (received < 4)
+    {
+        service.run_one();
+    }
+    BOOST_REQUIRE(SendQueue::clock::now()-start >= std::chrono::milliseconds(29));
+    BOOST_REQUIRE_EQUAL(out.getCounters(SendQueue::MAINTENANCE).sent,4);
+    BOOST_REQUIRE_EQUAL(out.getCounters(SendQueue::MAINTENANCE).maxDepth,4);
+    BOOST_REQUIRE_EQUAL(out.queued(),0);
+}
+
+BOOST_AUTO_TEST_CASE(reply_overtakes_the_rate_limit)
+{
+    boost::asio::io_service service;
+    LoopbackSocket receiver(service);
+    LoopbackSocket sender(service);
+
+    // the second maintenance datagram waits a second
+    SendQueue::Config config;
+    config.limits[SendQueue::MAINTENANCE] = SendQueue::Limits{1,1};
+
+    BatchedSocket in(receiver.socket,64);
+    BatchedSocket out(sender.socket,64,config);
+
+    std::vector<std::string> received;
+    in.startReceive([&](
+        const boost::system::error_code& error,
+        const ReceiveRing::Slot& slot)
+        {
+            BOOST_REQUIRE(!error);
+            received.push_back(std::string(slot.data,slot.data+slot.length));
+        });
+
+    const auto start = SendQueue::clock::now();
+    BOOST_REQUIRE(out.send(Buffer(1,'m'),receiver.socket.local_endpoint(),
+        SendQueue::MAINTENANCE));
+    BOOST_REQUIRE(out.send(Buffer(1,'m'),receiver.socket.local_endpoint(),
+        SendQueue::MAINTENANCE));
+    while (received.size() < 1)
+    {
+        service.run_one();
+    }
+
+    // the flush is waiting for the tokens, the reply is sent anyway
+    BOOST_REQUIRE(out.send(Buffer(1,'r'),receiver.socket.local_endpoint()));
+    while (received.size() < 2)
+    {
+        service.run_one();
+    }
+    BOOST_REQUIRE_EQUAL(received[1],"r");
+    BOOST_REQUIRE(SendQueue::clock::now()-start < std::chrono::milliseconds(500));
+    BOOST_REQUIRE_EQUAL(out.queued(),1);
+
+    // the maintenance still waits for its token
+    while (received.size() < 3)
+    {
+        service.run_one();
+    }
+    BOOST_REQUIRE_EQUAL(received[2],"m");
+    BOOST_REQUIRE(SendQueue::clock::now()-start >= std::chrono::milliseconds(900));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,86 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/GracePeriod.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_GracePeriod);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+BOOST_AUTO_TEST_CASE(no_readers)
+{
+    GracePeriod period;
+    period.synchronize();
+
+    {
+        GracePeriod::ReadGuard guard(period);
+    }
+    period.synchronize();
+}
+
+BOOST_AUTO_TEST_CASE(waits_for_readers)
+{
+    GracePeriod period;
+    std::atomic<bool> reading(false);
+    std::atomic<bool> done(false);
+
+    std::thread reader([&]()
+    {
+        GracePeriod::ReadGuard guard(period);
+        reading = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        done = true;
+    });
+
+    while (!reading)
+        std::this_thread::yield();
+
+    period.synchronize();
+    BOOST_REQUIRE(done);
+    reader.join();
+}
+
+BOOST_AUTO_TEST_CASE(publish_and_free)
+{
+    // readers never see a freed value: it's poisoned only after synchronize
+    GracePeriod period;
+    std::atomic<int*> value(new int(0));
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> errors(0);
+
+    std::vector<std::thread> readers;
+    for( int i = 0; i < 4; ++i )
+    {
+        readers.push_back(std::thread([&]()
+        {
+            while (!stop)
+            {
+                GracePeriod::ReadGuard guard(period);
+                if (*value.load() < 0)
+                    ++errors;
+            }
+        }));
+    }
+
+    for( int i = 1; i < 1000; ++i )
+    {
+        int* old = value.exchange(new int(i));
+        period.synchronize();
+        *old = -1;
+        delete old;
+    }
+
+    stop = true;
+    for( std::thread& reader : readers )
+        reader.join();
+    delete value.load();
+
+    BOOST_REQUIRE_EQUAL(errors,0);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,84 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/RandomGenerator.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_RandomGenerator);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+BOOST_AUTO_TEST_CASE(seeded)
+{
+    const uint64_t seed[4] = { 1, 2, 3, 4 };
+    RandomGenerator first(seed);
+    RandomGenerator second(seed);
+
+    // first value of xoshiro256** from the seed 1,2,3,4
+    BOOST_REQUIRE_EQUAL(first.get64(),11520);
+    second.get64();
+
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        BOOST_REQUIRE_EQUAL(first.get64(),second.get64());
+    }
+
+    // the all zero seed would be stuck on zero
+    const uint64_t zeros[4] = { 0, 0, 0, 0 };
+    RandomGenerator zero(zeros);
+    uint64_t value = 0;
+    for( size_t i = 0; i < 4; ++i )
+        value |= zero.get64();
+    BOOST_REQUIRE(value != 0);
+}
+
+BOOST_AUTO_TEST_CASE(fill)
+{
+    const uint64_t seed[4] = { 5, 6, 7, 8 };
+    for( size_t length = 0; length < 40; ++length )
+    {
+        RandomGenerator generator(seed);
+        std::vector<uint8_t> data(length+1,0xAA);
+        generator.fill(data.data(),length);
+
+        // nothing written past the end
+        BOOST_REQUIRE_EQUAL(data[length],0xAA);
+
+        // the bytes are the ones of the 64 bit values
+        RandomGenerator check(seed);
+        for( size_t i = 0; i < length; i += 8 )
+        {
+            const uint64_t value = check.get64();
+            for( size_t j = 0; j < 8 && i+j < length; ++j )
+            {
+                BOOST_REQUIRE_EQUAL(data[i+j],reinterpret_cast<const uint8_t*>(&value)[j]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(thread_instances)
+{
+    RandomGenerator* const local = &RandomGenerator::getInstance();
+    BOOST_REQUIRE_EQUAL(local,&RandomGenerator::getInstance());
+
+    RandomGenerator* other = nullptr;
+    uint64_t otherValue = 0;
+    std::thread thread([&]()
+    {
+        other = &RandomGenerator::getInstance();
+        otherValue = other->get64();
+    });
+    thread.join();
+
+    BOOST_REQUIRE(other != local);
+    // differently seeded, 2^-64 chance of failure
+    BOOST_REQUIRE(otherValue != RandomGenerator::getInstance().get64());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,58 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/ReceiveRing.h>
+
+#include <cstring>
+#include <set>
+#include <stdexcept>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_ReceiveRing);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+BOOST_AUTO_TEST_CASE(acquire_and_release_in_order)
+{
+    ReceiveRing ring(4,64);
+    BOOST_REQUIRE_EQUAL(ring.capacity(),4);
+    BOOST_REQUIRE_EQUAL(ring.slotSize(),64);
+    BOOST_REQUIRE_EQUAL(ring.available(),4);
+
+    // distinct buffers
+    std::set<uint8_t*> buffers;
+    for( size_t i = 0; i < ring.available(); ++i )
+    {
+        buffers.insert(ring.next(i).data);
+    }
+    BOOST_REQUIRE_EQUAL(buffers.size(),4);
+
+    // filled and released in the same order, wrapping around the ring
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const size_t count = 1 + i%4;
+        for( size_t j = 0; j < count; ++j )
+        {
+            ReceiveRing::Slot& slot = ring.next(j);
+            BOOST_REQUIRE(buffers.count(slot.data));
+            memset(slot.data,static_cast<int>(j),ring.slotSize());
+            slot.length = j;
+        }
+        ring.acquire(count);
+        BOOST_REQUIRE_EQUAL(ring.size(),count);
+        BOOST_REQUIRE_EQUAL(ring.available(),4-count);
+
+        for( size_t j = 0; j < count; ++j )
+        {
+            BOOST_REQUIRE_EQUAL(ring.front().length,j);
+            BOOST_REQUIRE_EQUAL(ring.front().data[ring.slotSize()-1],j);
+            ring.release();
+        }
+        BOOST_REQUIRE_EQUAL(ring.size(),0);
+    }
+
+    BOOST_REQUIRE_THROW(ReceiveRing(0,64),std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,121 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/SendQueue.h>
+
+#include <chrono>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_SendQueue);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+namespace
+{
+const SendQueue::endpoint_t destination(boost::asio::ip::address_v4::loopback(),6881);
+
+//! a queue without rate limits
+SendQueue::Config unlimited( const size_t maxQueue )
+{
+    SendQueue::Config config(maxQueue);
+    for( SendQueue::Limits& limits : config.limits )
+        limits = SendQueue::Limits{0,0};
+    return config;
+}
+};
+
+BOOST_AUTO_TEST_CASE(priority_order)
+{
+    SendQueue queue(unlimited(TEST_LOOP_COUNT));
+    BOOST_REQUIRE(queue.push(SendQueue::MAINTENANCE,Buffer(1,'m'),destination));
+    BOOST_REQUIRE(queue.push(SendQueue::LOOKUP,Buffer(1,'l'),destination));
+    BOOST_REQUIRE(queue.push(SendQueue::REPLY,Buffer(1,'r'),destination));
+    BOOST_REQUIRE(queue.push(SendQueue::REPLY,Buffer(1,'R'),destination));
+    BOOST_REQUIRE_EQUAL(queue.size(),4);
+
+    const SendQueue::clock::time_point now = SendQueue::clock::now();
+    SendQueue::Datagram datagram;
+    for( const char expected : { 'r', 'R', 'l', 'm' } )
+    {
+        BOOST_REQUIRE(queue.pop(datagram,now));
+        BOOST_REQUIRE_EQUAL(datagram.buffer[0],expected);
+        BOOST_REQUIRE_EQUAL(datagram.destination,destination);
+    }
+    BOOST_REQUIRE(!queue.pop(datagram,now));
+    BOOST_REQUIRE(queue.empty());
+    BOOST_REQUIRE(queue.nextReady(now) == SendQueue::clock::duration::max());
+
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::REPLY).queued,2);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::REPLY).sent,2);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::REPLY).maxDepth,2);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::REPLY).depth,0);
+}
+
+BOOST_AUTO_TEST_CASE(full_queue_drops_the_lower_classes)
+{
+    SendQueue queue(unlimited(4));
+    for( size_t i = 0; i < 2; ++i )
+    {
+        BOOST_REQUIRE(queue.push(SendQueue::MAINTENANCE,Buffer(1,'m'),destination));
+        BOOST_REQUIRE(queue.push(SendQueue::LOOKUP,Buffer(1,'l'),destination));
+    }
+
+    // the same class can't make room
+    BOOST_REQUIRE(!queue.push(SendQueue::MAINTENANCE,Buffer(1,'m'),destination));
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::MAINTENANCE).dropped,1);
+
+    // the maintenance first, then the lookups
+    for( size_t i = 0; i < 4; ++i )
+    {
+        BOOST_REQUIRE(queue.push(SendQueue::REPLY,Buffer(1,'r'),destination));
+        BOOST_REQUIRE_EQUAL(queue.size(),4);
+    }
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::MAINTENANCE).dropped,3);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::MAINTENANCE).depth,0);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::LOOKUP).dropped,2);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::LOOKUP).depth,0);
+
+    // full of replies
+    BOOST_REQUIRE(!queue.push(SendQueue::REPLY,Buffer(1,'r'),destination));
+    BOOST_REQUIRE(!queue.push(SendQueue::LOOKUP,Buffer(1,'l'),destination));
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::REPLY).dropped,1);
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::REPLY).depth,4);
+}
+
+BOOST_AUTO_TEST_CASE(rate_limits)
+{
+    SendQueue::Config config = unlimited(TEST_LOOP_COUNT);
+    config.limits[SendQueue::MAINTENANCE] = SendQueue::Limits{10,2};
+    SendQueue queue(config);
+
+    for( size_t i = 0; i < 5; ++i )
+        BOOST_REQUIRE(queue.push(SendQueue::MAINTENANCE,Buffer(1,'m'),destination));
+    BOOST_REQUIRE(queue.push(SendQueue::LOOKUP,Buffer(1,'l'),destination));
+
+    const SendQueue::clock::time_point now = SendQueue::clock::now();
+    SendQueue::Datagram datagram;
+
+    // the burst, then the unlimited lookup still goes
+    BOOST_REQUIRE(queue.pop(datagram,now));
+    BOOST_REQUIRE_EQUAL(datagram.buffer[0],'l');
+    BOOST_REQUIRE(queue.pop(datagram,now));
+    BOOST_REQUIRE(queue.pop(datagram,now));
+    BOOST_REQUIRE(!queue.pop(datagram,now));
+
+    // a token every 100ms
+    const SendQueue::clock::duration wait = queue.nextReady(now);
+    BOOST_REQUIRE(wait > std::chrono::milliseconds(99));
+    BOOST_REQUIRE(wait <= std::chrono::milliseconds(101));
+    BOOST_REQUIRE(!queue.pop(datagram,now+std::chrono::milliseconds(50)));
+    BOOST_REQUIRE(queue.pop(datagram,now+wait));
+    BOOST_REQUIRE(!queue.pop(datagram,now+wait));
+
+    // never more than the burst
+    BOOST_REQUIRE(queue.pop(datagram,now+std::chrono::seconds(10)));
+    BOOST_REQUIRE(queue.pop(datagram,now+std::chrono::seconds(10)));
+    BOOST_REQUIRE(queue.empty());
+    BOOST_REQUIRE_EQUAL(queue.getCounters(SendQueue::MAINTENANCE).sent,5);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
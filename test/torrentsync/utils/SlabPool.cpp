@@ -0,0 +1,81 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/SlabPool.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_SlabPool);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+BOOST_AUTO_TEST_CASE(allocate_and_reuse)
+{
+    // 3 slots for every slab
+    SlabPool pool(40,8,128);
+    BOOST_REQUIRE_EQUAL(pool.slotSize(),40);
+    BOOST_REQUIRE_EQUAL(pool.capacity(),0);
+
+    std::vector<void*> slots;
+    std::set<void*> distinct;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        void* const slot = pool.allocate();
+        BOOST_REQUIRE_EQUAL(reinterpret_cast<uintptr_t>(slot) % 8,0);
+        memset(slot,0xff,pool.slotSize());
+        slots.push_back(slot);
+        distinct.insert(slot);
+    }
+    BOOST_REQUIRE_EQUAL(distinct.size(),TEST_LOOP_COUNT);
+    BOOST_REQUIRE_EQUAL(pool.used(),TEST_LOOP_COUNT);
+    BOOST_REQUIRE_EQUAL(pool.capacity(),(TEST_LOOP_COUNT+2)/3*3);
+
+    // the released slots are reused before growing
+    const size_t capacity = pool.capacity();
+    for( void* slot : slots )
+        pool.deallocate(slot);
+    BOOST_REQUIRE_EQUAL(pool.used(),0);
+
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        BOOST_REQUIRE(distinct.count(pool.allocate()));
+    }
+    BOOST_REQUIRE_EQUAL(pool.capacity(),capacity);
+}
+
+BOOST_AUTO_TEST_CASE(slot_size)
+{
+    // at least a pointer, rounded to the alignment
+    BOOST_REQUIRE_EQUAL(SlabPool(1,1).slotSize(),sizeof(void*));
+    BOOST_REQUIRE_EQUAL(SlabPool(17,16).slotSize(),32);
+}
+
+BOOST_AUTO_TEST_CASE(allocate_shared)
+{
+    struct Counted
+    {
+        Counted( int& count ) : _count(count) { ++_count; }
+        ~Counted() { --_count; }
+        int& _count;
+    };
+
+    int count = 0;
+    {
+        std::vector<std::shared_ptr<Counted> > objects;
+        for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+        {
+            objects.push_back(std::allocate_shared<Counted>(
+                PoolAllocator<Counted>(),count));
+        }
+        BOOST_REQUIRE_EQUAL(count,TEST_LOOP_COUNT);
+    }
+    BOOST_REQUIRE_EQUAL(count,0);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,128 @@
+#include <boost/test/unit_test.hpp>
+
+#include <torrentsync/utils/TimerWheel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include <test/torrentsync/dht/CommonNodeTest.h>
+
+BOOST_AUTO_TEST_SUITE(torrentsync_utils_TimerWheel);
+
+using namespace torrentsync;
+using namespace torrentsync::utils;
+
+static const TimerWheel::duration TICK = std::chrono::milliseconds(10);
+
+BOOST_AUTO_TEST_CASE(expires_in_order)
+{
+    boost::asio::io_service service;
+    TimerWheel wheel(service,TICK);
+
+    // deadlines spread across all the levels, every timer must expire at
+    // exactly its tick after being cascaded down
+    std::vector<uint64_t> deadlines;
+    std::vector<uint64_t> expired;
+    for( size_t i = 0; i < TEST_LOOP_COUNT; ++i )
+    {
+        const uint64_t ticks = (static_cast<uint64_t>(rand()) << 8 | rand() % 256)
+            % (1 << (TimerWheel::SLOT_BITS*3+2));
+        deadlines.push_back(std::max<uint64_t>(ticks,1));
+        wheel.schedule(ticks*TICK,[&wheel,&expired](){ expired.push_back(wheel.now()); });
+    }
+    BOOST_REQUIRE_EQUAL(wheel.size(),TEST_LOOP_COUNT);
+
+    // now() is already past the expired tick when the callback is called
+    uint64_t last = 0;
+    size_t count = 0;
+    while (wheel.size() > 0)
+    {
+        const size_t before = expired.size();
+        count += wheel.advance(1);
+        for( size_t i = before; i < expired.size(); ++i )
+        {
+            BOOST_REQUIRE_EQUAL(expired[i],wheel.now());
+            BOOST_REQUIRE_GE(expired[i],last);
+            last = expired[i];
+        }
+    }
+    BOOST_REQUIRE_EQUAL(count,TEST_LOOP_COUNT);
+
+    std::sort(deadlines.begin(),deadlines.end());
+    for( size_t i = 0; i < deadlines.size(); ++i )
+    {
+        BOOST_REQUIRE_EQUAL(expired[i],deadlines[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(cancel)
+{
+    boost::asio::io_service service;
+    TimerWheel wheel(service,TICK);
+
+    size_t called = 0;
+    const TimerWheel::handle_t first  = wheel.schedule(5*TICK,[&](){ ++called; });
+    const TimerWheel::handle_t second = wheel.schedule(100*TICK,[&](){ ++called; });
+    BOOST_REQUIRE_NE(first,0);
+    BOOST_REQUIRE_NE(first,second);
+
+    BOOST_REQUIRE(wheel.cancel(second));
+    BOOST_REQUIRE(!wheel.cancel(second));
+    BOOST_REQUIRE_EQUAL(wheel.size(),1);
+
+    BOOST_REQUIRE_EQUAL(wheel.advance(200),1);
+    BOOST_REQUIRE_EQUAL(called,1);
+
+    // the handle of an expired timer is stale, even when the entry is reused
+    BOOST_REQUIRE(!wheel.cancel(first));
+    const TimerWheel::handle_t third = wheel.schedule(TICK,[&](){ ++called; });
+    BOOST_REQUIRE(!wheel.cancel(first));
+    BOOST_REQUIRE(wheel.cancel(third));
+    BOOST_REQUIRE(!wheel.cancel(0));
+}
+
+BOOST_AUTO_TEST_CASE(schedule_from_callback)
+{
+    boost::asio::io_service service;
+    TimerWheel wheel(service,TICK);
+
+    // a periodic timer rescheduling itself
+    size_t called = 0;
+    std::function<void ()> periodic = [&]() {
+        ++called;
+        wheel.schedule(10*TICK,periodic);
+    };
+    wheel.schedule(10*TICK,periodic);
+
+    wheel.advance(100);
+    BOOST_REQUIRE_EQUAL(called,10);
+    BOOST_REQUIRE_EQUAL(wheel.size(),1);
+
+    // a delay of zero expires at the next tick
+    wheel.schedule(TimerWheel::duration::zero(),[&](){ called = 0; });
+    wheel.advance(1);
+    BOOST_REQUIRE_EQUAL(called,0);
+}
+
+BOOST_AUTO_TEST_CASE(ticks_on_io_service)
+{
+    boost::asio::io_service service;
+    TimerWheel wheel(service,TICK);
+
+    bool called = false;
+    wheel.schedule(3*TICK,[&]() {
+        called = true;
+        wheel.stop();
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    wheel.start();
+    service.run();
+
+    BOOST_REQUIRE(called);
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - start >= 3*TICK);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
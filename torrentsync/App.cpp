@@ -2,19 +2,33 @@
 #include <boost/asio.hpp>
 #include <torrentsync/utils/log/Logger.h>
 
+#include <exception>
+
+//! file of the routing table saved between runs
+//! @TODO should come from the configuration
+static const char ROUTING_TABLE_SNAPSHOT[] = "routing_table.snapshot";
+
 namespace torrentsync
 {
 
-App::App( /* configuration */ ) :
+App::App( /* configuration */ const size_t receivers ) :
     _service(),
     _work(_service),
     _stop_signal(_service, SIGINT, SIGTERM),
-    _table(_service)
+    _snapshot(openSnapshot()),
+    _table(_service, _snapshot ? _snapshot->getTableNode() : dht::NodeData::getRandom())
 {
     // Initializes the various part of the application
     setupSignalHandlers();
 
-    _table.initializeNetwork(boost::asio::ip::udp::endpoint());
+    if (_snapshot)
+    {
+        _table.loadTable(*_snapshot);
+        _snapshot.reset();
+    }
+
+    // @TODO the number of receivers should come from the configuration
+    _table.initializeNetwork(boost::asio::ip::udp::endpoint(),receivers);
 }
 
 void App::runloop()
@@ -33,6 +47,14 @@ void App::setupSignalHandlers()
             if (!error)
             {
                 LOG(INFO,"Received signal: " << signal_number);
+                try
+                {
+                    _table.saveTable(ROUTING_TABLE_SNAPSHOT);
+                }
+                catch ( const std::exception& e )
+                {
+                    LOG(ERROR, "App * Can't save the routing table: " << e.what());
+                }
                 _service.stop();
             }
             else
@@ -44,5 +66,19 @@ void App::setupSignalHandlers()
     LOG(DEBUG,"App * Signals configured");
 }
 
+std::unique_ptr<dht::TableSnapshot> App::openSnapshot()
+{
+    try
+    {
+        return std::unique_ptr<dht::TableSnapshot>(
+            new dht::TableSnapshot(ROUTING_TABLE_SNAPSHOT));
+    }
+    catch ( const std::exception& e )
+    {
+        LOG(INFO, "App * No routing table to load: " << e.what());
+        return std::unique_ptr<dht::TableSnapshot>();
+    }
+}
+
 
 }; // torrentsync
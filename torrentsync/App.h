@@ -1,8 +1,11 @@
 #pragma once
 
 #include <torrentsync/dht/RoutingTable.h>
+#include <torrentsync/dht/TableSnapshot.h>
 #include <boost/asio.hpp>
 
+#include <memory>
+
 namespace torrentsync
 {
 
@@ -13,7 +16,9 @@ class App
 {
 public:
     //! @TODO Loads the configuration 
-    App( /* configuration */ );
+    //! @param receivers sockets sharing the DHT port, each one with its own
+    //!        thread. With 1 everything runs on the thread of runloop().
+    App( /* configuration */ const size_t receivers = 1 );
 
     //! this call will not return until the application has to stop.
     void runloop();
@@ -32,6 +37,12 @@ private:
     //! Setup up signal handlers
     void setupSignalHandlers();
 
+    //! @return the routing table saved by the previous run, if any
+    static std::unique_ptr<dht::TableSnapshot> openSnapshot();
+
+    //! The routing table of the previous run, released once loaded
+    std::unique_ptr<dht::TableSnapshot> _snapshot;
+
     //! The DHT routing table
     torrentsync::dht::RoutingTable _table;
 };
@@ -0,0 +1,120 @@
+#include <torrentsync/dht/EndpointIndex.h>
+
+#include <utility>
+
+namespace torrentsync
+{
+namespace dht
+{
+
+EndpointIndex::EndpointIndex( const size_t capacity ) :
+    _count(0),
+    _shift(64)
+{
+    size_t slots = 2;
+    --_shift;
+    while (slots < capacity)
+    {
+        slots <<= 1;
+        --_shift;
+    }
+    _slots.resize(slots);
+}
+
+size_t EndpointIndex::probe( const uint64_t key ) const noexcept
+{
+    const size_t mask = _slots.size()-1;
+    size_t i = home(key);
+    while (_slots[i].node && _slots[i].key != key)
+        i = (i+1) & mask;
+    return i;
+}
+
+bool EndpointIndex::insert( const NodeSPtr& node )
+{
+    const uint64_t key = node->getCompactEndpoint();
+    if (key == 0)
+        return false;
+
+    if ((_count+1)*2 > _slots.size())
+        grow();
+
+    Slot& slot = _slots[probe(key)];
+    if (!slot.node)
+        ++_count;
+    slot.key  = key;
+    slot.node = node;
+    return true;
+}
+
+bool EndpointIndex::erase( const Node& node ) noexcept
+{
+    const uint64_t key = node.getCompactEndpoint();
+    if (key == 0)
+        return false;
+
+    size_t hole = probe(key);
+    if (_slots[hole].node.get() != &node)
+        return false;
+
+    // moves back the following entries of the cluster which can't be
+    // found anymore past the hole
+    const size_t mask = _slots.size()-1;
+    for( size_t i = (hole+1) & mask; _slots[i].node; i = (i+1) & mask )
+    {
+        const size_t distance = (i - home(_slots[i].key)) & mask;
+        if (distance >= ((i - hole) & mask))
+        {
+            _slots[hole] = std::move(_slots[i]);
+            hole = i;
+        }
+    }
+    _slots[hole].node.reset();
+    _slots[hole].key = 0;
+    --_count;
+    return true;
+}
+
+boost::optional<NodeSPtr> EndpointIndex::find(
+    const udp::endpoint& endpoint ) const noexcept
+{
+    return find(Node::compactEndpoint(endpoint));
+}
+
+boost::optional<NodeSPtr> EndpointIndex::find(
+    const uint64_t key ) const noexcept
+{
+    if (key == 0)
+        return boost::optional<NodeSPtr>();
+
+    const Slot& slot = _slots[probe(key)];
+    if (!slot.node)
+        return boost::optional<NodeSPtr>();
+    return boost::optional<NodeSPtr>(slot.node);
+}
+
+void EndpointIndex::clear() noexcept
+{
+    for( Slot& slot : _slots )
+    {
+        slot.node.reset();
+        slot.key = 0;
+    }
+    _count = 0;
+}
+
+void EndpointIndex::grow()
+{
+    std::vector<Slot> old(_slots.size()*2);
+    old.swap(_slots);
+    --_shift;
+
+    for( Slot& slot : old )
+    {
+        if (slot.node)
+            _slots[probe(slot.key)] = std::move(slot);
+    }
+}
+
+}; // dht
+}; // torrentsync
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <torrentsync/dht/Node.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/utility.hpp>
+
+namespace torrentsync
+{
+namespace dht
+{
+
+/** Hash index of the nodes by their compact endpoint.
+ * Open addressing with linear probing on a power of two table kept at most
+ * half full, removals shift the following entries back instead of leaving
+ * tombstones. An endpoint maps to a single node, the last one inserted.
+ * Not thread safe.
+ */
+class EndpointIndex : public boost::noncopyable
+{
+public:
+
+    //! @param capacity initial number of slots, rounded to a power of two
+    explicit EndpointIndex( const size_t capacity = 64 );
+
+    /** maps the endpoint of the node to the node, replacing the previous
+     * node with the same endpoint
+     * @return false if the node has no endpoint
+     */
+    bool insert( const NodeSPtr& node );
+
+    //! removes the endpoint of the node, if it maps to this node
+    //! @return true if removed
+    bool erase( const Node& node ) noexcept;
+
+    //! @return the node using the endpoint, if any
+    boost::optional<NodeSPtr> find( const udp::endpoint& endpoint ) const noexcept;
+
+    //! @return the node with the compact endpoint, if any
+    boost::optional<NodeSPtr> find( const uint64_t key ) const noexcept;
+
+    size_t size() const noexcept { return _count; }
+
+    size_t capacity() const noexcept { return _slots.size(); }
+
+    //! removes every node, keeps the capacity
+    void clear() noexcept;
+
+private:
+
+    struct Slot
+    {
+        uint64_t key = 0;
+        NodeSPtr node;
+    };
+
+    //! @return the first slot to probe for the key
+    inline size_t home( const uint64_t key ) const noexcept;
+
+    //! @return the slot holding the key, or the empty slot ending the probe
+    size_t probe( const uint64_t key ) const noexcept;
+
+    //! doubles the slots and reinserts the nodes
+    void grow();
+
+    std::vector<Slot> _slots;
+
+    size_t _count;
+
+    //! 64 - log2 of the capacity
+    size_t _shift;
+};
+
+size_t EndpointIndex::home( const uint64_t key ) const noexcept
+{
+    // fibonacci hashing, the high bits of the product are well mixed
+    return (key * UINT64_C(0x9E3779B97F4A7C15)) >> _shift;
+}
+
+}; // dht
+}; // torrentsync
@@ -1,8 +1,12 @@
 #include <torrentsync/dht/Node.h>
 #include <torrentsync/utils/log/Logger.h>
+#include <torrentsync/utils/Endian.h>
 
 #include <boost/integer_traits.hpp>
 
+#include <algorithm>
+#include <stdexcept>
+
 namespace torrentsync
 {
 namespace dht
@@ -11,6 +15,8 @@ namespace dht
 const time_t Node::good_interval              = 15 * 60;  // 15 minutes
 const size_t Node::allowed_unanswered_queries = 10;
 
+static_assert(sizeof(Node) <= 40, "Node grew, the tables are sized on it");
+
 Node::Node()
 {
     setGood();
@@ -25,8 +31,10 @@ Node::Node( const Node& addr ) : Node()
 Node::Node(
     const torrentsync::utils::Buffer& data,
     const boost::optional<udp::endpoint>& endpoint ) :
-      NodeData(data), _endpoint(endpoint)
+      NodeData(data)
 {
+    if (!!endpoint)
+        setEndpoint(*endpoint);
     setGood();
 }
 
@@ -37,12 +45,65 @@ Node::Node(
     read(begin,end);
 }
 
+Node::Node(
+    const NodeData& data,
+    const boost::optional<udp::endpoint>& endpoint ) :
+      NodeData(data)
+{
+    if (!!endpoint)
+        setEndpoint(*endpoint);
+    setGood();
+}
+
+Node& Node::operator=( const Node& node )
+{
+    NodeData::operator=(node);
+    _last_time_good          = node._last_time_good;
+    _address                 = node._address;
+    _last_unanswered_queries = node._last_unanswered_queries;
+    _port                    = node._port;
+    _rtt                     = node._rtt;
+    _has_endpoint            = node._has_endpoint;
+    return *this;
+}
+
+void* Node::operator new( const size_t size )
+{
+    // a subclass larger than a node goes to the system allocator
+    if (size != sizeof(Node))
+        return ::operator new(size);
+    return utils::PoolAllocator<Node>::pool().allocate();
+}
+
+void Node::operator delete( void* node, const size_t size ) noexcept
+{
+    if (size != sizeof(Node))
+        ::operator delete(node);
+    else
+        utils::PoolAllocator<Node>::pool().deallocate(node);
+}
+
 void Node::setGood() noexcept
 {
-    _last_time_good = time(0);
+    _last_time_good = static_cast<uint32_t>(time(0));
     _last_unanswered_queries = 0;
 }
 
+void Node::addUnansweredQuery() noexcept
+{
+    if (_last_unanswered_queries < UINT16_MAX)
+        ++_last_unanswered_queries;
+}
+
+void Node::restore(
+    const time_t lastTimeGood,
+    const size_t unansweredQueries ) noexcept
+{
+    _last_time_good = static_cast<uint32_t>(lastTimeGood);
+    _last_unanswered_queries = static_cast<uint16_t>(
+        std::min<size_t>(unansweredQueries,UINT16_MAX));
+}
+
 bool Node::isGood() const noexcept
 {
     return _last_time_good > time(0)-good_interval;
@@ -58,19 +119,26 @@ bool Node::isBad() const noexcept
     return !isGood() && _last_unanswered_queries >  allowed_unanswered_queries;
 }
 
-const time_t& Node::getLastTimeGood() const noexcept
+time_t Node::getLastTimeGood() const noexcept
 {
     return _last_time_good;
 }
 
-const boost::optional<udp::endpoint>& Node::getEndpoint() const noexcept
+boost::optional<udp::endpoint> Node::getEndpoint() const
 {
-    return _endpoint;
+    if (!_has_endpoint)
+        return boost::optional<udp::endpoint>();
+    return udp::endpoint(boost::asio::ip::address_v4(_address),_port);
 }
 
-void Node::setEndpoint( udp::endpoint& endpoint )
+void Node::setEndpoint( const udp::endpoint& endpoint )
 {
-    _endpoint = endpoint;
+    if (!endpoint.address().is_v4())
+        throw std::invalid_argument("Only IPv4 node endpoints are supported");
+
+    _address = endpoint.address().to_v4().to_ulong();
+    _port = endpoint.port();
+    _has_endpoint = true;
 }
 
 void Node::read(
@@ -80,50 +148,42 @@ void Node::read(
     NodeData::read(begin,end);
     begin += NodeData::addressDataLength;
 
-    if ( end > begin && static_cast<size_t>(end-begin) < PEERDATALENGTH)
+    if ( end < begin || static_cast<size_t>(end-begin) < PEERDATALENGTH)
     {
         LOG(ERROR,"Peer - parsePeer: not enough data to parse. Expected " << PEERDATALENGTH << ", found: " << (end-begin) );
         throw std::invalid_argument("Not enough data to parse Peer contact information");
     }
 
-    uint32_t address;
-    uint16_t port;
-    
-    for( size_t _i = 0; _i < sizeof(uint32_t); ++_i )
-    {
-        address <<= 8;
-        address += *begin++;
-    }
-    
-    const boost::asio::ip::address_v4 new_address(
-        ntohl(address));
-    
-    port = *begin++;
-    port <<= 8;
-    port += *begin++;
+    setEndpoint(readEndpoint(&*begin));
+}
 
-    _endpoint = udp::endpoint(new_address,ntohs(port));
+udp::endpoint Node::readEndpoint( const uint8_t* data )
+{
+    return udp::endpoint(
+        boost::asio::ip::address_v4(utils::loadBE32(data)),
+        utils::loadBE16(data+sizeof(uint32_t)));
 }
 
 utils::Buffer Node::getPackedNode() const
 {
-    assert(!!_endpoint);
-    
-    utils::Buffer buff = NodeData::write();
-    buff.reserve(PACKED_NODE_SIZE);
-
-    auto networkOrderAddress        = htonl(_endpoint->address().to_v4().to_ulong());
-    const uint16_t portNetworkOrder = htons(_endpoint->port());
+    utils::Buffer buff(PACKED_NODE_SIZE);
+    writePackedNode(buff.data());
+    return buff;
+}
 
-    buff.push_back(networkOrderAddress >> 24);
-    buff.push_back(networkOrderAddress >> 16);
-    buff.push_back(networkOrderAddress >> 8);
-    buff.push_back(networkOrderAddress);
+void Node::writePackedNode( uint8_t* out ) const
+{
+    assert(_has_endpoint);
 
-    buff.push_back(portNetworkOrder >> 8);
-    buff.push_back(portNetworkOrder);
+    NodeData::writeTo(out);
+    utils::storeBE32(out+NodeData::addressDataLength,_address);
+    utils::storeBE16(out+NodeData::addressDataLength+sizeof(uint32_t),_port);
+}
 
-    return buff;
+void Node::writeEndpoint( const udp::endpoint& endpoint, uint8_t* out )
+{
+    utils::storeBE32(out,endpoint.address().to_v4().to_ulong());
+    utils::storeBE16(out+sizeof(uint32_t),endpoint.port());
 }
 
 }; // dht
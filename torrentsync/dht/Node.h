@@ -1,9 +1,16 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <boost/intrusive_ptr.hpp>
 
 #include <torrentsync/dht/NodeData.h>
 #include <torrentsync/dht/Distance.h>
+#include <torrentsync/utils/SlabPool.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
 
 namespace torrentsync
 {
@@ -15,7 +22,12 @@ namespace dht
 
 using boost::asio::ip::udp;
 
-//! A DHT address with the associated statistics and informations
+/** A DHT address with the associated statistics and informations
+ * The node is kept small for large tables: the IPv4 endpoint is stored
+ * inline and the statistics in the smallest integers that fit, 40 bytes
+ * in all with its reference count. The nodes are allocated from a pool
+ * and shared through NodeSPtr, a single pointer.
+ */
 class Node : public NodeData
 {
 public:
@@ -29,24 +41,46 @@ public:
     Node(
         utils::Buffer::const_iterator begin,
         utils::Buffer::const_iterator end);
+
+    Node(
+        const NodeData&,
+        const boost::optional<udp::endpoint>& = boost::optional<udp::endpoint>() );
     
-    Node( Node&& ) = default;
-    
-    Node& operator=(Node&&) = default;
-    
-    Node& operator=(const Node&) = default;
-    virtual ~Node() = default;
+    //! copies the address and the statistics, not the references
+    Node& operator=(const Node&);
+
+    ~Node() = default;
+
+    //! the nodes come from the pool of their size
+    static void* operator new( const size_t size );
+    static void operator delete( void* node, const size_t size ) noexcept;
     
     //! marks the address as good/fresh
     void setGood() noexcept;
 
+    //! counts a query the node didn't answer
+    void addUnansweredQuery() noexcept;
+
+    //! restores the statistics of the node from a previous run
+    void restore(
+        const time_t lastTimeGood,
+        const size_t unansweredQueries ) noexcept;
+
     //! Is the address good/fresh?
     //! @return true if good/fresh
     bool isGood() const noexcept;
 
     bool isQuestionable()           const noexcept;
     bool isBad()                    const noexcept;
-    const time_t& getLastTimeGood() const noexcept;
+    time_t getLastTimeGood() const noexcept;
+
+    //! @return the number of queries unanswered since the node was good
+    size_t getUnansweredQueries() const noexcept { return _last_unanswered_queries; }
+
+    //! @return the last round trip time measured in milliseconds, 0 if unknown
+    uint16_t getRTT() const noexcept { return _rtt; }
+
+    void setRTT( const uint16_t rtt ) noexcept { _rtt = rtt; }
 
     static const time_t good_interval; 
 
@@ -54,9 +88,23 @@ public:
     static const size_t allowed_unanswered_queries;
 
     //! returns the Peer's endpoint
-    const boost::optional<udp::endpoint>& getEndpoint() const noexcept;
+    boost::optional<udp::endpoint> getEndpoint() const;
+
+    //! @throws std::invalid_argument if the endpoint is not IPv4
+    void setEndpoint( const udp::endpoint& );
 
-    void setEndpoint( udp::endpoint& );
+    //! @return the endpoint as a single integer, 0 if not known
+    uint64_t getCompactEndpoint() const noexcept
+    {
+        return _has_endpoint ? compactEndpoint(_address,_port) : 0;
+    }
+
+    //! @return the endpoint as a single integer, 0 if it's not IPv4
+    static uint64_t compactEndpoint( const udp::endpoint& endpoint ) noexcept
+    {
+        return endpoint.address().is_v4() ?
+            compactEndpoint(endpoint.address().to_v4().to_ulong(),endpoint.port()) : 0;
+    }
 
     //! Parses a node information from the Buffer.
     //! In this class it implements the parsing of the actual ip address.
@@ -72,22 +120,78 @@ public:
      * and the port number.
      * @return the packed representation.
      */
-    virtual utils::Buffer getPackedNode() const;
+    utils::Buffer getPackedNode() const;
+
+    //! writes the packed representation of the node
+    //! @param out memory region of at least PACKED_NODE_SIZE bytes
+    void writePackedNode( uint8_t* out ) const;
+
+    //! reads the packed representation of an IPv4 endpoint
+    //! @param data PEERDATALENGTH bytes, address and port
+    static udp::endpoint readEndpoint( const uint8_t* data );
+
+    //! writes the packed representation of an IPv4 endpoint
+    //! @param out memory region of at least PEERDATALENGTH bytes
+    static void writeEndpoint( const udp::endpoint& endpoint, uint8_t* out );
     
 protected:
     Node();
 
-    //! the last time the node was set as good
-    time_t _last_time_good;
+    //! the address and port, with a bit set above them to never be 0
+    static uint64_t compactEndpoint(
+        const uint32_t address,
+        const uint16_t port ) noexcept
+    {
+        return (static_cast<uint64_t>(1) << 48) |
+            (static_cast<uint64_t>(address) << 16) | port;
+    }
+
+    //! the last time the node was set as good, seconds since the epoch
+    uint32_t _last_time_good;
+
+    //! IPv4 address of the node, host order
+    uint32_t _address = 0;
+
+    //! Number of the last unanswered queries, saturated
+    uint16_t _last_unanswered_queries;
+
+    //! port of the node
+    uint16_t _port = 0;
+
+    //! round trip time in milliseconds
+    uint16_t _rtt = 0;
+
+    //! false until the endpoint is known
+    bool _has_endpoint = false;
 
-    //! Number of the last unanswered queries
-    size_t _last_unanswered_queries;
+private:
 
-    //! the endpoint of the node
-    boost::optional<udp::endpoint> _endpoint;
+    //! the NodeSPtr sharing the node
+    mutable std::atomic<uint32_t> _references{0};
+
+    friend void intrusive_ptr_add_ref( const Node* node ) noexcept;
+    friend void intrusive_ptr_release( const Node* node ) noexcept;
 };
 
-typedef std::shared_ptr<Node> NodeSPtr;
+inline void intrusive_ptr_add_ref( const Node* node ) noexcept
+{
+    node->_references.fetch_add(1,std::memory_order_relaxed);
+}
+
+inline void intrusive_ptr_release( const Node* node ) noexcept
+{
+    if (node->_references.fetch_sub(1,std::memory_order_acq_rel) == 1)
+        delete node;
+}
+
+typedef boost::intrusive_ptr<Node> NodeSPtr;
+
+//! @return a node allocated from the node pool
+template <class... Args>
+NodeSPtr makeNode( Args&&... args )
+{
+    return NodeSPtr(new Node(std::forward<Args>(args)...));
+}
 
 }; // dht
 }; // torrentsync
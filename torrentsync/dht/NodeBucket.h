@@ -9,17 +9,84 @@
 #include <boost/optional.hpp>
 
 #include <algorithm>
+#include <cstdint>
 
 namespace torrentsync
 {
 namespace dht
 {
 
+/** Searches an address in the inline arrays of a bucket.
+ * The generic version compares the prefixes one by one, see the
+ * specializations for the common bucket sizes.
+ */
+template <size_t MaxSizeT>
+struct BucketScan
+{
+    //! @return the index of addr, or count if not found
+    static inline size_t find(
+        const uint64_t* prefixes,
+        const NodeData* ids,
+        const size_t    count,
+        const NodeData& addr ) noexcept
+    {
+        const uint64_t prefix = addr.getPrefix();
+        for( size_t i = 0; i < count; ++i )
+        {
+            if (prefixes[i] == prefix && ids[i] == addr)
+                return i;
+        }
+        return count;
+    }
+};
+
+/** Compares all the MaxSizeT prefixes without branches into a bit mask,
+ * the fixed trip count lets the compiler unroll and vectorize the loop.
+ * Only the matching prefixes are checked against the full address.
+ */
+template <size_t MaxSizeT>
+struct UnrolledBucketScan
+{
+    static_assert(MaxSizeT < 64, "the matches must fit a 64 bit mask");
+
+    static inline size_t find(
+        const uint64_t* prefixes,
+        const NodeData* ids,
+        const size_t    count,
+        const NodeData& addr ) noexcept
+    {
+        const uint64_t prefix = addr.getPrefix();
+        uint64_t matches = 0;
+        for( size_t i = 0; i < MaxSizeT; ++i )
+        {
+            matches |= static_cast<uint64_t>(prefixes[i] == prefix) << i;
+        }
+        matches &= (static_cast<uint64_t>(1) << count) - 1;
+
+        while (matches)
+        {
+            const size_t i = __builtin_ctzll(matches);
+            if (ids[i] == addr)
+                return i;
+            matches &= matches - 1;
+        }
+        return count;
+    }
+};
+
+template <> struct BucketScan<8>  : public UnrolledBucketScan<8>  {};
+template <> struct BucketScan<16> : public UnrolledBucketScan<16> {};
+template <> struct BucketScan<32> : public UnrolledBucketScan<32> {};
+
 /** Bucket containing nodes
  * A bucket container for node data, used as a node in NodeTree.
+ * The addresses are kept sorted and inline, next to the node pointers, so
+ * searching and sorting don't touch the nodes: the first 64 bits of every
+ * address are in a contiguous array (a cache line for 8 nodes) and the
+ * full addresses in another one.
  */
 template <size_t MaxSizeT>
-class NodeBucket : public boost::noncopyable
+class NodeBucket
 {
 public:
     //! constructor
@@ -29,9 +96,14 @@ public:
         const NodeData& low,
         const NodeData& high );
 
+    //! copies bounds and nodes, the nodes are shared
+    NodeBucket( const NodeBucket& ) = default;
+
+    NodeBucket& operator=( const NodeBucket& ) = delete;
+
     ~NodeBucket();
 
-    typedef boost::array<std::shared_ptr<Node>, MaxSizeT > NodeList;
+    typedef boost::array<NodeSPtr, MaxSizeT > NodeList;
     typedef typename NodeList::const_iterator const_iterator;
     typedef typename NodeList::iterator iterator;
 
@@ -42,7 +114,7 @@ public:
      * @throws std::invalid_argument in case addr is not in the bucket bounds
      */
     bool add(
-        const std::shared_ptr<Node> addr);
+        const NodeSPtr addr);
 
     /** remove a node from the bucket
      * In case the bucket it's already full it will try to remove older bad nodes.
@@ -61,13 +133,39 @@ public:
 
     void removeBad();
 
+    /** keeps a node which didn't fit the full bucket as a replacement
+     * candidate, the freshest one. A candidate seen again is refreshed, when
+     * the cache is full the oldest candidate is dropped.
+     * @param addr the node, ignored if already in the bucket
+     * @throws std::invalid_argument in case addr is not in the bucket bounds
+     */
+    void addReplacement(
+        const NodeSPtr& addr);
+
+    /** removes a node which stopped answering and promotes in its place the
+     * freshest replacement candidate which isn't bad, in O(1) plus the
+     * sorted insertion.
+     * @param addr the node to remove
+     * @return the promoted node, nothing if addr was not found or there
+     *         are no candidates
+     */
+    const boost::optional<NodeSPtr> replace(
+        const NodeData& addr);
+
+    //! number of replacement candidates
+    inline size_t replacementsSize() const { return _replacementsCount; }
+
+    //! the i-th replacement candidate, from the oldest
+    inline const NodeSPtr& getReplacement( const size_t i ) const
+        { return _replacements[replacementAt(i)]; }
+
     inline size_t size()    const;
     inline size_t maxSize() const;
 
     void clear();
 
     bool inBounds(
-        const std::shared_ptr<Node>& addr ) const;
+        const NodeSPtr& addr ) const;
     bool inBounds(
         const NodeData& addr ) const;
 
@@ -80,6 +178,9 @@ public:
     inline const_iterator cbegin() const { return _elements.begin(); }
     inline const_iterator cend()   const { return _elements.begin()+addressCount; }
 
+    //! the address of the node at index, without accessing the node
+    inline const NodeData& getID( const size_t index ) const { return _ids[index]; }
+
     std::ostream& string( std::ostream& out ) const;
 
 private:
@@ -87,12 +188,33 @@ private:
     inline iterator begin()       { return _elements.begin(); }
     inline iterator end()         { return _elements.begin()+addressCount; }
 
+    //! @return the index of the address, addressCount if not found
+    inline size_t indexOf( const NodeData& addr ) const noexcept;
+
+    //! removes the element at index, keeping the order
+    void erase( const size_t index );
+
+    //! the ring position of the i-th replacement, from the oldest
+    inline size_t replacementAt( const size_t i ) const
+        { return (_replacementsFirst+i) % MaxSizeT; }
+
     NodeData low;
     NodeData high;
 
     size_t addressCount;
 
+    //! the first 64 bits of the addresses, for the scans
+    boost::array<uint64_t, MaxSizeT> _prefixes;
+
+    //! the addresses, sorted
+    boost::array<NodeData, MaxSizeT> _ids;
+
     mutable NodeList _elements;
+
+    //! replacement candidates, a ring from the oldest to the freshest
+    NodeList _replacements;
+    size_t   _replacementsFirst;
+    size_t   _replacementsCount;
 };
 
 template <size_t MaxSizeT>
@@ -100,8 +222,12 @@ NodeBucket<MaxSizeT>::NodeBucket(
             const NodeData& low,
             const NodeData& high ) :
     low(low), high(high),
-    addressCount(0)
+    addressCount(0),
+    _replacementsFirst(0),
+    _replacementsCount(0)
 {
+    // the unrolled scans read the unused slots too
+    _prefixes.fill(0);
 }
 
 template <size_t MaxSizeT>
@@ -126,12 +252,16 @@ template <size_t MaxSizeT>
 void NodeBucket<MaxSizeT>::clear()
 {
     std::for_each( begin(), end(), 
-            [](std::shared_ptr<Node>& t) { assert(t.get()); t.reset();});
+            [](NodeSPtr& t) { assert(t.get()); t.reset();});
     addressCount = 0;
+
+    std::fill( _replacements.begin(), _replacements.end(), NodeSPtr());
+    _replacementsFirst = 0;
+    _replacementsCount = 0;
 }
 
 template <size_t MaxSizeT>
-bool NodeBucket<MaxSizeT>::add( const std::shared_ptr<Node> addr )
+bool NodeBucket<MaxSizeT>::add( const NodeSPtr addr )
 {
     assert(addr.get());
 
@@ -149,10 +279,18 @@ bool NodeBucket<MaxSizeT>::add( const std::shared_ptr<Node> addr )
     if (size() < maxSize())
     {
         // find first greater than the current address
-        iterator it = std::find_if( begin(), end(),
-            bind1st(std::less<std::shared_ptr<Node> >(),addr) );
-        std::copy_backward(it,end(),end()+1);
-        *it = addr;
+        const size_t index = std::upper_bound(
+            _ids.begin(), _ids.begin()+addressCount, *addr) - _ids.begin();
+
+        std::copy_backward(_prefixes.begin()+index,_prefixes.begin()+addressCount,
+            _prefixes.begin()+addressCount+1);
+        std::copy_backward(_ids.begin()+index,_ids.begin()+addressCount,
+            _ids.begin()+addressCount+1);
+        std::move_backward(begin()+index,end(),end()+1);
+
+        _prefixes[index] = addr->getPrefix();
+        _ids[index]      = *addr;
+        _elements[index] = addr;
         ++addressCount;
         return true;
     }
@@ -163,17 +301,28 @@ bool NodeBucket<MaxSizeT>::add( const std::shared_ptr<Node> addr )
 template <size_t MaxSizeT>
 void NodeBucket<MaxSizeT>::removeBad()
 {
-    const iterator it = std::remove_if( begin(), end(),
-            [](const std::shared_ptr<Node>& addr) -> bool {
-                assert(addr.get());
-                return addr->isBad(); }
-            );
-    addressCount = it-begin();
+    size_t kept = 0;
+    for( size_t i = 0; i < addressCount; ++i )
+    {
+        assert(_elements[i].get());
+        if (_elements[i]->isBad())
+            continue;
+
+        if (kept != i)
+        {
+            _prefixes[kept] = _prefixes[i];
+            _ids[kept]      = _ids[i];
+            _elements[kept] = std::move(_elements[i]);
+        }
+        ++kept;
+    }
+    std::fill(begin()+kept, end(), NodeSPtr());
+    addressCount = kept;
 }
 
 template <size_t MaxSizeT>
 bool NodeBucket<MaxSizeT>::inBounds(
-        const std::shared_ptr<Node>& addr ) const
+        const NodeSPtr& addr ) const
 {
     assert(addr.get());
     return inBounds(*addr);
@@ -190,28 +339,103 @@ template <size_t MaxSizeT>
 bool NodeBucket<MaxSizeT>::remove(
     const Node& addr)
 {
-    for ( size_t it = 0; it < addressCount; ++it)
+    const size_t index = indexOf(addr);
+    if (index == addressCount)
+        return false;
+
+    erase(index);
+    return true;
+}
+
+template <size_t MaxSizeT>
+void NodeBucket<MaxSizeT>::erase( const size_t index )
+{
+    assert(index < addressCount);
+
+    std::copy(_prefixes.begin()+index+1,_prefixes.begin()+addressCount,
+        _prefixes.begin()+index);
+    std::copy(_ids.begin()+index+1,_ids.begin()+addressCount,
+        _ids.begin()+index);
+    std::move(begin()+index+1,end(),begin()+index);
+
+    --addressCount;
+    _elements[addressCount] = NodeSPtr();
+}
+
+template <size_t MaxSizeT>
+void NodeBucket<MaxSizeT>::addReplacement(
+    const NodeSPtr& addr)
+{
+    assert(addr.get());
+
+    if (!inBounds(*addr))
     {
-        const std::shared_ptr<Node>& v = _elements[it];
-        assert(v.get());
+        throw std::invalid_argument("The address can't stay in this Bucket: "
+            + addr->string() + " "+low.string()+"-"+high.string());
+    }
+
+    if (indexOf(*addr) != addressCount)
+        return;
 
-        if (addr == *v)
+    // a known candidate is moved to the freshest position
+    for( size_t i = 0; i < _replacementsCount; ++i )
+    {
+        if (*_replacements[replacementAt(i)] == *addr)
         {
-            if (it+1 == addressCount) 
-            {
-                _elements[it] = std::shared_ptr<Node>();
-                --addressCount;
-            }
-            else
+            for( size_t j = i; j+1 < _replacementsCount; ++j )
             {
-                std::copy( begin()+it+1, end(), begin()+it);
-                --addressCount;
-                _elements[addressCount] = std::shared_ptr<Node>();
+                _replacements[replacementAt(j)] =
+                    std::move(_replacements[replacementAt(j+1)]);
             }
-            return true;
+            --_replacementsCount;
+            break;
         }
     }
-    return false;
+
+    if (_replacementsCount == MaxSizeT)
+    {
+        _replacements[_replacementsFirst].reset();
+        _replacementsFirst = replacementAt(1);
+        --_replacementsCount;
+    }
+
+    _replacements[replacementAt(_replacementsCount)] = addr;
+    ++_replacementsCount;
+}
+
+template <size_t MaxSizeT>
+const boost::optional<NodeSPtr> NodeBucket<MaxSizeT>::replace(
+    const NodeData& addr)
+{
+    boost::optional<NodeSPtr> ret;
+
+    const size_t index = indexOf(addr);
+    if (index == addressCount)
+        return ret;
+    erase(index);
+
+    // the freshest candidate is the last of the ring
+    while (_replacementsCount > 0)
+    {
+        --_replacementsCount;
+        NodeSPtr candidate = std::move(_replacements[replacementAt(_replacementsCount)]);
+        assert(candidate.get());
+        if (!candidate->isBad() && indexOf(*candidate) == addressCount)
+        {
+            add(candidate);
+            ret = candidate;
+            break;
+        }
+    }
+    return ret;
+}
+
+template <size_t MaxSizeT>
+size_t NodeBucket<MaxSizeT>::indexOf(
+    const NodeData& addr) const noexcept
+{
+    return BucketScan<MaxSizeT>::find(
+        _prefixes.data(),_ids.data(),addressCount,addr);
 }
 
 template <size_t MaxSizeT>
@@ -236,16 +460,12 @@ template <size_t MaxSizeT>
 const boost::optional<NodeSPtr> NodeBucket<MaxSizeT>::find(
     const NodeData& addr) const
 {
-    const_iterator it = std::find_if( begin(), end(), 
-            [addr](const std::shared_ptr<Node>& bucket_addr) -> bool {
-                assert(bucket_addr.get());
-                return static_cast<NodeData&>(*bucket_addr) == addr; }
-            );
-
     boost::optional<NodeSPtr> ret;
-    if ( it != end() )
+
+    const size_t index = indexOf(addr);
+    if ( index != addressCount )
     {
-        ret = *it;
+        ret = _elements[index];
     }
     return ret;
 }
@@ -4,17 +4,13 @@
 #include <cctype>
 #include <stdexcept>
 
-#include <boost/random/uniform_int_distribution.hpp>
-#include <boost/random/mersenne_twister.hpp>
-
 #include <torrentsync/dht/NodeData.h>
 #include <torrentsync/dht/Distance.h>
 #include <torrentsync/utils/RandomGenerator.h>
 #include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/Endian.h>
 #include <torrentsync/utils/log/Logger.h>
 
-#include <netinet/in.h>
-
 namespace torrentsync
 {
 namespace dht
@@ -22,8 +18,14 @@ namespace dht
 
 const size_t NodeData::ADDRESS_STRING_LENGTH = 40;
 const size_t NodeData::addressDataLength     = 20;
+const size_t NodeData::ADDRESS_BITS;
+
+NodeData::NodeData(const utils::Buffer& buff) :
+    NodeData(utils::BufferView(buff))
+{
+}
 
-NodeData::NodeData(const utils::Buffer& buff)
+NodeData::NodeData(const utils::BufferView& buff)
 {
     if ( buff.size() != addressDataLength) 
     {
@@ -32,15 +34,7 @@ NodeData::NodeData(const utils::Buffer& buff)
         throw std::invalid_argument(msg.str());
     }
 
-    const uint32_t * const data = reinterpret_cast<const uint32_t*>(&buff[0]);
-
-    p1 = htonl(data[0]);
-    p1 <<= 32;
-    p1 |= htonl(data[1]);
-    p2 =  htonl(data[2]);
-    p2 <<= 32;
-    p2 |= htonl(data[3]);
-    p3 =  htonl(data[4]);
+    readFrom(buff.data());
 }
 
 NodeData::~NodeData()
@@ -122,24 +116,91 @@ MaybeBounds NodeData::splitInHalf(
     return MaybeBounds(Bounds(half_low,half_high));
 }
 
-const NodeData NodeData::getRandom()
+//! keeps the first prefix bits of a part of the address, randomizes the
+//! others and, if flip is set, flips the bit following the prefix
+template <class T>
+static T mixPrefix(
+    const T value,
+    const T random,
+    const size_t offset,
+    const size_t prefix,
+    const bool flip = true ) noexcept
 {
-    NodeData data;
-    using namespace torrentsync::utils;
+    const size_t width = sizeof(T)*8;
+    if (prefix < offset)
+        return random;
+    if (prefix >= offset+width)
+        return value;
+
+    const size_t keep = prefix-offset;
+    const T mask = keep == 0 ? 0 : ~static_cast<T>(0) << (width-keep);
+    const T bit = flip ? static_cast<T>(1) << (width-keep-1) : 0;
+    return (value & mask) | (~value & bit) | (random & ~mask & ~bit);
+}
 
-    data.p1 = RandomGenerator::getInstance().get();
-    data.p1 <<= 32;
-    data.p1 |= RandomGenerator::getInstance().get();
+const NodeData NodeData::getRandom()
+{
+    utils::RandomGenerator& generator = utils::RandomGenerator::getInstance();
 
-    data.p2 = RandomGenerator::getInstance().get();
-    data.p2 <<= 32;
-    data.p2 |= RandomGenerator::getInstance().get();
+    NodeData data;
+    data.p1 = generator.get64();
+    data.p2 = generator.get64();
+    data.p3 = generator.get();
+    return data;
+}
 
-    data.p3 = RandomGenerator::getInstance().get();
+const NodeData NodeData::getRandomInRange(
+    const NodeData& low,
+    const NodeData& high )
+{
+    if (low > high)
+        throw std::invalid_argument("Random address range with low > high");
+
+    // span = high - low, 160 bits with borrow
+    NodeData span;
+    span.p3 = high.p3 - low.p3;
+    uint64_t borrow = high.p3 < low.p3;
+    span.p2 = high.p2 - low.p2 - borrow;
+    borrow = high.p2 < low.p2 || (high.p2 == low.p2 && borrow);
+    span.p1 = high.p1 - low.p1 - borrow;
+
+    // rejection sampling on the bits of span, accepted at least half the time
+    const size_t zeros = span.commonPrefixLength(minValue);
+    NodeData offset;
+    do
+    {
+        offset = getRandom();
+        offset.p1 = mixPrefix<uint64_t>(0,offset.p1,0,zeros,false);
+        offset.p2 = mixPrefix<uint64_t>(0,offset.p2,64,zeros,false);
+        offset.p3 = mixPrefix<uint32_t>(0,offset.p3,128,zeros,false);
+    } while (offset > span);
 
+    // low + offset, 160 bits with carry
+    NodeData data;
+    data.p3 = low.p3 + offset.p3;
+    uint64_t carry = data.p3 < low.p3;
+    data.p2 = low.p2 + offset.p2 + carry;
+    carry = data.p2 < low.p2 || (data.p2 == low.p2 && carry);
+    data.p1 = low.p1 + offset.p1 + carry;
     return data;
 }
 
+const NodeData NodeData::getRandomAtPrefix( const size_t prefixLength ) const
+{
+    if (prefixLength >= ADDRESS_BITS)
+        return *this;
+
+    // the range of the addresses with the prefix and the next bit flipped
+    NodeData low, high;
+    low.p1  = mixPrefix<uint64_t>(p1,0,0,prefixLength);
+    low.p2  = mixPrefix<uint64_t>(p2,0,64,prefixLength);
+    low.p3  = mixPrefix<uint32_t>(p3,0,128,prefixLength);
+    high.p1 = mixPrefix<uint64_t>(p1,~0,0,prefixLength);
+    high.p2 = mixPrefix<uint64_t>(p2,~0,64,prefixLength);
+    high.p3 = mixPrefix<uint32_t>(p3,~0,128,prefixLength);
+    return getRandomInRange(low,high);
+}
+
 void NodeData::read(
     utils::Buffer::const_iterator begin,
     const utils::Buffer::const_iterator end  )
@@ -150,58 +211,30 @@ void NodeData::read(
         throw std::invalid_argument("Wrong amount of data to parse");
     }
 
-    p1 = 0;
-    p2 = 0;
-    p3 = 0;
-
-    for ( int i = 0; i <= 7; ++i )
-    {
-        p1 <<= 8;
-        p1 |= *(begin++);
-    }
-
-    for ( int i = 8; i <= 15; ++i )
-    {
-        p2 <<= 8;
-        p2 |= *(begin++);
-    }
+    readFrom(&*begin);
+}
 
-    for ( int i = 16; i <= 19; ++i )
-    {
-        p3 <<= 8;
-        p3 |= *(begin++);
-    }
+void NodeData::readFrom( const uint8_t* data ) noexcept
+{
+    p1 = utils::loadBE64(data);
+    p2 = utils::loadBE64(data+8);
+    p3 = utils::loadBE32(data+16);
 }
 
 torrentsync::utils::Buffer NodeData::write() const
 {
-    torrentsync::utils::Buffer buff;
-    buff.reserve(20);
-    
-    buff.push_back(p1 >> 56 & 0xFF);
-    buff.push_back(p1 >> 48 & 0xFF);
-    buff.push_back(p1 >> 40 & 0xFF);
-    buff.push_back(p1 >> 32 & 0xFF);
-    buff.push_back(p1 >> 24 & 0xFF);
-    buff.push_back(p1 >> 16 & 0xFF);
-    buff.push_back(p1 >>  8 & 0xFF);
-    buff.push_back(p1 >>  0 & 0xFF);
-    buff.push_back(p2 >> 56 & 0xFF);
-    buff.push_back(p2 >> 48 & 0xFF);
-    buff.push_back(p2 >> 40 & 0xFF);
-    buff.push_back(p2 >> 32 & 0xFF);
-    buff.push_back(p2 >> 24 & 0xFF);
-    buff.push_back(p2 >> 16 & 0xFF);
-    buff.push_back(p2 >>  8 & 0xFF);
-    buff.push_back(p2 >>  0 & 0xFF);
-    buff.push_back(p3 >> 24 & 0xFF);
-    buff.push_back(p3 >> 16 & 0xFF);
-    buff.push_back(p3 >>  8 & 0xFF);
-    buff.push_back(p3 >>  0 & 0xFF);
-
+    torrentsync::utils::Buffer buff(addressDataLength);
+    writeTo(buff.data());
     return buff;
 }
 
+void NodeData::writeTo( uint8_t* out ) const noexcept
+{
+    utils::storeBE64(out,p1);
+    utils::storeBE64(out+8,p2);
+    utils::storeBE32(out+16,p3);
+}
+
 std::ostream& operator<<( std::ostream& out, const NodeData& data )
 {
     out << data.string();
@@ -5,6 +5,7 @@
 #include <memory>
 
 #include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/BufferView.h>
 
 #include <boost/optional.hpp>
 
@@ -32,6 +33,9 @@ public:
     //! constructor expects to receive a buffer with the binary data to parse
     NodeData(const torrentsync::utils::Buffer&);
 
+    //! constructor expects to receive a view of the binary data to parse
+    NodeData(const torrentsync::utils::BufferView&);
+
     //! Destructor
     ~NodeData();
 
@@ -48,12 +52,22 @@ public:
     static const NodeData maxValue;
 
     static const size_t ADDRESS_STRING_LENGTH;
-    static const size_t ADDRESS_BITS;
+    static const size_t ADDRESS_BITS = 160;
 
     static MaybeBounds splitInHalf(const NodeData& low, const NodeData& high);
 
     static const NodeData getRandom();
 
+    //! @return a random address, uniformly distributed in [low,high]
+    //! @throws std::invalid_argument if low is bigger than high
+    static const NodeData getRandomInRange(
+        const NodeData& low,
+        const NodeData& high );
+
+    //! @return a random address sharing exactly prefixLength leading bits
+    //!         with this one, this address if prefixLength is ADDRESS_BITS
+    const NodeData getRandomAtPrefix( const size_t prefixLength ) const;
+
     //! Parses an NodeData information from the Buffer.
     //! In this class it implements the parsing of the NodeData data.
     //! @param begin the beginning of the data in the iterator
@@ -67,12 +81,27 @@ public:
     //! write node on a buffer
     torrentsync::utils::Buffer write() const;
 
+    //! write node on a memory region of at least addressDataLength bytes
+    void writeTo( uint8_t* out ) const noexcept;
+
+    //! reads the node from a memory region of at least addressDataLength
+    //! bytes, no alignment required
+    void readFrom( const uint8_t* data ) noexcept;
+
     //! amount of binary data to parse the NodeData class from binary data.
     static const size_t addressDataLength;
 
     // distance operator
     Distance operator^( const NodeData& addr ) const noexcept;
 
+    //! number of leading bits in common with addr, the leading zeros of
+    //! the XOR distance
+    //! @return 0 to ADDRESS_BITS, ADDRESS_BITS if the addresses are equal
+    inline size_t commonPrefixLength( const NodeData& addr ) const noexcept;
+
+    //! the first 64 bits of the address, as an integer
+    inline uint64_t getPrefix() const noexcept { return p1; }
+
 private:
 
     // not using std::bitset for lack of comparing operators
@@ -126,6 +155,20 @@ inline bool NodeData::operator>=( const NodeData& addr ) const
             (p1 == addr.p1 && p2 == addr.p2 && p3 == addr.p3);
 }
 
+inline size_t NodeData::commonPrefixLength( const NodeData& addr ) const noexcept
+{
+    const uint64_t d1 = p1 ^ addr.p1;
+    if (d1)
+        return __builtin_clzll(d1);
+    const uint64_t d2 = p2 ^ addr.p2;
+    if (d2)
+        return 64 + __builtin_clzll(d2);
+    const uint32_t d3 = p3 ^ addr.p3;
+    if (d3)
+        return 128 + __builtin_clz(d3);
+    return ADDRESS_BITS;
+}
+
 std::ostream& operator<<( std::ostream& out, const NodeData& data );
 
 }; // dht
@@ -1,4 +1,5 @@
 #include <torrentsync/dht/NodeTree.h>
+#include <torrentsync/dht/Distance.h>
 
 #include <exception>
 #include <numeric>
@@ -9,14 +10,9 @@ namespace torrentsync
 namespace dht
 {
 
-bool sortByBounds(const BucketSPtr& x, const BucketSPtr& y) noexcept
-{
-    return x->getUpperBound() < y->getLowerBound();
-}
-
 NodeTree::NodeTree(
     const NodeData nodeNode) :
-        _buckets(sortByBounds),
+        _snapshot(nullptr),
         _node(nodeNode)
 {
     clear();
@@ -24,6 +20,7 @@ NodeTree::NodeTree(
 
 NodeTree::~NodeTree()
 {
+    delete _snapshot.load();
 }
 
 bool NodeTree::addNode( NodeSPtr address )
@@ -33,38 +30,68 @@ bool NodeTree::addNode( NodeSPtr address )
 
     std::lock_guard<std::mutex> lock(mutex);
 
-    BucketContainer::const_iterator bucket_it = findBucket(*address);
-    assert(bucket_it != _buckets.end());
+    // the readers keep using the current snapshot, the changes go to a copy
+    const Snapshot& current = *_snapshot.load();
 
-    BucketContainer::key_type bucket = *bucket_it;
-    assert(bucket->inBounds(address));
+    const size_t index = findBucket(current,*address);
+    const Bucket& existing = *current.buckets[index];
+    assert(existing.inBounds(address));
+
+    // a full bucket without bad nodes to replace doesn't change, the node
+    // is kept as a replacement candidate. The replacement cache is only
+    // accessed by the writers, so it's updated in place.
+    if ( index != current.bucketsCount-1 && existing.size() == existing.maxSize() &&
+         std::none_of(existing.cbegin(),existing.cend(),
+             [](const NodeSPtr& node) { return node->isBad(); }) )
+    {
+        current.buckets[index]->addReplacement(address);
+        return false;
+    }
+
+    const BucketSPtr bucket(new Bucket(existing));
 
     bool isAdded = bucket->add(address);
-    if ( !isAdded && bucket->inBounds(_node) )
+    if ( !isAdded && index == current.bucketsCount-1 )
     {
-        MaybeBuckets maybe_split_buckets = split(bucket_it);
+        assert(bucket->inBounds(_node));
+        std::unique_ptr<Snapshot> next(new Snapshot(current));
+        next->buckets[index] = bucket;
+
+        MaybeBuckets maybe_split_buckets = split(*next);
 
-        // unsplittable, ignore it
+        // unsplittable, keep it as a candidate
         if (!maybe_split_buckets)
+        {
+            current.buckets[index]->addReplacement(address);
             return false;
+        }
 
         BucketSPtrPair& split_buckets = *maybe_split_buckets;
 
         assert(split_buckets.first->inBounds(address) ||
                split_buckets.second->inBounds(address));
 
-        if (split_buckets.first->inBounds(address))
-        {
-            isAdded = split_buckets.first->add(address);
-        }
-        else
-        {
-            assert(split_buckets.second->inBounds(address));
-            isAdded = split_buckets.second->add(address);
-        }
+        const BucketSPtr& half = split_buckets.first->inBounds(address) ?
+            split_buckets.first : split_buckets.second;
+        assert(half->inBounds(address));
+
+        isAdded = half->add(address);
+        if (!isAdded)
+            half->addReplacement(address);
+        reindex(existing,&next->buckets[index],2);
+        publish(std::move(next));
         return isAdded;
     }
 
+    // publish also the bad nodes removed to make room
+    if ( isAdded || bucket->size() != existing.size() )
+    {
+        std::unique_ptr<Snapshot> next(new Snapshot(current));
+        next->buckets[index] = bucket;
+        reindex(existing,&bucket,1);
+        publish(std::move(next));
+    }
+
     return isAdded;
 }
 
@@ -75,39 +102,83 @@ void NodeTree::removeNode( NodeSPtr address )
 
     std::lock_guard<std::mutex> lock(mutex);
 
-    BucketContainer::const_iterator bucket_it = findBucket(*address);
+    const Snapshot& current = *_snapshot.load();
 
-    BucketContainer::key_type bucket = *bucket_it;
-    assert(bucket->inBounds(address));
+    const size_t index = findBucket(current,*address);
+    assert(current.buckets[index]->inBounds(address));
+    if (!current.buckets[index]->find(*address))
+        return;
 
+    const BucketSPtr bucket(new Bucket(*current.buckets[index]));
     bucket->remove(*address);
+
+    std::unique_ptr<Snapshot> next(new Snapshot(current));
+    next->buckets[index] = bucket;
+    reindex(*current.buckets[index],&bucket,1);
+    publish(std::move(next));
 }
 
-size_t NodeTree::size() const noexcept
+const boost::optional<NodeSPtr> NodeTree::replaceNode( NodeSPtr address )
 {
+    if (!address.get())
+        throw std::invalid_argument("Node is not set");
+
     std::lock_guard<std::mutex> lock(mutex);
-    return std::accumulate(_buckets.begin(), _buckets.end(), static_cast<size_t>(0),
-        [](const size_t init,const BucketContainer::key_type& t) -> size_t
+
+    const Snapshot& current = *_snapshot.load();
+
+    const size_t index = findBucket(current,*address);
+    if (!current.buckets[index]->find(*address))
+        return boost::optional<NodeSPtr>();
+
+    const BucketSPtr bucket(new Bucket(*current.buckets[index]));
+    const boost::optional<NodeSPtr> promoted = bucket->replace(*address);
+
+    std::unique_ptr<Snapshot> next(new Snapshot(current));
+    next->buckets[index] = bucket;
+    reindex(*current.buckets[index],&bucket,1);
+    publish(std::move(next));
+
+    return promoted;
+}
+
+size_t NodeTree::size() const noexcept
+{
+    utils::GracePeriod::ReadGuard guard(_readers);
+    const Snapshot& snapshot = *_snapshot.load();
+
+    return std::accumulate(snapshot.buckets.begin(),
+        snapshot.buckets.begin()+snapshot.bucketsCount, static_cast<size_t>(0),
+        [](const size_t init,const BucketSPtr& t) -> size_t
             { return init+t->size(); });
 }
 
-BucketContainer::const_iterator
-NodeTree::findBucket( const NodeData& addr ) const
+std::vector<NodeSPtr> NodeTree::getNodes() const
 {
-    const BucketContainer::key_type key(new Bucket(addr,addr));
+    utils::GracePeriod::ReadGuard guard(_readers);
+    const Snapshot& snapshot = *_snapshot.load();
 
-    auto it = _buckets.lower_bound(key);
+    std::vector<NodeSPtr> nodes;
+    for( size_t i = 0; i < snapshot.bucketsCount; ++i )
+    {
+        nodes.insert(nodes.end(),
+            snapshot.buckets[i]->cbegin(),snapshot.buckets[i]->cend());
+    }
+    return nodes;
+}
 
-    assert( it != _buckets.end() );
-    assert( it->get() );
-    return it;
+size_t NodeTree::findBucket( const NodeData& address ) const noexcept
+{
+    utils::GracePeriod::ReadGuard guard(_readers);
+    return findBucket(*_snapshot.load(),address);
 }
 
-MaybeBuckets NodeTree::split( BucketContainer::const_iterator bucket_it )
+MaybeBuckets NodeTree::split( Snapshot& snapshot )
 {
-    assert(bucket_it != _buckets.end());
-    assert(bucket_it->get());
-    BucketSPtr bucket = *bucket_it;
+    assert(snapshot.bucketsCount > 0);
+    const BucketSPtr bucket = snapshot.buckets[snapshot.bucketsCount-1];
+    assert(bucket.get());
+    assert(bucket->inBounds(_node));
 
     MaybeBounds bounds = NodeData::splitInHalf(
             bucket->getLowerBound(), bucket->getUpperBound());
@@ -133,77 +204,174 @@ MaybeBuckets NodeTree::split( BucketContainer::const_iterator bucket_it )
     }
 
     assert(upper_bucket->size() + lower_bucket->size() == bucket->size());
+
+    // the candidates, if any, go with the nodes
+    for( size_t i = 0; i < bucket->replacementsSize(); ++i )
+    {
+        const NodeSPtr& candidate = bucket->getReplacement(i);
+        if (lower_bucket->inBounds(candidate))
+            lower_bucket->addReplacement(candidate);
+        else
+            upper_bucket->addReplacement(candidate);
+    }
  
-    _buckets.erase(bucket_it);
-    _buckets.insert(upper_bucket);
-    _buckets.insert(lower_bucket);
+    // the half with our own address becomes the last bucket
+    BucketContainer& buckets = snapshot.buckets;
+    size_t& count = snapshot.bucketsCount;
+    assert(count < buckets.size());
+    if (lower_bucket->inBounds(_node))
+    {
+        buckets[count-1] = upper_bucket;
+        buckets[count]   = lower_bucket;
+    }
+    else
+    {
+        buckets[count-1] = lower_bucket;
+        buckets[count]   = upper_bucket;
+    }
+    ++count;
 
     return MaybeBuckets(BucketSPtrPair(lower_bucket,upper_bucket));
 }
 
+void NodeTree::reindex(
+    const Bucket& before,
+    const BucketSPtr* after,
+    const size_t count )
+{
+    // at most a bucket of nodes, the linear searches are cheap
+    const auto contains = [](const Bucket& bucket, const NodeSPtr& node)
+    {
+        return std::find(bucket.cbegin(),bucket.cend(),node) != bucket.cend();
+    };
+
+    std::lock_guard<std::mutex> lock(_endpointsMutex);
+    for( const NodeSPtr& node : before )
+    {
+        if (std::none_of(after,after+count,
+                [&](const BucketSPtr& bucket) { return contains(*bucket,node); }))
+            _endpoints.erase(*node);
+    }
+    for( size_t i = 0; i < count; ++i )
+    {
+        const Bucket& bucket = *after[i];
+        for( auto it = bucket.cbegin(); it != bucket.cend(); ++it )
+        {
+            if (!contains(before,*it))
+                _endpoints.insert(*it);
+        }
+    }
+}
+
+void NodeTree::publish( std::unique_ptr<Snapshot> snapshot ) noexcept
+{
+    const Snapshot* old = _snapshot.exchange(snapshot.release());
+    _readers.synchronize();
+    delete old;
+}
+
 void NodeTree::clear() noexcept
 {
     std::lock_guard<std::mutex> lock(mutex);
-    _buckets.clear();
 
     // initialize first bucket
-    std::shared_ptr<Bucket> bucket(
+    std::unique_ptr<Snapshot> snapshot(new Snapshot());
+    snapshot->buckets[0].reset(
             new Bucket( NodeData::minValue, NodeData::maxValue));
-    _buckets.insert(bucket);
+    snapshot->bucketsCount = 1;
+    publish(std::move(snapshot));
+
+    std::lock_guard<std::mutex> endpointsLock(_endpointsMutex);
+    _endpoints.clear();
 }
 
 const boost::optional<NodeSPtr> NodeTree::getNode(
     const NodeData& data ) const noexcept
 {
-    return (*findBucket(data))->find(data); 
+    utils::GracePeriod::ReadGuard guard(_readers);
+    const Snapshot& snapshot = *_snapshot.load();
+    return snapshot.buckets[findBucket(snapshot,data)]->find(data);
 }
 
-// This method will not return the exact 8 closest, but fetches the nodes from
-// three buckets, the right one and the 2 adjacent ones.
-// In case we have a lot of nodes it will be precise, if not then we can't 
-// expect to have a precise result anyway.
-const std::list<NodeSPtr> NodeTree::getClosestNodes(
+const boost::optional<NodeSPtr> NodeTree::getNodeByEndpoint(
+    const udp::endpoint& endpoint ) const
+{
+    std::lock_guard<std::mutex> lock(_endpointsMutex);
+    return _endpoints.find(endpoint);
+}
+
+// The buckets are visited in XOR distance order from the target, every group
+// being farther than the previous one:
+// - the target bucket, sharing more leading bits with the target than with
+//   our own address;
+// - the buckets after it, sharing the same bits with the target as our own
+//   address does;
+// - the buckets before it, each one sharing one less bit.
+// So once DHT_FIND_NODE_COUNT nodes are found after a group no other node
+// can be closer and the search stops.
+ClosestNodes NodeTree::getClosestNodes(
     const NodeData& data) const
 {
-    std::list<NodeSPtr> nodes;
-    std::lock_guard<std::mutex> lock(mutex);
-    
-    std::set<NodeSPtr,std::function<bool(const NodeSPtr&,const NodeSPtr&)> > knownNodes(
-        [&data]( const NodeSPtr& x, const NodeSPtr& y) {
-            return (*x ^ data) <= (*y ^ data);
-        });
+    typedef std::pair<Distance,const NodeSPtr*> Candidate;
+    const auto farther = []( const Candidate& x, const Candidate& y ) {
+        return x.first < y.first; };
+
+    // max-heap on the distance of the closest nodes found so far
+    std::array<Candidate,DHT_FIND_NODE_COUNT> heap;
+    size_t heapSize = 0;
+
+    const auto scan = [&]( const Bucket& bucket )
+    {
+        // the distances come from the inline addresses, the nodes are
+        // only referenced
+        for( size_t i = 0; i < bucket.size(); ++i )
+        {
+            const Distance distance = bucket.getID(i) ^ data;
+            if (heapSize < heap.size())
+            {
+                heap[heapSize++] = Candidate(distance,&bucket.cbegin()[i]);
+                std::push_heap(heap.begin(),heap.begin()+heapSize,farther);
+            }
+            else if (distance < heap.front().first)
+            {
+                std::pop_heap(heap.begin(),heap.end(),farther);
+                heap.back() = Candidate(distance,&bucket.cbegin()[i]);
+                std::push_heap(heap.begin(),heap.end(),farther);
+            }
+        }
+    };
+
+    ClosestNodes nodes;
+    utils::GracePeriod::ReadGuard guard(_readers);
+    const Snapshot& snapshot = *_snapshot.load();
+
+    const size_t index = findBucket(snapshot,data);
 
-    // find bucket
-    auto bucket_it = findBucket(data);
-    
     // check if we have a perfect match
-    const Bucket::const_iterator perfect_match = std::find_if(
-        (*bucket_it)->cbegin(),(*bucket_it)->cend(),
-            [&data](const NodeSPtr& a) { return *a == data; } );
-    
-    if ( perfect_match != (*bucket_it)->cend() )
+    const boost::optional<NodeSPtr> perfect_match = snapshot.buckets[index]->find(data);
+    if (!!perfect_match)
     {
-        nodes.push_back(*perfect_match);
+        nodes._nodes[0] = *perfect_match;
+        nodes._count = 1;
         return nodes;
     }
-    
-    // in case a perfect match is not found the closest nodes are returned
-    if (bucket_it != _buckets.begin())
-        --bucket_it; // put it at the left bucket
 
-    for( int i = 0; i < 3 && bucket_it != _buckets.end(); ++i, ++bucket_it )
+    scan(*snapshot.buckets[index]);
+    for( size_t i = index+1; i < snapshot.bucketsCount; ++i )
     {
-        for( auto it = (*bucket_it)->cbegin(); it != (*bucket_it)->cend(); ++it)
-        {
-            knownNodes.insert(*it);
-        }
+        scan(*snapshot.buckets[i]);
+    }
+    for( size_t i = index; i > 0 && heapSize < heap.size(); --i )
+    {
+        scan(*snapshot.buckets[i-1]);
     }
 
-    auto it = knownNodes.begin();
-    for( size_t __i = 0; __i < knownNodes.size() && __i < DHT_FIND_NODE_COUNT;  ++__i, ++it )
+    std::sort_heap(heap.begin(),heap.begin()+heapSize,farther);
+    for( size_t i = 0; i < heapSize; ++i )
     {
-        nodes.push_back(*it);
+        nodes._nodes[i] = *heap[i].second;
     }
+    nodes._count = heapSize;
     return nodes;
 }
 
@@ -214,7 +382,8 @@ const NodeData& NodeTree::getTableNode() const noexcept
 
 size_t NodeTree::getBucketsCount() const noexcept
 {
-    return _buckets.size();
+    utils::GracePeriod::ReadGuard guard(_readers);
+    return _snapshot.load()->bucketsCount;
 }
 
 }; // dht
@@ -2,13 +2,18 @@
 
 #include <torrentsync/dht/Node.h>
 #include <torrentsync/dht/NodeBucket.h>
+#include <torrentsync/dht/EndpointIndex.h>
 #include <torrentsync/dht/DHTConstants.h>
+#include <torrentsync/utils/GracePeriod.h>
 
 #include <memory>
 #include <mutex>
-#include <set>
-#include <list>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
 
+#include <boost/array.hpp>
 #include <boost/utility.hpp>
 
 namespace torrentsync
@@ -18,15 +23,50 @@ namespace dht
 
 typedef torrentsync::dht::NodeBucket<DHT_K> Bucket;
 typedef std::shared_ptr<Bucket> BucketSPtr;
-typedef std::set<std::shared_ptr<Bucket>, bool(*)(const BucketSPtr&,const BucketSPtr&) > BucketContainer;
+//! one bucket for every common prefix length with the table node, plus the
+//! bucket containing the table node itself
+typedef boost::array<BucketSPtr, NodeData::ADDRESS_BITS+1> BucketContainer;
 typedef std::pair<BucketSPtr,BucketSPtr> BucketSPtrPair;
 typedef boost::optional<BucketSPtrPair> MaybeBuckets;
+
+//! The closest known nodes to an address, sorted by distance
+class ClosestNodes
+{
+public:
+    typedef std::array<NodeSPtr, DHT_FIND_NODE_COUNT> NodeArray;
+    typedef NodeArray::const_iterator const_iterator;
+
+    ClosestNodes() : _count(0) {}
+
+    const_iterator begin() const noexcept { return _nodes.begin(); }
+    const_iterator end()   const noexcept { return _nodes.begin()+_count; }
+
+    size_t size()  const noexcept { return _count; }
+    bool   empty() const noexcept { return _count == 0; }
+
+    const NodeSPtr& operator[]( const size_t index ) const { return _nodes[index]; }
+
+private:
+    friend class NodeTree;
+
+    NodeArray _nodes;
+    size_t    _count;
+};
  
 /**
  * NodeTree is the tree structure to keep the known DHT addresses as per DHT 
  * specification.
+ * Only the bucket containing our own address is ever split, so the buckets
+ * are indexed by the common prefix length of their addresses with our own
+ * address: bucket i holds the addresses sharing exactly i leading bits with
+ * it, the last one everything closer.
  * Access to this class is thread safe as it manages it's own internal
- * consistency.
+ * consistency. The readers never lock: the buckets are published as an
+ * immutable snapshot, the writers are serialized and change a copy of the
+ * snapshot (and of the buckets they modify), then replace it and free the
+ * old one once no reader can be using it.
+ * The nodes in the buckets are also indexed by endpoint, that index has
+ * its own lock, held for a single lookup.
  */
 class NodeTree : public boost::noncopyable
 {
@@ -45,6 +85,13 @@ public:
     //! Removes an address
     void removeNode( NodeSPtr address );
 
+    /** Removes a node which stopped answering, the freshest replacement
+     * candidate of its bucket takes its place.
+     * @param address the node
+     * @return the promoted node, if any
+     */
+    const boost::optional<NodeSPtr> replaceNode( NodeSPtr address );
+
     //! Returns the number of addresses stored in the container
     //! @return number of address.
     size_t size() const noexcept;
@@ -59,37 +106,102 @@ public:
     const boost::optional<NodeSPtr> getNode(
         const NodeData& data ) const noexcept;
 
-    //! find the closest (DHT_FIND_NODE_COUNT) addresses to this address we know
-    const std::list<NodeSPtr> getClosestNodes(
+    /** find the node in the tree using an endpoint, complexity O(1)
+     * The endpoint of a node must not change while it's in the tree.
+     * @param endpoint the endpoint
+     * @return the last node added with it, if any
+     */
+    const boost::optional<NodeSPtr> getNodeByEndpoint(
+        const udp::endpoint& endpoint ) const;
+
+    /** find the closest (DHT_FIND_NODE_COUNT) addresses to this address we
+     * know, by XOR distance. If the address itself is known it is the only
+     * one returned.
+     * @param data the target address
+     * @return the nodes, the closest first
+     */
+    ClosestNodes getClosestNodes(
         const NodeData& data) const;
+
+    //! returns the counts of the buckets
+    size_t getBucketsCount() const noexcept;
+
+    //! @return every node in the tree, bucket after bucket
+    std::vector<NodeSPtr> getNodes() const;
  
 protected:
 
+    //! serializes the writers
     mutable std::mutex mutex;
 
-    //! splits, if possible, a bucket in 2 splitting the contents
-    MaybeBuckets split( BucketContainer::const_iterator bucket_it );
-
     /** Finds the bucket containing the address space for this address.
-     *  Should be called from a read-lock; it will always return a valid bucket.
-     *  complexity: O(log n)
+     *  complexity: O(1)
      *  @param address the address
-     *  @return iterator to bucket
+     *  @return index of the bucket in the current snapshot
      */
-    BucketContainer::const_iterator findBucket(
-        const NodeData& address ) const; 
-
-    //! returns the counts of the buckets
-    size_t getBucketsCount() const noexcept;
+    size_t findBucket(
+        const NodeData& address ) const noexcept;
 
 private:
-    //! bucket container
-    BucketContainer _buckets;
+
+    //! a version of the buckets, never modified once published but for the
+    //! replacement caches, which the readers don't access
+    struct Snapshot
+    {
+        //! bucket container, the first bucketsCount are set
+        BucketContainer buckets;
+
+        //! number of buckets in use
+        size_t bucketsCount;
+    };
+
+    //! index of the bucket for the address in the snapshot
+    inline size_t findBucket(
+        const Snapshot& snapshot,
+        const NodeData& address ) const noexcept;
+
+    //! splits, if possible, the last bucket in 2 splitting the contents.
+    //! The half not containing our own address takes its index.
+    MaybeBuckets split( Snapshot& snapshot );
+
+    /** updates the endpoint index with the nodes removed from a bucket and
+     * the ones added to its replacements
+     * @param before the bucket before the change
+     * @param after the first of the buckets replacing it
+     * @param count the number of buckets replacing it, 2 after a split
+     */
+    void reindex(
+        const Bucket& before,
+        const BucketSPtr* after,
+        const size_t count );
+
+    //! replaces the current snapshot, waiting for the readers of the old one
+    //! to free it. Must be called by a writer.
+    void publish( std::unique_ptr<Snapshot> snapshot ) noexcept;
+
+    //! the current snapshot
+    std::atomic<const Snapshot*> _snapshot;
+
+    //! the readers of the snapshots
+    mutable utils::GracePeriod _readers;
 
     //! address used as the center of the tree
     const NodeData _node;
 
+    //! the nodes in the buckets by endpoint
+    EndpointIndex _endpoints;
+
+    //! protects the endpoint index
+    mutable std::mutex _endpointsMutex;
+
 };
 
+size_t NodeTree::findBucket(
+    const Snapshot& snapshot,
+    const NodeData& address ) const noexcept
+{
+    return std::min(_node.commonPrefixLength(address),snapshot.bucketsCount-1);
+}
+
 }; // dht
 }; // torrentsync
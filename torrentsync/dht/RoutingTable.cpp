@@ -1,6 +1,6 @@
 #include <torrentsync/utils/log/Logger.h>
 #include <torrentsync/utils/Buffer.h>
-#include <torrentsync/utils/Finally.h>
+#include <torrentsync/utils/RandomGenerator.h>
 #include <torrentsync/dht/RoutingTable.h>
 
 #include <torrentsync/dht/message/Message.h>
@@ -14,12 +14,8 @@
 #include <boost/asio.hpp>
 #include <boost/cast.hpp>
 
-//! Maximum amount of packets in the send queue.
-//! In case there are more then the package will be dropped.
-static const size_t MAX_SEND_QUEUE = 100;
-
-//! Maximum number of seconds to wait for a reply.
-static const size_t ROUTINGTABLE_TIMEOUT = 10;
+//! shares the port among the sockets of the receivers
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET,SO_REUSEPORT> reuse_port;
 
 namespace torrentsync
 {
@@ -28,14 +24,50 @@ namespace dht
 
 namespace msg = dht::message;
 
+thread_local utils::BatchedSocket* RoutingTable::_reply_socket = nullptr;
+
+RoutingTable::Shard::Shard(
+    const udp::endpoint& endpoint,
+    const utils::SendQueue::Config& sendQueue)
+        : work(service),
+          socket(service),
+          batch(socket,MESSAGE_BUFFER_SIZE,sendQueue)
+{
+    socket.open(endpoint.protocol());
+    socket.set_option(reuse_port(true));
+    socket.bind(endpoint);
+}
+
+RoutingTable::Shard::~Shard()
+{
+    service.stop();
+    if (thread.joinable())
+        thread.join();
+}
+
 RoutingTable::RoutingTable(
     boost::asio::io_service& io_service)
-        : _table(NodeData::getRandom()),
+        : RoutingTable(io_service,NodeData::getRandom())
+{
+}
+
+RoutingTable::RoutingTable(
+    boost::asio::io_service& io_service,
+    const NodeData& tableNode,
+    const utils::SendQueue::Config& sendQueue)
+        : _table(tableNode),
           _io_service(io_service),
           _recv_socket(io_service),
-          _send_socket(io_service),
+          _batch(_recv_socket,MESSAGE_BUFFER_SIZE,sendQueue),
           _close_nodes_count(0),
-          _transaction_id(rand()) // initialize with a random value
+          _wheel(io_service),
+          _transactions(_wheel,
+              [this]( const utils::Buffer& buff,
+                      const udp::endpoint& addr,
+                      const utils::SendQueue::class_t cls)
+              {
+                  sendMessage(buff,addr,cls);
+              })
 {
     LOG(INFO, "RoutingTable * Table Node: " << _table.getTableNode());
 }
@@ -45,106 +77,102 @@ udp::endpoint RoutingTable::getEndpoint() const
     return _recv_socket.local_endpoint();
 }
 
-void RoutingTable::tableMaintenance()
-{
-    throw std::runtime_error("Not Implemented Yet");
-}
-
 void RoutingTable::initializeNetwork(
-    const udp::endpoint& endpoint )
+    const udp::endpoint& endpoint,
+    const size_t receivers )
 {
-    if (_send_socket.is_open() || _recv_socket.is_open())
+    if (_recv_socket.is_open())
         throw std::runtime_error("The Routing table network has already been initialized");
     LOG(INFO, "RoutingTable * Bind Node: " << endpoint);
-    _send_socket.open(endpoint.protocol());
     _recv_socket.open(endpoint.protocol());
+    if (receivers > 1)
+        _recv_socket.set_option(reuse_port(true));
     _recv_socket.bind(endpoint);
-    scheduleNextReceive();
-    initializeTable();
-}
+    _batch.startReceive([this](
+        const boost::system::error_code& error,
+        const utils::ReceiveRing::Slot& slot)
+        {
+            recvMessage(error,slot,nullptr);
+        });
 
-void RoutingTable::scheduleNextReceive()
-{
-    std::shared_ptr<utils::Buffer> buff(
-        new utils::Buffer);
-    buff->assign(MESSAGE_BUFFER_SIZE,0); // assign buffer size
-    std::shared_ptr<boost::asio::ip::udp::endpoint> sender(
-        new boost::asio::ip::udp::endpoint());
-
-    LOG(DEBUG,"Scheduling receive"); 
-    
-    _recv_socket.async_receive_from(
-            boost::asio::buffer(*buff,MESSAGE_BUFFER_SIZE),
-            *sender,
-            [&,sender,buff] (
-                  const boost::system::error_code& error,
-                  std::size_t bytes_transferred) -> void 
-                {
-                utils::Finally([&](){scheduleNextReceive();});
-                recvMessage(error,*buff,bytes_transferred,*sender);
+    // the same port, the first socket resolved it if it was 0
+    for( size_t i = 1; i < receivers; ++i )
+    {
+        _shards.emplace_back(new Shard(_recv_socket.local_endpoint(),getSendConfig()));
+        Shard& shard = *_shards.back();
+        shard.batch.startReceive([this,&shard](
+            const boost::system::error_code& error,
+            const utils::ReceiveRing::Slot& slot)
+            {
+                recvMessage(error,slot,&shard);
             });
+        shard.thread = std::thread([&shard]() { shard.service.run(); });
+    }
+    LOG(INFO, "RoutingTable * Receiving with " << receivers << " sockets");
+    initializeTable();
+    tableMaintenance();
 }
 
-void RoutingTable::registerCallback(
-    const Callback::callback_t& func,
+void RoutingTable::sendQuery(
     const utils::Buffer& transactionID,
+    const utils::Buffer& query,
+    const udp::endpoint& destination,
+    const utils::SendQueue::class_t cls,
+    const TransactionTable::callback_t& func,
     const boost::optional<dht::NodeData>& source)
 {
-    _callbacks.insert(
-        std::make_pair(
-            transactionID,
-            Callback(func,source,transactionID)));
+    const boost::optional<TransactionTable::id_t> id =
+        TransactionTable::fromBuffer(transactionID);
+    assert(!!id);
+    _transactions.open(*id,query,destination,cls,func,source);
 }
 
-boost::optional<Callback> RoutingTable::getCallback(
-    const message::Message& message)
+TransactionTable::callback_t RoutingTable::getCallback(
+    const message::Message& message,
+    const udp::endpoint& sender)
 {
-    auto its = _callbacks.equal_range(message.getID());
-
-    boost::optional<Callback> ret;
-    for( auto it = its.first; it != its.second; ++it )
-    {
-        if (it->second.verifyConstraints(message))
-        {
-            ret = it->second;
-            _callbacks.erase(it);
-            break;
-        }
-    }
-
-    return ret;
+    return _transactions.close(
+        message.getTransactionID(),sender,NodeData(message.getID()));
 }
 
 void RoutingTable::sendMessage(
     const utils::Buffer& buff,
-    const udp::endpoint& addr)
+    const udp::endpoint& addr,
+    const utils::SendQueue::class_t cls)
 {
-    static std::atomic<size_t> send_queue_counter(0);
-
-    // the write handler will ensure that the buffer exists until the
-    // end of the send.
-    std::lock_guard<std::mutex> lock(_send_mutex);
+    // the replies from the socket which received the query
+    utils::BatchedSocket& socket =
+        cls == utils::SendQueue::REPLY && _reply_socket ? *_reply_socket : _batch;
 
-    const size_t count = send_queue_counter.fetch_add(1);
-    if (count < MAX_SEND_QUEUE)
+    if (socket.send(buff,addr,cls))
     {
-        _recv_socket.async_send_to(
-            boost::asio::buffer(buff),
-            addr,
-            [=] (
-                  const boost::system::error_code& error,
-                  std::size_t bytes_transferred) -> void 
-                { send_queue_counter--;
-                  LOG(DEBUG,"RoutingTable * Sent to " << addr << " " <<
-                    bytes_transferred << "/" << buff.size() << " e:" <<
-                    error.message() << " buffer:" << pretty_print(buff)); });
-    } else {
-        LOG(DEBUG,"RoutingTable * dropped to " << addr << " " << " buffer:"<<buff);
-        send_queue_counter--;
+        LOG(DEBUG,"RoutingTable * Sending " << utils::SendQueue::classToString(cls) <<
+            " to " << addr << " buffer:" << pretty_print(buff));
+    }
+    else
+    {
+        LOG(DEBUG,"RoutingTable * dropped " << utils::SendQueue::classToString(cls) <<
+            " to " << addr << " buffer:" << buff);
     }
 }
 
 
+utils::SendQueue::Counters RoutingTable::getSendCounters(
+    const utils::SendQueue::class_t cls ) const
+{
+    utils::SendQueue::Counters counters = _batch.getCounters(cls);
+    for( const std::unique_ptr<Shard>& shard : _shards )
+    {
+        const utils::SendQueue::Counters other = shard->batch.getCounters(cls);
+        counters.queued   += other.queued;
+        counters.sent     += other.sent;
+        counters.dropped  += other.dropped;
+        counters.depth    += other.depth;
+        counters.maxDepth  = std::max(counters.maxDepth,other.maxDepth);
+    }
+    return counters;
+}
+
 std::shared_ptr<boost::asio::ip::tcp::socket> RoutingTable::lookForNode()
 {
     throw std::runtime_error("Not Implemented Yet");
@@ -154,12 +182,7 @@ std::shared_ptr<boost::asio::ip::tcp::socket> RoutingTable::lookForNode()
 
 utils::Buffer RoutingTable::newTransaction()
 {
-    utils::Buffer buff;
-    buff.reserve(2);
-    uint16_t value = _transaction_id++; // as per BEP 005 suggestion
-    buff.push_back(value);
-    buff.push_back(value>>8);
-    return buff;
+    return TransactionTable::toBuffer(_transactions.next());
 }
 
 }; // dht
@@ -1,19 +1,25 @@
 #pragma once
 
-#include <boost/serialization/version.hpp>
-#include <boost/serialization/split_member.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
 
-#include <torrentsync/dht/Callback.h>
 #include <torrentsync/dht/NodeTree.h>
+#include <torrentsync/dht/TableSnapshot.h>
+#include <torrentsync/dht/TransactionTable.h>
+#include <torrentsync/dht/message/DatagramFilter.h>
+#include <torrentsync/utils/Arena.h>
+#include <torrentsync/utils/BatchedSocket.h>
+#include <torrentsync/utils/TimerWheel.h>
 
 #include <exception>
 #include <mutex>
-#include <map>
 #include <list>
+#include <memory>
+#include <thread>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 #include <atomic>
 
 namespace torrentsync
@@ -51,6 +57,15 @@ public:
     RoutingTable(
         boost::asio::io_service& io_service);
 
+    //! Constructor
+    //! @param tableNode the address of the table, usually the one of a
+    //!        previous run
+    //! @param sendQueue the size and the rate limits of the send queue
+    RoutingTable(
+        boost::asio::io_service& io_service,
+        const NodeData& tableNode,
+        const utils::SendQueue::Config& sendQueue = utils::SendQueue::Config());
+
     virtual ~RoutingTable() = default;
 
     //! @return DHT table endpoint
@@ -62,12 +77,49 @@ public:
     //!       an address. still missing every parameter.
     std::shared_ptr<boost::asio::ip::tcp::socket> lookForNode();
 
-    //! Initializes network sockets binding to the specific endpoint.
-    //! May throw exceptions for error
-    //! @param endpoint to bind to
-    //! @throws boost::system::system_error throw in case of error
+    //! @return the counters of the received datagrams, by outcome
+    const message::DatagramFilter& getFilter() const noexcept { return _filter; }
+
+    //! @return the counters of the send queues for a traffic class, summed
+    //!         over the sockets
+    utils::SendQueue::Counters getSendCounters(
+        const utils::SendQueue::class_t cls ) const;
+
+    //! @return the size and the rate limits of the send queue
+    const utils::SendQueue::Config& getSendConfig() const noexcept { return _batch.getConfig(); }
+
+    /** Initializes network sockets binding to the specific endpoint.
+     * With more than a receiver the port is shared with SO_REUSEPORT by a
+     * socket per receiver, and the kernel spreads the senders among them.
+     * The sockets after the first have their own thread and io_service,
+     * where the ping and find_node queries are parsed and answered; the
+     * other messages are handed to the io_service of the table, the only
+     * one changing its state.
+     * @param endpoint to bind to
+     * @param receivers the sockets receiving on the port
+     * @throws boost::system::system_error throw in case of error
+     */
     void initializeNetwork(
-        const udp::endpoint& endpoint);
+        const udp::endpoint& endpoint,
+        const size_t receivers = 1);
+
+    //! @return the sockets receiving on the port of the table
+    size_t getReceiversCount() const noexcept { return 1+_shards.size(); }
+
+    /** Saves the known nodes, to be loaded by the next run.
+     * @param path the snapshot file
+     * @throws std::system_error if the file can't be written
+     */
+    void saveTable( const std::string& path ) const;
+
+    /** Adds the nodes of a previous run to the table.
+     * Every node is verified with a ping, the pings spread over
+     * LOAD_VERIFY_INTERVAL, and the closest ones are used to initialize
+     * the table instead of bootstrapping.
+     * Must be called before initializeNetwork.
+     * @param snapshot the nodes saved by saveTable
+     */
+    void loadTable( const TableSnapshot& snapshot );
     
 protected:
     //! Initalizes the tables by trying to contact the initial addresses stored
@@ -79,101 +131,134 @@ protected:
     //! table has not finished.
     void bootstrap();
 
-    //! Performs a table cleanup, usually called by a timer from boost::asio
-    //! - removes bad addresses,
-    //! - starts bucket refresh,
-    //! - sends ping to aging nodes.
-    //! - look for close nodes.
-    //! - clean timedout callbacks.
+    //! Starts the table maintenance on the timer wheel:
+    //! - refreshes every bucket each BUCKET_REFRESH_INTERVAL, the buckets
+    //!   spread evenly over the interval,
+    //! - pings the nodes becoming questionable, replacing the bad ones.
+    //! The transactions are timed out by the wheel anyway.
     void tableMaintenance();
 
+    //! looks for a random address in the bucket with the prefix length
+    //! and reschedules itself
+    void refreshBucket( const size_t prefixLength );
+
     //! Sends a message to the specified address
-    //! It will send it asynchronously putting them in a queue of at
-    //! most MAX_SEND_QUEUE length.
-    //! @throws boost::system::system_error
+    //! It will send it asynchronously putting them in the send queue,
+    //! flushed in batches, the higher traffic classes first.
+    //! @param cls the traffic class, replies are the last to be dropped
     virtual void sendMessage(
         const utils::Buffer&,
-        const udp::endpoint& addr);
+        const udp::endpoint& addr,
+        const utils::SendQueue::class_t cls);
+
+    //! a socket sharing the port of the table, served by its own thread
+    struct Shard : public boost::noncopyable
+    {
+        //! binds to the endpoint, sharing it
+        Shard(
+            const udp::endpoint& endpoint,
+            const utils::SendQueue::Config& sendQueue);
+
+        //! stops and joins the thread
+        ~Shard();
 
-    //! @TODO
+        boost::asio::io_service service;
+        boost::asio::io_service::work work;
+        udp::socket socket;
+        utils::BatchedSocket batch;
+
+        //! memory for the processing of a received packet
+        utils::Arena arena;
+
+        std::thread thread;
+    };
+
+    /** Processes a received datagram, in place in its receive slot
+     * @param shard the receiving socket, if not the one of the table
+     */
     void recvMessage(
         const boost::system::error_code& error,
-        utils::Buffer buffer,
-        std::size_t bytes_transferred,
-        const boost::asio::ip::udp::endpoint& sender);
+        const utils::ReceiveRing::Slot& slot,
+        Shard* shard);
 
     //! list of address to populate the table with
     std::list<boost::asio::ip::udp::endpoint> _initial_addresses;
 
-    //! configure the io_service actions to receive messages
-    void scheduleNextReceive();
-
 private:
 
-    //! returns the most specific callback, and will be removed from the
-    //! callbacks.
-    boost::optional<Callback> getCallback(
-        const message::Message& message);
-
-    //! Registers a callback to be called when we receive a message.
-    //! It will be executed only once and before any other processing.
-    //! The callback will be removed in any case if it is not used in less than 60 seconds.
+    //! checks the sender and prefilters the datagram
+    //! @return false if the datagram is dropped
+    bool acceptDatagram(
+        const uint8_t* data,
+        const size_t length,
+        const udp::endpoint& sender);
+
+    //! parses and handles a datagram
+    //! @param arena memory for the message, reset at the end
+    //! @param shard the receiving socket, if not the one of the table. Only
+    //!        the queries are handled there, the rest is posted to the
+    //!        io_service of the table.
+    void handleDatagram(
+        const uint8_t* data,
+        const size_t length,
+        const udp::endpoint& sender,
+        utils::Arena& arena,
+        Shard* shard);
+
+    //! returns the callback of the transaction answered by the message,
+    //! closing the transaction. Empty if the message answers none.
+    TransactionTable::callback_t getCallback(
+        const message::Message& message,
+        const udp::endpoint& sender);
+
+    //! Sends a query and opens its transaction: the callback is called once,
+    //! with the reply or without after the timeout. The query is sent again
+    //! once if not answered in time.
+    //! @param transactionID of the query, from newTransaction()
+    //! @param query the message to send
+    //! @param destination where the query is sent, the reply must come from there
+    //! @param cls the traffic class of the query
     //! @param func is the function to call
-    //! @param type mandatory parameter specifying the type of the message to signal.
-    //!             must be from dht::messages::Messages.
     //! @param source optional parameter specifing if the message is awaited from a specific Peer
-    //! @param transactionID optional parameter specifing if the message is awaited from a specific Peer
-    void registerCallback(
-        const Callback::callback_t& func,
+    void sendQuery(
         const utils::Buffer& transactionID,
+        const utils::Buffer& query,
+        const udp::endpoint& destination,
+        const utils::SendQueue::class_t cls,
+        const TransactionTable::callback_t& func,
         const boost::optional<dht::NodeData>& source = boost::optional<dht::NodeData>());
 
     //! Node table
     NodeTree _table;
 
-    //! Serialization friend class
-    friend class boost::serialization::access;
-    
-    //! Split the serialization in 2 different steps
-    BOOST_SERIALIZATION_SPLIT_MEMBER();
-
-    template <class Archive>
-    void save( Archive &ar, const unsigned int version) const;
-
-    //! Loading serialize structure
-    //! @throws std::invalid_argument in case the file is not readable,
-    //!         damaged of an unsupported version.
-    template <class Archive>
-    void load( Archive &ar, const unsigned int version);
-
     //! IO service of for the routing table
     boost::asio::io_service& _io_service;
 
-    //! Inbound socket 
+    //! Socket of the table, receiving and sending
     udp::socket _recv_socket;
 
-    //! Outbound socket 
-    udp::socket _send_socket;
+    //! Receives and sends the datagrams of the socket in batches
+    utils::BatchedSocket _batch;
+
+    //! the socket of the shard handling a query in this thread, the replies
+    //! are sent from it
+    static thread_local utils::BatchedSocket* _reply_socket;
 
-    //! Outbout mutex
-    std::mutex _send_mutex;
+    //! Prefilter and counters of the received datagrams
+    message::DatagramFilter _filter;
 
-    //! Callbacks container.
-    //! A multimap is enough as anyway there shouldn't be more than one
-    //! request at the same time (even though it may happen).
-    std::multimap<
-        utils::Buffer,
-        dht::Callback> _callbacks;
+    //! Memory for the processing of a received packet, reset after every
+    //! packet. Only the receive handler uses it.
+    utils::Arena _packet_arena;
 
     //! Number of close nodes found.
     std::atomic<size_t> _close_nodes_count;
 
-    //! Transaction ID counter.
-    std::atomic<uint16_t> _transaction_id;
-    
-    //! Returns a new Transacton ID. Starts with a random value and
-    //! will increase up to INT16_MAX when it will be reset to 0 and
-    //! restart.
+    //! the endpoints pinged for a new ID, by compact endpoint. Used from
+    //! the io_service of the table only.
+    std::unordered_set<uint64_t> _verifying;
+
+    //! Returns a new random Transacton ID, not waiting for a reply.
     utils::Buffer newTransaction();
     
     //! ************** Message handlers *****************
@@ -205,39 +290,76 @@ private:
         const dht::message::reply::FindNode&,
         const dht::Node&);
 
+    //! Handle replies not expected by any callback.
+    void handleUnexpectedReply(
+        const dht::message::Message&,
+        const dht::Node&);
+
+    //! Handle error messages. An error has no node ID, it only ends the
+    //! transaction of the query it answers.
+    void handleError(
+        const dht::message::Message&,
+        const udp::endpoint& sender);
+
+    //! ************** Table maintenance *****************
+
     //! sends a ping message to the destination node (and setup a callback to receive).
-    void doPing( dht::Node& destination );
-};
+    //! A node not answering is checked again later, and replaced once bad.
+    void doPing( const dht::NodeSPtr& destination );
+
+    //! adds a node to the table, scheduling its checks
+    //! @return false if the node was not added
+    bool addNode( const dht::NodeSPtr& node );
+
+    //! schedules checkNode for when the node stops being good
+    void scheduleNodeCheck( const dht::NodeSPtr& node );
+
+    //! pings the node if questionable, replaces it if bad
+    void checkNode( const dht::NodeSPtr& node );
+
+    /** pings an endpoint of the table which sent a message with another ID,
+     * the node with the new ID takes the place of the previous one if it
+     * answers. A forged datagram costs a ping, not the node. Only one
+     * ping is in flight for an endpoint.
+     * @param previous the node of the table at the endpoint
+     * @param id the new ID
+     * @param endpoint of the node
+     */
+    void verifyNewID(
+        const dht::NodeSPtr& previous,
+        const dht::NodeData& id,
+        const udp::endpoint& endpoint );
 
-template <class Archive>
-void RoutingTable::save( Archive &ar, const unsigned int version) const
-{
-    if (version <= 0)
-    {
-        ar << _table.size();
-        throw std::runtime_error("Not Implemented Yet");
-        // @TODO
-    }
-}
-
-template <class Archive>
-void RoutingTable::load( Archive &ar, const unsigned int version)
-{
-    if (version > 0 )
-    {
-        throw std::invalid_argument("Unsupported file version");
-    }
-    size_t nodes_count;
-    ar >> nodes_count;
-    throw std::runtime_error("Not Implemented Yet");
-    // @TODO 
-    // refresh all the nodes
-    // 1. ping all known and insert them in the routing table with the normal procedure
-    // 2. perform normal startup operation and let the bucket refreshing do it's job
-}
+    //! ************** Message dispatching *****************
+
+    //! handles a message, which must be of the class matching its kind
+    typedef void (RoutingTable::*handler_t)(
+        const dht::message::Message&,
+        const dht::Node&);
+
+    //! the handlers indexed by message kind, message::KRPC::kind_t
+    static const handler_t _handlers[];
+
+    //! adapts a handler of a specific message class to handler_t
+    template <
+        class MessageType,
+        void (RoutingTable::*Handler)(const MessageType&, const dht::Node&)>
+    void dispatch(
+        const dht::message::Message&,
+        const dht::Node&);
+
+    //! Timers of the callbacks and of the table maintenance, declared
+    //! after the rest of the table to be destroyed before it.
+    utils::TimerWheel _wheel;
+
+    //! The queries waiting for a reply, their deadlines on the wheel
+    TransactionTable _transactions;
+
+    //! the other sockets receiving on the port, declared last to stop
+    //! their threads first
+    std::vector<std::unique_ptr<Shard> > _shards;
+};
 
 }; // dht
 }; // torrentsync
 
-BOOST_CLASS_VERSION(torrentsync::dht::RoutingTable, 0);
-
@@ -82,36 +82,34 @@ void RoutingTable::initializeTable()
                             _table.getTableNode(),
                             _table.getTableNode());
                     
-                    registerCallback([&](
-                        boost::optional<Callback::payload_type> data,
-                        const dht::Callback& trigger) {
+                    // send the message
+                    sendQuery(transaction,msg,endpoint,utils::SendQueue::LOOKUP,[&](
+                        boost::optional<TransactionTable::payload_type> data) {
 
                         if (!!data)
                         {
                             try
                             {
-                                const msg::reply::FindNode& find_node = dynamic_cast<const msg::reply::FindNode&>(data->message);
-                                auto nodes = find_node.getNodes();
-                                std::for_each( nodes.begin(), nodes.end(),
-                                    [&]( const dht::NodeSPtr& t )
+                                // the replies are built as plain messages
+                                const msg::reply::FindNode find_node(data->message);
+                                for( const msg::CompactNode& node : find_node.getCompactNodes() )
                                 {
-                                    if (!!t->getEndpoint())
-                                        _initial_addresses.push_front(*t->getEndpoint());
-                                    _table.addNode(NodeSPtr(t));
-                                });
+                                    _initial_addresses.push_front(node.endpoint);
+
+                                    // only nodes new to the table are allocated
+                                    if (!_table.getNode(node.id))
+                                        addNode(makeNode(node.id,node.endpoint));
+                                }
                             }
-                            catch(  std::bad_cast& e )
+                            catch( const msg::MalformedMessageException& e )
                             {
-                                LOG(WARN, "A message different from find node received");
+                                LOG(WARN, "A message different from find node received: " << e.what());
                                 return;
                             }
                             // put all the nodes received at the front of _initial_addresses
                             // _close_nodes_count must be incremented as necessary
                         }
-                    }, transaction);
-
-                    // send the message
-                    sendMessage(msg,endpoint);
+                    });
                 }
 
                 LOG(DEBUG, "RoutingTable * " << _initial_addresses.size() <<
@@ -0,0 +1,255 @@
+#include <torrentsync/utils/log/Logger.h>
+#include <torrentsync/utils/Buffer.h>
+#include <torrentsync/dht/RoutingTable.h>
+#include <torrentsync/dht/message/query/Ping.h>
+#include <torrentsync/dht/message/query/FindNode.h>
+#include <torrentsync/dht/message/reply/FindNode.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+//! Interval between two refreshes of the same bucket, as per BEP 005.
+static const std::chrono::minutes BUCKET_REFRESH_INTERVAL(15);
+
+//! Seconds between the pings of a node not answering.
+static const std::chrono::seconds NODE_RETRY_INTERVAL(30);
+
+//! The pings verifying the nodes of a snapshot are spread over this time.
+static const std::chrono::seconds LOAD_VERIFY_INTERVAL(2);
+
+namespace torrentsync
+{
+namespace dht
+{
+
+namespace msg = dht::message;
+using namespace torrentsync;
+
+void RoutingTable::tableMaintenance()
+{
+    // every bucket has its own timer, the refreshes are spread evenly
+    // over the interval instead of happening all at once
+    const size_t buckets = NodeData::ADDRESS_BITS+1;
+    for( size_t i = 0; i < buckets; ++i )
+    {
+        _wheel.schedule(
+            std::chrono::duration_cast<utils::TimerWheel::duration>(
+                BUCKET_REFRESH_INTERVAL) * (i+1) / buckets,
+            [this,i]() { refreshBucket(i); });
+    }
+
+    _wheel.start();
+}
+
+bool RoutingTable::addNode( const NodeSPtr& node )
+{
+    if (!_table.addNode(node))
+        return false;
+
+    scheduleNodeCheck(node);
+    return true;
+}
+
+void RoutingTable::scheduleNodeCheck( const NodeSPtr& node )
+{
+    // the node is checked when it stops being good, one timer per node
+    const time_t questionable = node->getLastTimeGood() + Node::good_interval;
+    const time_t now = time(0);
+
+    _wheel.schedule(
+        std::chrono::seconds(questionable > now ? questionable-now : 0),
+        [this,node]() { checkNode(node); });
+}
+
+void RoutingTable::checkNode( const NodeSPtr& node )
+{
+    // the node was removed or replaced in the meantime
+    const boost::optional<NodeSPtr> current = _table.getNode(*node);
+    if (!current || *current != node)
+        return;
+
+    if (node->isGood())
+    {
+        scheduleNodeCheck(node);
+    }
+    else if (node->isBad())
+    {
+        LOG(DEBUG,"RoutingTable * replacing bad node " << *node);
+        const boost::optional<NodeSPtr> replacement = _table.replaceNode(node);
+        if (!!replacement)
+            scheduleNodeCheck(*replacement);
+    }
+    else
+    {
+        doPing(node);
+    }
+}
+
+void RoutingTable::doPing(
+    const dht::NodeSPtr& destination )
+{
+    assert(!!(destination->getEndpoint()));
+
+    torrentsync::utils::Buffer transaction = newTransaction();
+
+    torrentsync::utils::Buffer ping = msg::query::Ping::make(
+        transaction,
+        _table.getTableNode());
+
+    // send ping query
+    const auto sent = std::chrono::steady_clock::now();
+    sendQuery(transaction, ping, *(destination->getEndpoint()),
+        utils::SendQueue::MAINTENANCE, [this,destination,sent](
+            boost::optional<TransactionTable::payload_type> data) {
+
+            if (!!data)
+            {
+                destination->setGood(); // mark the node as good
+                const auto rtt = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - sent).count();
+                destination->setRTT(static_cast<uint16_t>(
+                    std::min<decltype(rtt)>(rtt,UINT16_MAX)));
+                LOG(DEBUG,"Ping handled: " << *destination );
+                scheduleNodeCheck(destination);
+            }
+            else
+            {
+                // checked again later, replaced once bad
+                destination->addUnansweredQuery();
+                _wheel.schedule(
+                    NODE_RETRY_INTERVAL,
+                    [this,destination]() { checkNode(destination); });
+            }
+        }, *destination);
+}
+
+void RoutingTable::verifyNewID(
+    const dht::NodeSPtr& previous,
+    const dht::NodeData& id,
+    const udp::endpoint& endpoint )
+{
+    // the queries with the new ID keep coming while the ping is in flight
+    const uint64_t key = Node::compactEndpoint(endpoint);
+    if (!_verifying.insert(key).second)
+        return;
+
+    const utils::Buffer transaction = newTransaction();
+    const utils::Buffer ping = msg::query::Ping::make(
+        transaction,
+        _table.getTableNode());
+
+    sendQuery(transaction, ping, endpoint, utils::SendQueue::MAINTENANCE,
+        [this,previous,id,endpoint,key](
+            boost::optional<TransactionTable::payload_type> data) {
+
+            _verifying.erase(key);
+            if (!data)
+                return;
+
+            // the previous node may have been replaced in the meantime
+            const boost::optional<NodeSPtr> current = _table.getNode(*previous);
+            if (!!current && *current == previous)
+                _table.removeNode(previous);
+
+            if (!_table.getNode(id))
+            {
+                const NodeSPtr node = makeNode(id,endpoint);
+                node->setGood();
+                addNode(node);
+            }
+        }, id);
+}
+
+void RoutingTable::saveTable( const std::string& path ) const
+{
+    TableSnapshot::save(path,_table.getTableNode(),_table.getNodes());
+}
+
+void RoutingTable::loadTable( const TableSnapshot& snapshot )
+{
+    const TableSnapshot::RecordView& records = snapshot.getRecords();
+
+    size_t loaded = 0;
+    for( const SnapshotRecord& record : records )
+    {
+        if (!!_table.getNode(record.id))
+            continue;
+
+        const NodeSPtr node = record.toNode();
+        if (!_table.addNode(node))
+            continue;
+
+        // the answer to the ping starts the checks of the node, a bad one
+        // is replaced
+        _wheel.schedule(
+            std::chrono::duration_cast<utils::TimerWheel::duration>(
+                LOAD_VERIFY_INTERVAL) * loaded / records.size(),
+            [this,node]() {
+                const boost::optional<NodeSPtr> current = _table.getNode(*node);
+                if (!!current && *current == node)
+                    doPing(node);
+            });
+        ++loaded;
+    }
+
+    // the closest nodes replace the bootstrap servers
+    for( const NodeSPtr& node : _table.getClosestNodes(_table.getTableNode()) )
+    {
+        _initial_addresses.push_back(*node->getEndpoint());
+    }
+
+    LOG(INFO,"RoutingTable * loaded " << loaded << " of " <<
+        records.size() << " nodes from the snapshot");
+}
+
+void RoutingTable::refreshBucket( const size_t prefixLength )
+{
+    // the wheel keeps the refreshes of the buckets not split yet, their
+    // addresses are in the last bucket which is refreshed anyway
+    _wheel.schedule(
+        BUCKET_REFRESH_INTERVAL,
+        [this,prefixLength]() { refreshBucket(prefixLength); });
+
+    if (prefixLength >= _table.getBucketsCount())
+        return;
+
+    const NodeData target = _table.getTableNode().getRandomAtPrefix(prefixLength);
+    const ClosestNodes closest = _table.getClosestNodes(target);
+    if (closest.empty() || !closest[0]->getEndpoint())
+        return;
+
+    LOG(DEBUG,"RoutingTable * refreshing bucket " << prefixLength <<
+        " looking for " << target);
+
+    const utils::Buffer transaction = newTransaction();
+    const utils::Buffer query = msg::query::FindNode::make(
+        transaction,
+        _table.getTableNode(),
+        target);
+    sendQuery(transaction, query, *closest[0]->getEndpoint(),
+        utils::SendQueue::MAINTENANCE, [this](
+        boost::optional<TransactionTable::payload_type> data) {
+
+        if (!data)
+            return;
+
+        try
+        {
+            // the replies are built as plain messages
+            const msg::reply::FindNode find_node(data->message);
+            for( const msg::CompactNode& node : find_node.getCompactNodes() )
+            {
+                if (!_table.getNode(node.id))
+                    addNode(makeNode(node.id,node.endpoint));
+            }
+        }
+        catch( const msg::MalformedMessageException& e )
+        {
+            LOG(WARN, "A message different from find node received: " << e.what());
+        }
+    }, *closest[0]);
+}
+
+}; // dht
+}; // torrentsync
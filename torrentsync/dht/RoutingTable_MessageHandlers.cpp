@@ -5,7 +5,6 @@
 #include <torrentsync/dht/message/query/FindNode.h>
 #include <torrentsync/dht/message/reply/Ping.h>
 #include <torrentsync/dht/message/reply/FindNode.h>
-#include <torrentsync/dht/Callback.h>
 #include <torrentsync/utils/Yield.h>
 
 #include <exception> // for not implemented stuff
@@ -27,7 +26,8 @@ void RoutingTable::handlePingQuery(
     // send ping reply
     sendMessage( msg::reply::Ping::make(
                     ping.getTransactionID(), _table.getTableNode()),
-                 *(node.getEndpoint()) );
+                 *(node.getEndpoint()),
+                 utils::SendQueue::REPLY );
 }
 
 //! Handle ping reply.
@@ -45,13 +45,14 @@ void RoutingTable::handleFindNodeQuery(
     LOG(DEBUG,"Find Query received " << message.getID() << " " << node);
     assert(!!(node.getEndpoint()));
 
-    auto nodes = _table.getClosestNodes(node);
+    const auto nodes = _table.getClosestNodes(dht::NodeData(message.getTarget()));
     sendMessage(
         msg::reply::FindNode::make(
             message.getTransactionID(),
             _table.getTableNode(),
-            utils::makeYield<dht::NodeSPtr>(nodes.cbegin(),nodes.cend()).function()),
-        *(node.getEndpoint()));
+            utils::makeYield<dht::NodeSPtr>(nodes.begin(),nodes.end()).function()),
+        *(node.getEndpoint()),
+        utils::SendQueue::REPLY);
 }
 
 void RoutingTable::handleFindNodeReply(
@@ -61,30 +62,27 @@ void RoutingTable::handleFindNodeReply(
     LOG(WARN,"find_node reply without a callback. " << message.getID() << "-" << node );
 }
 
-void RoutingTable::doPing(
-    dht::Node& destination )
+void RoutingTable::handleUnexpectedReply(
+    const dht::message::Message& message,
+    const dht::Node& node)
 {
-    assert(!!(destination.getEndpoint()));
-
-    torrentsync::utils::Buffer transaction = newTransaction();
-
-    torrentsync::utils::Buffer ping = msg::query::Ping::make(
-        transaction,
-        _table.getTableNode());
-
-    registerCallback([&](
-            boost::optional<Callback::payload_type> data,
-            const torrentsync::dht::Callback&       trigger) {
+    // Replies should be all managed by a transaction
+    // Log the message and drop it, it's an unexpected reply.
+    // Maybe it's a reply that came to late or what not.
+    LOG(INFO, "RoutingTable * received unexpected reply: \n" << message << " " << node);
+}
 
-            if (!!data)
-            {
-                data->node.setGood(); // mark the node as good
-                LOG(DEBUG,"Ping handled: " << data->node );
-            }
-        }, transaction, destination);
+void RoutingTable::handleError(
+    const dht::message::Message& message,
+    const udp::endpoint& sender)
+{
+    LOG(INFO, "RoutingTable * received error from " << sender << ": \n" << message);
 
-    // send ping reply
-    sendMessage( ping, *(destination.getEndpoint()) );
+    // the query failed, its transaction ends as if it timed out
+    const utils::BufferView transactionID = message.getTransactionID();
+    const TransactionTable::callback_t callback = _transactions.fail(transactionID,sender);
+    if (callback)
+        callback(boost::optional<TransactionTable::payload_type>());
 }
 
 } // dht
@@ -3,8 +3,9 @@
 #include <torrentsync/dht/RoutingTable.h>
 #include <torrentsync/dht/message/query/Ping.h>
 #include <torrentsync/dht/message/query/FindNode.h>
-#include <torrentsync/dht/Callback.h>
+#include <torrentsync/dht/message/DatagramFilter.h>
 #include <torrentsync/utils/Yield.h>
+#include <torrentsync/utils/Finally.h>
 
 #include <exception> // for not implemented stuff
 
@@ -16,21 +17,31 @@ namespace dht
 using namespace torrentsync;
 namespace msg = dht::message;
 
-void RoutingTable::recvMessage(
-    const boost::system::error_code& error,
-    utils::Buffer buffer,
-    std::size_t bytes_transferred,
-    const boost::asio::ip::udp::endpoint& sender)
+template <
+    class MessageType,
+    void (RoutingTable::*Handler)(const MessageType&, const dht::Node&)>
+void RoutingTable::dispatch(
+    const msg::Message& message,
+    const dht::Node&    node)
 {
-    namespace msg = dht::message;
-    
-    buffer.resize(bytes_transferred);
-    LOG(DEBUG,"RoutingTable * from " << sender << " received " <<
-        bytes_transferred <<  " " << pretty_print(buffer)
-        << " e:" << error.message());
+    // the message kind guarantees the class, see Message::buildMessage
+    (this->*Handler)(static_cast<const MessageType&>(message),node);
+}
 
-    std::shared_ptr<msg::Message> message;
+const RoutingTable::handler_t RoutingTable::_handlers[] = {
+    nullptr, // UNKNOWN, never built
+    &RoutingTable::dispatch<msg::query::Ping,&RoutingTable::handlePingQuery>,
+    &RoutingTable::dispatch<msg::query::FindNode,&RoutingTable::handleFindNodeQuery>,
+    nullptr, // UNKNOWN_QUERY, never built
+    &RoutingTable::handleUnexpectedReply,
+    nullptr, // ERROR, handled before looking for the node
+};
 
+void RoutingTable::recvMessage(
+    const boost::system::error_code& error,
+    const utils::ReceiveRing::Slot& slot,
+    Shard* shard)
+{
     // check for errors
     if (error)
     {
@@ -38,94 +49,162 @@ void RoutingTable::recvMessage(
         return;
     }
 
-    // parse the message
-    try
+    if (acceptDatagram(slot.data,slot.length,slot.sender))
     {
-        message = msg::Message::parseMessage(buffer);
-        LOG(DEBUG, "RoutingTable * message parsed: \n" << *message);
+        handleDatagram(slot.data,slot.length,slot.sender,
+            shard ? shard->arena : _packet_arena,shard);
     }
-    catch ( const msg::MalformedMessageException& e )
+}
+
+bool RoutingTable::acceptDatagram(
+    const uint8_t* data,
+    const size_t length,
+    const udp::endpoint& sender)
+{
+    // the nodes are IPv4 only, as the compact node info
+    if (!sender.address().is_v4())
     {
-        LOG(ERROR, "RoutingTable * message parsing failed: " << pretty_print(buffer) << " e:" << e.what());
-        return;
+        LOG(DEBUG,"RoutingTable * dropped datagram from " << sender);
+        return false;
+    }
+
+    // drop what can't be a KRPC message before any parsing
+    const msg::DatagramFilter::reason_t reason = _filter.check(data,length);
+    if (reason != msg::DatagramFilter::ACCEPTED)
+    {
+        LOG(DEBUG,"RoutingTable * from " << sender << " dropped " <<
+            length << " bytes: " <<
+            msg::DatagramFilter::reasonToString(reason));
+        return false;
     }
 
-    
-    const auto type = message->getType();
+    return true;
+}
+
+void RoutingTable::handleDatagram(
+    const uint8_t* data,
+    const size_t length,
+    const udp::endpoint& sender,
+    utils::Arena& arena,
+    Shard* shard)
+{
+    LOG(DEBUG,"RoutingTable * from " << sender << " received " <<
+        length <<  " " << pretty_print(data,length));
+
+    // everything allocated for the packet is released at once at the end,
+    // declared first to outlive the message
+    utils::Finally resetArena([&](){ arena.reset(); });
+
+    std::shared_ptr<msg::Message> message;
 
-    // fetch the node from the tree table
-    boost::optional<NodeSPtr> node = _table.getNode( message->getID() );
-    
-    if (!!node) // we already know the node
+    // parse the message
+    try
     {
-        const auto endpoint = (*node)->getEndpoint();
-        // message dropped if the data is still fresh but with a different IP.
-        if (!!endpoint && *endpoint != sender)
-            return;
+        message = msg::Message::parseMessage(data,length,arena);
+        LOG(DEBUG, "RoutingTable * message parsed: \n" << *message);
     }
-    else
+    catch ( const msg::MalformedMessageException& e )
     {
-        // create new node
-        node = boost::optional<NodeSPtr>(NodeSPtr(
-            new Node(message->getID(),sender)));
+        _filter.count(msg::DatagramFilter::MALFORMED);
+        LOG(DEBUG, "RoutingTable * message parsing failed from " << sender << " e:" << e.what());
+        return;
     }
 
-    // if a callback is registered call it instead of the normal flow
-    auto callback = getCallback(*message);
-    if( !!callback ) 
+    // the replies and the errors change the state of the table, they are
+    // handled again by the thread owning it
+    const msg::KRPC::kind_t kind = message->getKind();
+    if (shard && kind != msg::KRPC::PING_QUERY && kind != msg::KRPC::FIND_NODE_QUERY)
     {
-        callback->call(*message,**node);
+        const utils::Buffer datagram(data,data+length);
+        boost::asio::post(_io_service,[this,datagram,sender]()
+            {
+                handleDatagram(datagram.data(),datagram.size(),sender,_packet_arena,nullptr);
+            });
+        return;
     }
-    else
+
+    // the parsing doesn't check the fields required by the kind, a missing
+    // node ID or transaction ID throws from here on
+    try
     {
-        if ( type == msg::Type::Query )
+        // an error has no node ID, it can only end a transaction
+        if (kind == msg::KRPC::ERROR)
+        {
+            handleError(*message,sender);
+            return;
+        }
+
+        // a reply may close a transaction
+        const bool answer = kind == msg::KRPC::REPLY;
+
+        // fetch the node from the tree table
+        boost::optional<NodeSPtr> node = _table.getNode( message->getID() );
+
+        if (!!node) // we already know the node
+        {
+            const auto endpoint = (*node)->getEndpoint();
+            // message dropped if the data is still fresh but with a different IP.
+            if (!!endpoint && *endpoint != sender)
+                return;
+        }
+        else
         {
-            const auto query = std::dynamic_pointer_cast<msg::Query>(message);
-            const auto msg_type = query->getMessageType();
-            try
+            // a known endpoint with a new ID, the node restarted or is cycling
+            // through IDs: only the latest is kept, once it answers a ping. The
+            // datagram may be forged, the table is not changed by it alone. Only
+            // the queries are checked, the answer to the ping is a reply.
+            const boost::optional<NodeSPtr> previous = _table.getNodeByEndpoint(sender);
+            if (!!previous && !answer)
             {
-                if ( msg_type == msg::Messages::Ping )
+                LOG(DEBUG,"RoutingTable * " << sender << " changed ID from " <<
+                    **previous << " to " << message->getID());
+                const NodeSPtr known = *previous;
+                const NodeData id(message->getID());
+                if (shard)
                 {
-                    handlePingQuery(
-                        *std::dynamic_pointer_cast<msg::query::Ping>(message),
-                        **node);
+                    boost::asio::post(_io_service,[this,known,id,sender]()
+                        {
+                            verifyNewID(known,id,sender);
+                        });
                 }
-                else if ( msg_type == msg::Messages::FindNode )
-                {
-                    handleFindNodeQuery(
-                        *std::dynamic_pointer_cast<msg::query::FindNode>(message),
-                        **node);
-                } 
                 else
                 {
-                   LOG(ERROR, "RoutingTable * unknown query type: " << pretty_print(buffer) << " - " << message);
+                    verifyNewID(known,id,sender);
                 }
             }
-            catch ( const std::bad_cast& e ) 
-            {
-                LOG(ERROR, " RoutingTable * A message was mis-interpreted! " << message << " Report this bug! ");
-            }
-            catch ( const dht::message::MalformedMessageException& e )
-            {
-                LOG(ERROR, " RoutingTable * malformed message: " << message);
-            }
-        }
-        else if (type == msg::Type::Reply)
-        {
-            // Replies should be all managed by a Callback
-            // Log the message and drop it, it's an unexpected reply.
-            // Maybe it's a reply that came to late or what not.
-            LOG(INFO, "RoutingTable * received unexpected reply: \n" << *message << " " << sender);
+
+            // create new node
+            node = boost::optional<NodeSPtr>(
+                makeNode(message->getID().toBuffer(),sender));
         }
-        else if ( type == msg::Type::Error )
+
+        // if a transaction waits for the reply call it instead of the normal flow
+        const TransactionTable::callback_t callback =
+            answer ? getCallback(*message,sender) : TransactionTable::callback_t();
+        if( callback )
         {
-            // @TODO implement error handling
+            callback(TransactionTable::payload_type(*message,**node));
         }
-        else 
+        else
         {
-            LOG(ERROR, "RoutingTable * unknown message type: " << pretty_print(buffer) << " - " << message);
+            // the replies to the queries leave from the socket which received them
+            _reply_socket = shard ? &shard->batch : nullptr;
+            utils::Finally resetSocket([](){ _reply_socket = nullptr; });
+
+            static_assert(
+                sizeof(_handlers)/sizeof(_handlers[0]) == msg::KRPC::KIND_COUNT,
+                "A handler is required for every message kind");
+
+            const handler_t handler = _handlers[message->getKind()];
+            assert(handler);
+            (this->*handler)(*message,**node);
         }
     }
+    catch ( const msg::MalformedMessageException& e )
+    {
+        _filter.count(msg::DatagramFilter::MALFORMED);
+        LOG(DEBUG, "RoutingTable * malformed message from " << sender << " e:" << e.what());
+    }
  
     // @TODO post-process
     // - add the node to the known addresses
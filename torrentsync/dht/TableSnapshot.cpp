@@ -0,0 +1,157 @@
+#include <torrentsync/dht/TableSnapshot.h>
+#include <torrentsync/utils/Endian.h>
+#include <torrentsync/utils/log/Logger.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//! first bytes of every snapshot
+static const uint8_t SNAPSHOT_MAGIC[4] = {'T','S','R','T'};
+
+namespace torrentsync
+{
+namespace dht
+{
+
+const size_t   SnapshotRecord::SIZE;
+const size_t   TableSnapshot::HEADER_SIZE;
+const uint16_t TableSnapshot::VERSION;
+
+SnapshotRecord SnapshotRecord::read( const uint8_t* data )
+{
+    SnapshotRecord ret;
+    ret.id.readFrom(data);
+    ret.endpoint = Node::readEndpoint(data+20);
+    ret.rtt      = utils::loadBE16(data+26);
+    ret.failures = utils::loadBE16(data+28);
+    ret.lastSeen = utils::loadBE64(data+32);
+    return ret;
+}
+
+void SnapshotRecord::write( uint8_t* out ) const
+{
+    id.writeTo(out);
+    Node::writeEndpoint(endpoint,out+20);
+    utils::storeBE16(out+26,rtt);
+    utils::storeBE16(out+28,failures);
+    utils::storeBE16(out+30,0);
+    utils::storeBE64(out+32,lastSeen);
+}
+
+SnapshotRecord SnapshotRecord::fromNode( const Node& node )
+{
+    SnapshotRecord ret;
+    ret.id       = node;
+    ret.endpoint = *node.getEndpoint();
+    ret.rtt      = node.getRTT();
+    ret.failures = static_cast<uint16_t>(
+        std::min<size_t>(node.getUnansweredQueries(),UINT16_MAX));
+    ret.lastSeen = static_cast<uint64_t>(node.getLastTimeGood());
+    return ret;
+}
+
+NodeSPtr SnapshotRecord::toNode() const
+{
+    NodeSPtr node = makeNode(id,endpoint);
+    node->restore(static_cast<time_t>(lastSeen),failures);
+    node->setRTT(rtt);
+    return node;
+}
+
+TableSnapshot::TableSnapshot( const std::string& path ) :
+    _file(path)
+{
+    const uint8_t* const data = _file.data();
+    if (_file.size() < HEADER_SIZE ||
+        memcmp(data,SNAPSHOT_MAGIC,sizeof(SNAPSHOT_MAGIC)) != 0)
+        throw std::invalid_argument("Not a routing table snapshot: " + path);
+
+    const uint16_t version = utils::loadBE16(data+4);
+    const uint16_t recordSize = utils::loadBE16(data+6);
+    if (version != VERSION || recordSize != SnapshotRecord::SIZE)
+        throw std::invalid_argument("Unsupported routing table snapshot version");
+
+    const uint32_t count = utils::loadBE32(data+8);
+    if (count > (_file.size()-HEADER_SIZE) / SnapshotRecord::SIZE)
+        throw std::invalid_argument("Truncated routing table snapshot: " + path);
+
+    _tableNode.readFrom(data+12);
+    _records = RecordView(utils::BufferView(
+        data+HEADER_SIZE,count*SnapshotRecord::SIZE));
+}
+
+void TableSnapshot::save(
+    const std::string& path,
+    const NodeData& tableNode,
+    const std::vector<NodeSPtr>& nodes )
+{
+    utils::Buffer buffer(HEADER_SIZE + nodes.size()*SnapshotRecord::SIZE);
+
+    uint32_t count = 0;
+    uint8_t* out = buffer.data()+HEADER_SIZE;
+    for( const NodeSPtr& node : nodes )
+    {
+        const auto& endpoint = node->getEndpoint();
+        if (!endpoint || !endpoint->address().is_v4())
+            continue;
+
+        SnapshotRecord::fromNode(*node).write(out);
+        out += SnapshotRecord::SIZE;
+        ++count;
+    }
+    buffer.resize(out-buffer.data());
+
+    memcpy(buffer.data(),SNAPSHOT_MAGIC,sizeof(SNAPSHOT_MAGIC));
+    utils::storeBE16(buffer.data()+4,VERSION);
+    utils::storeBE16(buffer.data()+6,SnapshotRecord::SIZE);
+    utils::storeBE32(buffer.data()+8,count);
+    tableNode.writeTo(buffer.data()+12);
+
+    // written aside and renamed over the old snapshot
+    const std::string temporary = path + ".tmp";
+    const int fd = open(temporary.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+    if (fd < 0)
+        throw std::system_error(errno,std::system_category(),"open " + temporary);
+
+    size_t written = 0;
+    while (written < buffer.size())
+    {
+        const ssize_t ret = ::write(fd,buffer.data()+written,buffer.size()-written);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+        {
+            const int error = errno;
+            close(fd);
+            unlink(temporary.c_str());
+            throw std::system_error(error,std::system_category(),"write " + temporary);
+        }
+        written += static_cast<size_t>(ret);
+    }
+
+    if (fsync(fd) != 0)
+    {
+        const int error = errno;
+        close(fd);
+        unlink(temporary.c_str());
+        throw std::system_error(error,std::system_category(),"sync " + temporary);
+    }
+
+    if (close(fd) != 0 || rename(temporary.c_str(),path.c_str()) != 0)
+    {
+        const int error = errno;
+        unlink(temporary.c_str());
+        throw std::system_error(error,std::system_category(),"save " + path);
+    }
+
+    LOG(DEBUG,"TableSnapshot * saved " << count << " nodes to " << path);
+}
+
+}; // dht
+}; // torrentsync
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <torrentsync/dht/Node.h>
+#include <torrentsync/dht/NodeData.h>
+#include <torrentsync/dht/message/CompactView.h>
+#include <torrentsync/utils/MappedFile.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace dht
+{
+
+//! A node of the routing table as saved in a TableSnapshot, all the fields
+//! in network order
+struct SnapshotRecord
+{
+    static const size_t SIZE = 40;
+
+    NodeData      id;         //!< 20 bytes
+    udp::endpoint endpoint;   //!< 6 bytes, compact IPv4 endpoint
+    uint16_t      rtt;        //!< milliseconds
+    uint16_t      failures;   //!< unanswered queries
+    // 2 reserved bytes
+    uint64_t      lastSeen;   //!< seconds since the epoch the node was good
+
+    //! decodes a record from SIZE bytes
+    static SnapshotRecord read( const uint8_t* data );
+
+    //! encodes the record on SIZE bytes
+    void write( uint8_t* out ) const;
+
+    //! the record of a node with an IPv4 endpoint
+    static SnapshotRecord fromNode( const Node& node );
+
+    //! @return a node with the statistics of the record
+    NodeSPtr toNode() const;
+};
+
+/** A binary snapshot of the routing table, to restart with the table of the
+ * previous run.
+ * A 32 bytes header, magic, version, record size, records count and the
+ * table node, followed by fixed size records. The file is mapped in
+ * memory and the records are decoded only while iterated.
+ */
+class TableSnapshot : public boost::noncopyable
+{
+public:
+    static const size_t   HEADER_SIZE = 32;
+    static const uint16_t VERSION     = 1;
+
+    typedef message::CompactView<SnapshotRecord> RecordView;
+
+    /** Opens a snapshot
+     * @param path the snapshot file
+     * @throws std::system_error if the file can't be read
+     * @throws std::invalid_argument if the file is not a snapshot, is
+     *         truncated or of an unsupported version
+     */
+    explicit TableSnapshot( const std::string& path );
+
+    /** Writes a snapshot. The file is replaced atomically, a crash while
+     * saving leaves the previous one.
+     * Nodes without an IPv4 endpoint are skipped.
+     * @param path the snapshot file
+     * @param tableNode the address of the table
+     * @param nodes the nodes of the table
+     * @throws std::system_error if the file can't be written
+     */
+    static void save(
+        const std::string& path,
+        const NodeData& tableNode,
+        const std::vector<NodeSPtr>& nodes );
+
+    //! @return the address of the table saved
+    const NodeData& getTableNode() const noexcept { return _tableNode; }
+
+    //! @return the saved nodes
+    const RecordView& getRecords() const noexcept { return _records; }
+
+private:
+    utils::MappedFile _file;
+
+    NodeData _tableNode;
+
+    RecordView _records;
+};
+
+}; // dht
+}; // torrentsync
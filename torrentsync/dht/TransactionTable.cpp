@@ -0,0 +1,194 @@
+#include <torrentsync/dht/TransactionTable.h>
+#include <torrentsync/utils/RandomGenerator.h>
+#include <torrentsync/utils/log/Logger.h>
+
+//! random IDs tried before looking for a free slot in order
+static const size_t RANDOM_TRIES = 8;
+
+namespace torrentsync
+{
+namespace dht
+{
+
+const size_t TransactionTable::SLOTS;
+const size_t TransactionTable::ID_SIZE;
+
+const utils::TimerWheel::duration TransactionTable::DEFAULT_DEADLINE =
+    std::chrono::seconds(5);
+
+TransactionTable::TransactionTable(
+    utils::TimerWheel& wheel,
+    const send_t& send ) :
+        _wheel(wheel),
+        _send(send),
+        _slots(SLOTS),
+        _size(0)
+{
+}
+
+TransactionTable::~TransactionTable()
+{
+    for( Slot& slot : _slots )
+    {
+        if (slot.open)
+            _wheel.cancel(slot.timer);
+    }
+}
+
+TransactionTable::id_t TransactionTable::next() noexcept
+{
+    // a few random tries, then the first free slot after the last try
+    utils::RandomGenerator& generator = utils::RandomGenerator::getInstance();
+    id_t id = 0;
+    for( size_t i = 0; i < RANDOM_TRIES; ++i )
+    {
+        id = static_cast<id_t>(generator.get());
+        if (!_slots[id].open)
+            return id;
+    }
+    for( size_t i = 0; i < SLOTS && _slots[id].open; ++i )
+    {
+        ++id;
+    }
+    return id;
+}
+
+void TransactionTable::open(
+    const id_t id,
+    const utils::Buffer& query,
+    const endpoint_t& destination,
+    const utils::SendQueue::class_t cls,
+    const callback_t& callback,
+    const boost::optional<NodeData>& source,
+    const utils::TimerWheel::duration& deadline )
+{
+    Slot& slot = _slots[id];
+    if (slot.open)
+    {
+        LOG(DEBUG,"TransactionTable * transaction " << id << " to " <<
+            slot.destination << " timed out by a new one");
+        ++_counters.timedOut;
+        const callback_t previous = release(slot);
+        previous(boost::optional<payload_type>());
+    }
+
+    slot.callback    = callback;
+    slot.query       = query;
+    slot.destination = destination;
+    slot.source      = source;
+    slot.deadline    = deadline;
+    slot.cls         = cls;
+    slot.open        = true;
+    slot.retried     = false;
+    ++_size;
+    ++_counters.opened;
+
+    schedule(id);
+    _send(query,destination,cls);
+}
+
+TransactionTable::callback_t TransactionTable::close(
+    const utils::BufferView& transactionID,
+    const endpoint_t& sender,
+    const NodeData& node )
+{
+    Slot* slot = find(transactionID,sender);
+    if (!slot)
+        return callback_t();
+
+    if (!!slot->source && *slot->source != node)
+        return callback_t();
+
+    _wheel.cancel(slot->timer);
+    ++_counters.answered;
+    return release(*slot);
+}
+
+TransactionTable::callback_t TransactionTable::fail(
+    const utils::BufferView& transactionID,
+    const endpoint_t& sender )
+{
+    Slot* slot = find(transactionID,sender);
+    if (!slot)
+        return callback_t();
+
+    _wheel.cancel(slot->timer);
+    ++_counters.failed;
+    return release(*slot);
+}
+
+TransactionTable::Slot* TransactionTable::find(
+    const utils::BufferView& transactionID,
+    const endpoint_t& sender ) noexcept
+{
+    const boost::optional<id_t> id = fromBuffer(transactionID);
+    if (!id)
+        return nullptr;
+
+    Slot& slot = _slots[*id];
+    if (!slot.open || slot.destination != sender)
+        return nullptr;
+
+    return &slot;
+}
+
+void TransactionTable::schedule( const id_t id )
+{
+    const uint32_t generation = _slots[id].generation;
+    _slots[id].timer = _wheel.schedule(_slots[id].deadline,
+        [this,id,generation]() { expire(id,generation); });
+}
+
+void TransactionTable::expire(
+    const id_t id,
+    const uint32_t generation )
+{
+    // the slot was closed, and maybe opened again, after the timer fired
+    Slot& slot = _slots[id];
+    if (!slot.open || slot.generation != generation)
+        return;
+
+    if (!slot.retried)
+    {
+        slot.retried = true;
+        ++_counters.retried;
+        schedule(id);
+        _send(slot.query,slot.destination,slot.cls);
+        return;
+    }
+
+    ++_counters.timedOut;
+    const callback_t callback = release(slot);
+    callback(boost::optional<payload_type>());
+}
+
+TransactionTable::callback_t TransactionTable::release( Slot& slot ) noexcept
+{
+    callback_t callback;
+    callback.swap(slot.callback);
+    utils::Buffer().swap(slot.query);
+    slot.open = false;
+    ++slot.generation;
+    --_size;
+    return callback;
+}
+
+utils::Buffer TransactionTable::toBuffer( const id_t id )
+{
+    utils::Buffer buff;
+    buff.reserve(ID_SIZE);
+    buff.push_back(id);
+    buff.push_back(id>>8);
+    return buff;
+}
+
+boost::optional<TransactionTable::id_t> TransactionTable::fromBuffer(
+    const utils::BufferView& buffer ) noexcept
+{
+    if (buffer.size() != ID_SIZE)
+        return boost::none;
+    return static_cast<id_t>(buffer[0] | (buffer[1] << 8));
+}
+
+}; // dht
+}; // torrentsync
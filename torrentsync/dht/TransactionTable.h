@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+#include <torrentsync/dht/Node.h>
+#include <torrentsync/dht/NodeData.h>
+#include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/BufferView.h>
+#include <torrentsync/utils/SendQueue.h>
+#include <torrentsync/utils/TimerWheel.h>
+
+namespace torrentsync
+{
+namespace dht
+{
+
+namespace message
+{
+class Message;
+}
+
+/** The queries waiting for a reply, by transaction ID.
+ * Every 16 bit transaction ID is a slot of a fixed array, so opening and
+ * closing a transaction are O(1) without allocations for the key. A query
+ * not answered before its deadline is sent once more, then the transaction
+ * times out: every open transaction ends once, with the reply, with an
+ * error or with the timeout.
+ * A generation counter of every slot makes the timers of an earlier use of
+ * the slot harmless; a reply is accepted only from the endpoint queried.
+ * The timers run on the wheel, not thread safe otherwise: the table must
+ * be used from the io_service the wheel ticks on.
+ */
+class TransactionTable : public boost::noncopyable
+{
+public:
+    typedef uint16_t id_t;
+    typedef boost::asio::ip::udp::endpoint endpoint_t;
+
+    //! the reply closing a transaction and the node sending it
+    struct payload_type
+    {
+        payload_type( const message::Message& m, Node& n ) : message(m), node(n) {}
+
+        const message::Message& message;
+        Node&                   node;
+    };
+
+    //! called with the reply, or without after the timeout
+    typedef std::function<void (
+        boost::optional<payload_type>)> callback_t;
+
+    //! sends a query, the first time and for the retry
+    typedef std::function<void (
+        const utils::Buffer&,
+        const endpoint_t&,
+        const utils::SendQueue::class_t)> send_t;
+
+    //! a slot for every transaction ID
+    static const size_t SLOTS = 1 << 16;
+
+    //! size of a transaction ID on the wire
+    static const size_t ID_SIZE = sizeof(id_t);
+
+    //! time to wait for a reply before sending the query again, and again
+    //! before the timeout
+    static const utils::TimerWheel::duration DEFAULT_DEADLINE;
+
+    struct Counters
+    {
+        //! transactions opened
+        size_t opened   = 0;
+
+        //! transactions closed by a reply
+        size_t answered = 0;
+
+        //! queries sent again after the first deadline
+        size_t retried  = 0;
+
+        //! transactions ended without a reply
+        size_t timedOut = 0;
+
+        //! transactions ended by an error
+        size_t failed   = 0;
+    };
+
+    /** Constructor
+     * @param wheel the timers of the deadlines
+     * @param send sends the queries
+     */
+    TransactionTable(
+        utils::TimerWheel& wheel,
+        const send_t& send );
+
+    //! cancels the timers, the transactions still open are dropped
+    ~TransactionTable();
+
+    //! @return a random transaction ID, not open unless every slot is. Not
+    //!         predictable, so a reply can't be forged without seeing the query.
+    id_t next() noexcept;
+
+    /** opens the transaction and sends the query
+     * A transaction still open with the same ID is timed out first.
+     * @param id the transaction ID of the query
+     * @param query the message to send
+     * @param destination where the query is sent, the only accepted sender
+     * @param cls the traffic class of the query
+     * @param callback called once, with the reply or at the timeout
+     * @param source the node expected to reply, if known
+     * @param deadline for every sending of the query
+     */
+    void open(
+        const id_t id,
+        const utils::Buffer& query,
+        const endpoint_t& destination,
+        const utils::SendQueue::class_t cls,
+        const callback_t& callback,
+        const boost::optional<NodeData>& source = boost::optional<NodeData>(),
+        const utils::TimerWheel::duration& deadline = DEFAULT_DEADLINE );
+
+    /** closes the transaction answered by a message
+     * @param transactionID of the message
+     * @param sender of the message
+     * @param node the ID of the sender
+     * @return the callback of the transaction, empty if none matches
+     */
+    callback_t close(
+        const utils::BufferView& transactionID,
+        const endpoint_t& sender,
+        const NodeData& node );
+
+    /** ends the transaction answered by an error
+     * An error has no node ID, only the sender is checked.
+     * @param transactionID of the error
+     * @param sender of the error
+     * @return the callback of the transaction, empty if none matches
+     */
+    callback_t fail(
+        const utils::BufferView& transactionID,
+        const endpoint_t& sender );
+
+    //! @return true if the transaction is waiting for a reply
+    bool isOpen( const id_t id ) const noexcept { return _slots[id].open; }
+
+    //! @return the open transactions
+    size_t size() const noexcept { return _size; }
+
+    const Counters& getCounters() const noexcept { return _counters; }
+
+    //! @return the transaction ID as sent on the wire
+    static utils::Buffer toBuffer( const id_t id );
+
+    //! @return the transaction ID of a message, none if it is not one of ours
+    static boost::optional<id_t> fromBuffer( const utils::BufferView& buffer ) noexcept;
+
+private:
+
+    struct Slot
+    {
+        callback_t                     callback;
+        utils::Buffer                  query;
+        endpoint_t                     destination;
+        boost::optional<NodeData>      source;
+        utils::TimerWheel::duration    deadline;
+        utils::TimerWheel::handle_t    timer      = 0;
+        uint32_t                       generation = 0;
+        utils::SendQueue::class_t      cls        = utils::SendQueue::REPLY;
+        bool                           open       = false;
+        bool                           retried    = false;
+    };
+
+    //! @return the open slot of the transaction ID queried to sender,
+    //!         nullptr if none
+    Slot* find(
+        const utils::BufferView& transactionID,
+        const endpoint_t& sender ) noexcept;
+
+    //! arms the deadline of the slot for its current generation
+    void schedule( const id_t id );
+
+    //! the deadline of the slot expired: retries or times out
+    void expire( const id_t id, const uint32_t generation );
+
+    //! frees the slot, invalidating its timers
+    //! @return the callback of the transaction
+    callback_t release( Slot& slot ) noexcept;
+
+    utils::TimerWheel& _wheel;
+
+    const send_t _send;
+
+    std::vector<Slot> _slots;
+
+    size_t _size;
+
+    Counters _counters;
+};
+
+}; // dht
+}; // torrentsync
@@ -2,6 +2,7 @@
 #include <cassert>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/array.hpp>
 
 #include <boost/iostreams/stream.hpp>
 #include <boost/iostreams/device/array.hpp>
@@ -162,6 +163,414 @@ std::string BEncodeDecoder::readElement( std::istream& stream )
     }
 }
 
+void BEncodeDecoder::parseMessage( const uint8_t* buffer, const size_t length )
+{
+    // indexes in views of the open structures and their elements count
+    boost::array<size_t,BENCODE_MAX_DEPTH> stack;
+    boost::array<size_t,BENCODE_MAX_DEPTH> counters;
+    size_t depth = 0;
+    size_t position = 0;
+    bool expectingKey = false;
+    utils::BufferView key;
+
+    views.clear();
+
+    if (length == 0 || (buffer[0] != 'd' && buffer[0] != 'l'))
+        throw BEncodeException("Malformed message - no structure found");
+
+    do
+    {
+        if (position >= length)
+            throw BEncodeException("Message could not be parsed correctly");
+
+        const uint8_t c = buffer[position];
+        const bool inDictionary = depth > 0 &&
+            views[stack[depth-1]].kind == ViewEntry::DICTIONARY;
+
+        if (c == 'e')
+        {
+            if (inDictionary && !expectingKey)
+                throw BEncodeException("Malformed message - key without value");
+
+            ++position;
+            ViewEntry& structure = views[stack[--depth]];
+            structure.value = utils::BufferView(
+                structure.value.data(),
+                (buffer+position) - structure.value.data());
+
+            expectingKey = depth > 0 &&
+                views[stack[depth-1]].kind == ViewEntry::DICTIONARY;
+            continue;
+        }
+
+        if (inDictionary && expectingKey)
+        {
+            key = readView(buffer,length,position);
+            expectingKey = false;
+            continue;
+        }
+
+        ViewEntry entry;
+        entry.key    = inDictionary ? key : utils::BufferView();
+        entry.parent = depth > 0 ? stack[depth-1] : ViewEntry::npos;
+        entry.index  = depth > 0 ? counters[depth-1]++ : 0;
+
+        switch (c)
+        {
+            case 'd':
+            case 'l':
+                if (depth >= BENCODE_MAX_DEPTH)
+                    throw BEncodeException("Malformed message - too many nested structures");
+                entry.kind  = c == 'd' ? ViewEntry::DICTIONARY : ViewEntry::LIST;
+                entry.value = utils::BufferView(buffer+position,0);
+                ++position;
+                stack[depth]    = views.size();
+                counters[depth] = 0;
+                ++depth;
+                expectingKey = c == 'd';
+                views.push_back(entry);
+                continue;
+
+            case 'i':
+                entry.kind  = ViewEntry::INTEGER;
+                entry.value = readInteger(buffer,length,position);
+                break;
+
+            default:
+                entry.kind  = ViewEntry::STRING;
+                entry.value = readView(buffer,length,position);
+                break;
+        }
+
+        views.push_back(entry);
+        expectingKey = inDictionary;
+    }
+    while (depth > 0);
+}
+
+utils::BufferView BEncodeDecoder::readView(
+    const uint8_t* buffer,
+    const size_t length,
+    size_t& position ) const
+{
+    size_t size = 0;
+    size_t digits = 0;
+
+    for ( ; position < length && isdigit(buffer[position]); ++position, ++digits )
+    {
+        // a longer length can't fit in any message we can hold
+        if (digits >= 9)
+            throw BEncodeException("Malformed message - string length too big");
+        size = size*10 + (buffer[position] - '0');
+    }
+
+    if (digits == 0 || position >= length || buffer[position] != ':')
+    {
+        std::stringstream msg;
+        msg << "Malformed message - expecting a string at position " << position;
+        throw BEncodeException(msg.str());
+    }
+    ++position;
+
+    if (size > length - position)
+        throw BEncodeException("Malformed message - string exceeds message length");
+
+    const utils::BufferView view(buffer+position,size);
+    position += size;
+    return view;
+}
+
+utils::BufferView BEncodeDecoder::readInteger(
+    const uint8_t* buffer,
+    const size_t length,
+    size_t& position ) const
+{
+    assert(buffer[position] == 'i');
+    const size_t begin = ++position;
+
+    if (position < length && buffer[position] == '-')
+        ++position;
+
+    const size_t digitsBegin = position;
+    while (position < length && isdigit(buffer[position]))
+        ++position;
+
+    if (position == digitsBegin || position >= length || buffer[position] != 'e')
+    {
+        std::stringstream msg;
+        msg << "Malformed message - expecting an integer at position " << begin;
+        throw BEncodeException(msg.str());
+    }
+
+    const utils::BufferView view(buffer+begin,position-begin);
+    ++position; // skip the 'e'
+    return view;
+}
+
+//! compares a parsed key with a string literal
+template <size_t N>
+static inline bool isKey( const utils::BufferView& key, const char (&literal)[N] )
+{
+    return key.size() == N-1 && std::equal(key.begin(),key.end(),literal);
+}
+
+//! derives the message kind from the "y" and "q" fields
+static KRPC::kind_t messageKind( const KRPC& message )
+{
+    if (!message.y || message.y->size() != 1)
+        return KRPC::UNKNOWN;
+
+    switch ((*message.y)[0])
+    {
+    case 'q':
+        if (!message.q)
+            return KRPC::UNKNOWN_QUERY;
+        else if (isKey(*message.q,"ping"))
+            return KRPC::PING_QUERY;
+        else if (isKey(*message.q,"find_node"))
+            return KRPC::FIND_NODE_QUERY;
+        return KRPC::UNKNOWN_QUERY;
+    case 'r':
+        return KRPC::REPLY;
+    case 'e':
+        return KRPC::ERROR;
+    default:
+        return KRPC::UNKNOWN;
+    }
+}
+
+void BEncodeDecoder::parseKRPC(
+    const uint8_t* buffer,
+    const size_t length,
+    KRPC& message ) const
+{
+    message = KRPC();
+
+    if (length == 0 || buffer[0] != 'd')
+        throw BEncodeException("Malformed message - KRPC messages must be dictionaries");
+
+    size_t position = 1;
+    while (true)
+    {
+        if (position >= length)
+            throw BEncodeException("Message could not be parsed correctly");
+
+        if (buffer[position] == 'e')
+            break;
+
+        const utils::BufferView key = readView(buffer,length,position);
+
+        if (isKey(key,"t"))
+        {
+            message.txid = readView(buffer,length,position);
+        }
+        else if (isKey(key,"y"))
+        {
+            message.y = readView(buffer,length,position);
+        }
+        else if (isKey(key,"q"))
+        {
+            message.q = readView(buffer,length,position);
+        }
+        else if (isKey(key,"a") || isKey(key,"r"))
+        {
+            parseKRPCBody(buffer,length,position,message);
+        }
+        else if (isKey(key,"e"))
+        {
+            const size_t begin = position;
+            skipElement(buffer,length,position);
+            message.error = utils::BufferView(buffer+begin,position-begin);
+        }
+        else if (isKey(key,"v"))
+        {
+            message.v = readView(buffer,length,position);
+        }
+        else
+        {
+            skipElement(buffer,length,position);
+        }
+    }
+
+    message.kind = messageKind(message);
+}
+
+void BEncodeDecoder::parseKRPCBody(
+    const uint8_t* buffer,
+    const size_t length,
+    size_t& position,
+    KRPC& message ) const
+{
+    if (position >= length || buffer[position] != 'd')
+        throw BEncodeException("Malformed message - arguments must be a dictionary");
+    ++position;
+
+    while (true)
+    {
+        if (position >= length)
+            throw BEncodeException("Message could not be parsed correctly");
+
+        if (buffer[position] == 'e')
+        {
+            ++position;
+            return;
+        }
+
+        const utils::BufferView key = readView(buffer,length,position);
+
+        if (isKey(key,"id"))
+        {
+            message.id = readView(buffer,length,position);
+        }
+        else if (isKey(key,"target"))
+        {
+            message.target = readView(buffer,length,position);
+        }
+        else if (isKey(key,"nodes"))
+        {
+            message.nodes = readView(buffer,length,position);
+        }
+        else if (isKey(key,"token"))
+        {
+            message.token = readView(buffer,length,position);
+        }
+        else if (isKey(key,"info_hash"))
+        {
+            message.info_hash = readView(buffer,length,position);
+        }
+        else if (isKey(key,"port") && position < length && buffer[position] == 'i')
+        {
+            const utils::BufferView digits = readInteger(buffer,length,position);
+            uint32_t port = 0;
+            for( auto it = digits.begin(); it != digits.end(); ++it )
+            {
+                if (!isdigit(*it) || (port = port*10 + (*it - '0')) > UINT16_MAX)
+                    throw BEncodeException("Malformed message - invalid port");
+            }
+            message.port = static_cast<uint16_t>(port);
+        }
+        else
+        {
+            skipElement(buffer,length,position);
+        }
+    }
+}
+
+void BEncodeDecoder::skipElement(
+    const uint8_t* buffer,
+    const size_t length,
+    size_t& position ) const
+{
+    size_t depth = 0;
+    do
+    {
+        if (position >= length)
+            throw BEncodeException("Message could not be parsed correctly");
+
+        switch (buffer[position])
+        {
+            case 'd':
+            case 'l':
+                if (++depth > BENCODE_MAX_DEPTH)
+                    throw BEncodeException("Malformed message - too many nested structures");
+                ++position;
+                break;
+            case 'e':
+                if (depth == 0)
+                    throw BEncodeException("Malformed message - end not in a structure");
+                --depth;
+                ++position;
+                break;
+            case 'i':
+                readInteger(buffer,length,position);
+                break;
+            default:
+                readView(buffer,length,position);
+                break;
+        }
+    }
+    while (depth > 0);
+}
+
+boost::optional<utils::BufferView> BEncodeDecoder::findView(
+    const std::string& key ) const
+{
+    boost::optional<utils::BufferView> ret;
+    for( auto it = views.cbegin(); it != views.cend(); ++it )
+    {
+        if (it->parent != ViewEntry::npos && matchPath(*it,key))
+        {
+            ret = it->value;
+            break;
+        }
+    }
+    return ret;
+}
+
+bool BEncodeDecoder::matchPath(
+    const ViewEntry& entry,
+    const std::string& key ) const
+{
+    assert(entry.parent != ViewEntry::npos);
+
+    // compare the path components from the last one to the first one
+    size_t end = key.size();
+    const ViewEntry* current = &entry;
+
+    while (true)
+    {
+        const ViewEntry& parent = views[current->parent];
+        const size_t separator = end == 0 ? std::string::npos : key.rfind('/',end-1);
+        const size_t begin = separator == std::string::npos ? 0 : separator+1;
+
+        if (parent.kind == ViewEntry::LIST)
+        {
+            if (begin == end)
+                return false;
+            size_t index = 0;
+            for( size_t i = begin; i < end; ++i )
+            {
+                if (!isdigit(key[i]))
+                    return false;
+                index = index*10 + (key[i] - '0');
+            }
+            if (index != current->index)
+                return false;
+        }
+        else if (current->key.size() != end-begin ||
+                 !std::equal(current->key.begin(),current->key.end(),key.begin()+begin))
+        {
+            return false;
+        }
+
+        // the whole key must be consumed when the root is reached
+        if (parent.parent == ViewEntry::npos)
+            return separator == std::string::npos;
+        if (separator == std::string::npos)
+            return false;
+
+        end = separator;
+        current = &parent;
+    }
+}
+
+std::string BEncodeDecoder::getPath( const ViewEntry& entry ) const
+{
+    if (entry.parent == ViewEntry::npos)
+        return std::string();
+
+    const ViewEntry& parent = views[entry.parent];
+    std::string path = getPath(parent);
+    if (!path.empty())
+        path += '/';
+
+    if (parent.kind == ViewEntry::LIST)
+        path += boost::lexical_cast<std::string>(entry.index);
+    else
+        path.append(entry.key.begin(),entry.key.end());
+    return path;
+}
+
 utils::Buffer BEncodeDecoder::readValue( std::istream& stream )
 {
     size_t length;
@@ -11,6 +11,8 @@
 #include <boost/optional.hpp>
 
 #include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/BufferView.h>
+#include <torrentsync/dht/message/KRPC.h>
 
 namespace torrentsync
 {
@@ -23,6 +25,41 @@ typedef std::unordered_map<std::string,torrentsync::utils::Buffer> DataMap;
 
 typedef std::runtime_error BEncodeException;
 
+//! Maximum nesting of structures accepted while parsing in place
+static const size_t BENCODE_MAX_DEPTH = 16;
+
+//! An element parsed in place by BEncodeDecoder.
+//! Strings and integers are leaves, dictionaries and lists are structures
+//! and their value spans the whole bencoded structure.
+struct ViewEntry
+{
+    typedef enum {
+        STRING = 0,
+        INTEGER,
+        DICTIONARY,
+        LIST
+    } kind_t;
+
+    //! marks an entry without parent (the root structure)
+    static const size_t npos = static_cast<size_t>(-1);
+
+    //! the dictionary key, empty for list elements and root
+    utils::BufferView key;
+
+    //! string content, integer digits or the raw structure data
+    utils::BufferView value;
+
+    //! position of the parent structure in the entries list
+    size_t parent;
+
+    //! position inside the parent list, meaningless for dictionaries
+    size_t index;
+
+    kind_t kind;
+};
+
+typedef std::vector<ViewEntry> ViewList;
+
 //! Decoder for a bencoded message
 class BEncodeDecoder
 {
@@ -38,11 +75,47 @@ public:
      */
     void parseMessage( std::istream &stream );
 
+    /*! Parse the message in place, without copying any data.
+     *  Parsed elements are available through getViews() and findView() and
+     *  reference the parsed memory, which must outlive them.
+     *  Reusing the decoder avoids any allocation once the entry list has
+     *  grown to fit the messages received.
+     *  @param data the beginning of the message
+     *  @param length the size of the message
+     *  @throws BEncodeException in case the message is malformed
+     */
+    void parseMessage( const uint8_t* data, const size_t length );
+
+    /*! Parse a KRPC message in place following the KRPC schema.
+     *  Only the known fields are stored, everything else is skipped.
+     *  The fields reference data, which must outlive message.
+     *  @param data the beginning of the message
+     *  @param length the size of the message
+     *  @param message the structure to fill
+     *  @throws BEncodeException in case the message is malformed
+     */
+    void parseKRPC(
+        const uint8_t* data,
+        const size_t length,
+        KRPC& message ) const;
+
     const DataMap& getData() const noexcept { return data; }
 
+    const ViewList& getViews() const noexcept { return views; }
+
     boost::optional<
         torrentsync::utils::Buffer> find( const std::string& key ) const;
 
+    /*! Looks for a leaf parsed in place.
+     *  @param key the path of the element, in the same format used by
+     *  the keys of getData() ("a/id", "q/0")
+     */
+    boost::optional<
+        torrentsync::utils::BufferView> findView( const std::string& key ) const;
+
+    //! returns the path of the entry in the same format of the getData() keys
+    std::string getPath( const ViewEntry& entry ) const;
+
 private:
     //! parse a single element from the stream
     std::string readElement( std::istream& stream );
@@ -56,9 +129,34 @@ private:
     //! Stack to use while parsing
     std::vector<structureStackE> structureStack;
 
+    //! parse a string at position, updates position after the string
+    utils::BufferView readView(
+        const uint8_t* data, const size_t length, size_t& position ) const;
+
+    //! parse an integer at position, updates position after the integer
+    utils::BufferView readInteger(
+        const uint8_t* data, const size_t length, size_t& position ) const;
+
+    //! skips a whole element at position, updates position after it
+    void skipElement(
+        const uint8_t* data, const size_t length, size_t& position ) const;
+
+    //! parse the "a" or "r" dictionary of a KRPC message
+    void parseKRPCBody(
+        const uint8_t* data, const size_t length, size_t& position,
+        KRPC& message ) const;
+
+    //! verifies if the entry path ends with the key
+    bool matchPath(
+        const ViewEntry& entry,
+        const std::string& key ) const;
+
     //! Container of all the parsed data
     DataMap data;
 
+    //! Elements parsed in place, in order of appearance
+    ViewList views;
+
     typedef enum {
         DICTIONARY = 0,
         LIST
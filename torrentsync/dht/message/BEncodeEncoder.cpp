@@ -1,7 +1,5 @@
 #include <torrentsync/dht/message/BEncodeEncoder.h>
 
-#include <boost/lexical_cast.hpp>
-
 #include <cassert>
 
 namespace torrentsync
@@ -11,6 +9,78 @@ namespace dht
 namespace message
 {
 
+//! initial size of the owned buffer, enough for most KRPC messages
+static const size_t ENCODER_INITIAL_SIZE = 256;
+
+BEncodeEncoder::BEncodeEncoder() :
+    used_bytes(0),
+    _output(nullptr),
+    _capacity(0),
+    _lastKeyOffset(0),
+    _lastKeyLength(0)
+{
+    result.reserve(ENCODER_INITIAL_SIZE);
+}
+
+BEncodeEncoder::BEncodeEncoder(
+    uint8_t* output,
+    const size_t capacity ) :
+        used_bytes(0),
+        _output(output),
+        _capacity(capacity),
+        _lastKeyOffset(0),
+        _lastKeyLength(0)
+{
+    assert(output || capacity == 0);
+}
+
+uint8_t* BEncodeEncoder::reserve( const size_t add )
+{
+    if (_output)
+    {
+        if (used_bytes+add > _capacity)
+            throw std::length_error("Encoded data exceeds the output buffer");
+        uint8_t* const ret = _output+used_bytes;
+        used_bytes += add;
+        return ret;
+    }
+
+    result.resize(used_bytes+add);
+    uint8_t* const ret = result.data()+used_bytes;
+    used_bytes += add;
+    return ret;
+}
+
+utils::Buffer BEncodeEncoder::value() const
+{
+    const uint8_t* const data = _output ? _output : result.data();
+    return utils::Buffer(data,data+used_bytes);
+}
+
+size_t BEncodeEncoder::elementSize( const size_t length )
+{
+    size_t digits = 1;
+    for( size_t v = length; v >= 10; v /= 10 )
+        ++digits;
+    return digits+1+length;
+}
+
+uint8_t* BEncodeEncoder::writeLength( uint8_t* out, const size_t length )
+{
+    const size_t digits = elementSize(length)-1-length;
+
+    size_t v = length;
+    for( size_t i = digits; i > 0; --i, v /= 10 )
+        out[i-1] = '0' + v % 10;
+    out[digits] = ':';
+    return out+digits+1;
+}
+
+void BEncodeEncoder::addLength( const size_t length )
+{
+    writeLength(reserve(elementSize(length)-length),length);
+}
+
 void BEncodeEncoder::addDictionaryElement(
     const std::string& k,
     const std::string& v )
@@ -21,26 +91,35 @@ void BEncodeEncoder::addDictionaryElement(
 
 void BEncodeEncoder::addDictionaryElement(
     const std::string& k,
-    const utils::Buffer& v )
+    const utils::BufferView& v )
 {
     addDictionaryElement(k.cbegin(),k.cend(),
         v.cbegin(),v.cend());
 }
 
 void BEncodeEncoder::addDictionaryElement(
-    const utils::Buffer& k,
-    const utils::Buffer& v )
+    const utils::BufferView& k,
+    const utils::BufferView& v )
 {
     addDictionaryElement(k.cbegin(),k.cend(),
         v.cbegin(),v.cend());
 }
 
+uint8_t* BEncodeEncoder::reserveDictionaryElement(
+    const std::string& k,
+    const size_t length )
+{
+    addKey(k.cbegin(),k.cend());
+    addLength(length);
+    return reserve(length);
+}
+
 void BEncodeEncoder::addElement( const std::string& s )
 {
     addElement(s.cbegin(),s.cend());
 }
 
-void BEncodeEncoder::addElement( const utils::Buffer& v )
+void BEncodeEncoder::addElement( const utils::BufferView& v )
 {
     addElement(v.cbegin(),v.cend());
 }
@@ -52,21 +131,29 @@ void BEncodeEncoder::addElement(
 {
     assert(begin != end);
 
-    auto length = std::distance(begin,end);
-    auto length_string = boost::lexical_cast<std::string>(length);
+    const size_t length = std::distance(begin,end);
+    addLength(length);
+    std::copy(begin,end,reserve(length));
+}
 
-    checkAndExpand(length_string.size()+1+1+length);
+template <class It>
+void BEncodeEncoder::addKey(
+    It begin,
+    const It end )
+{
+    const uint8_t* const output = _output ? _output : result.data();
+    const uint8_t* const lastKey = output+_lastKeyOffset;
 
-    std::copy(
-        length_string.begin(),
-        length_string.end(),
-        result.begin()+used_bytes);
+    // test key correctness with lexicographical_compare
+    if (_lastKeyLength > 0 &&
+        std::lexicographical_compare(begin,end,lastKey,lastKey+_lastKeyLength))
+        throw std::logic_error("Violating lexicographic order constraint in dictionary");
 
-    used_bytes += length_string.size();
-    result[used_bytes++] = ':';
-    std::copy(begin,end,
-        result.begin()+used_bytes);
-    used_bytes += length;
+    const size_t length = std::distance(begin,end);
+    addLength(length);
+    _lastKeyOffset = used_bytes;
+    _lastKeyLength = length;
+    std::copy(begin,end,reserve(length));
 }
 
 template <class It, class It2>
@@ -74,14 +161,8 @@ void BEncodeEncoder::addDictionaryElement(
     It  begin1, const It  end1,
     It2 begin2, const It2 end2 )
 {
-  // test key correctness with lexicographical_compare in an assert
-    if (!lastKey.empty() && std::lexicographical_compare(begin1,end1,lastKey.cbegin(),lastKey.cend()))
-        throw std::logic_error("Violating lexicographic order constraint in dictionary");
-
-    addElement(begin1,end1);
+    addKey(begin1,end1);
     addElement(begin2,end2);
-    
-    lastKey = utils::Buffer(begin1,end1);
 }
 
 } // torrentsync
@@ -8,6 +8,7 @@
 #include <stdexcept>
 
 #include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/BufferView.h>
 
 namespace torrentsync
 {
@@ -18,12 +19,25 @@ namespace message
 
 using namespace torrentsync;
 
-//! root is always a dictionary
+/** root is always a dictionary
+ * The encoder either owns a growing buffer, or writes into a memory region
+ * provided by the caller (a pooled send buffer, a stack array...) without
+ * any allocation. The static *Size methods compute the exact size of the
+ * encoded data so the region can be sized up front.
+ */
 class BEncodeEncoder
 {
     public:
 
-    BEncodeEncoder() : used_bytes(0), result(1024) {}
+    //! encodes into an internal buffer, value() returns the result
+    BEncodeEncoder();
+
+    //! encodes into the memory region [output,output+capacity)
+    //! @throws std::length_error when data doesn't fit in the region
+    BEncodeEncoder( uint8_t* output, const size_t capacity );
+
+    BEncodeEncoder( const BEncodeEncoder& ) = delete;
+    BEncodeEncoder& operator=( const BEncodeEncoder& ) = delete;
 
     void addElement(
         const std::string& v );
@@ -31,20 +45,29 @@ class BEncodeEncoder
     void addDictionaryElement(
         const std::string& k,
         const std::string& v );
-    
+
     void addElement(
-        const utils::Buffer& v );
+        const utils::BufferView& v );
 
     void addDictionaryElement(
-        const utils::Buffer& k,
-        const utils::Buffer& v );
+        const utils::BufferView& k,
+        const utils::BufferView& v );
 
     void addDictionaryElement(
         const std::string& k,
-        const utils::Buffer& v);
-        
+        const utils::BufferView& v);
+
+    /** adds a dictionary element leaving the value to be written by the caller
+     * @param k the key
+     * @param length the length of the value
+     * @return where the length bytes of the value must be written
+     */
+    uint8_t* reserveDictionaryElement(
+        const std::string& k,
+        const size_t length );
+
     template <class T>
-    void addList( const T begin, const T end )
+    void addList( T begin, const T end )
     {
         startList();
         while (begin != end)
@@ -55,12 +78,26 @@ class BEncodeEncoder
         endList();
     }
 
-    void startList() { checkAndExpand(1); result[used_bytes++] = 'l'; }
-    void endList() { checkAndExpand(1); result[used_bytes++] = 'e'; }
-    void startDictionary() { checkAndExpand(1); result[used_bytes++] = 'd'; }
-    void endDictionary() { lastKey.clear(); checkAndExpand(1); result[used_bytes++] = 'e'; }
+    void startList() { *reserve(1) = 'l'; }
+    void endList() { *reserve(1) = 'e'; }
+    void startDictionary() { *reserve(1) = 'd'; }
+    void endDictionary() { _lastKeyLength = 0; *reserve(1) = 'e'; }
 
-    utils::Buffer value() const { result.resize(used_bytes); return result; } // copy to a buffer and pass it back..
+    //! @return the number of bytes encoded so far
+    size_t size() const noexcept { return used_bytes; }
+
+    //! @return a copy of the encoded data
+    utils::Buffer value() const;
+
+    //! @return the size of an encoded string of length bytes
+    static size_t elementSize( const size_t length );
+
+    //! @return the size of the encoded string
+    static size_t elementSize( const std::string& v ) { return elementSize(v.size()); }
+
+    //! writes the length prefix of a string, "length:"
+    //! @return the position after the prefix
+    static uint8_t* writeLength( uint8_t* out, const size_t length );
 
 private:
 
@@ -72,23 +109,35 @@ private:
         It  begin1, const It  end1,
         It2 begin2, const It2 end2 );
 
+    //! writes the length prefix of a string
+    void addLength( const size_t length );
+
+    //! verifies the key respects the dictionary order and writes it
+    template <class It>
+    void addKey( It begin, const It end );
+
+    //! returns where add bytes can be written, growing the owned buffer
+    //! as necessary
+    //! @throws std::length_error if a caller provided region is full
+    uint8_t* reserve( const size_t add );
+
     size_t used_bytes;
-    
-    void checkAndExpand( const size_t add )
-    {
-        if( used_bytes+add > result.size() )
-        {
-            result.resize(((result.size()/1024)+1)*1024);
-        }
-    }
 
-    mutable utils::Buffer result;
+    //! owned buffer, unused when writing in a caller provided region
+    utils::Buffer result;
+
+    //! where the data is written
+    uint8_t* _output;
 
-    utils::Buffer lastKey;
+    //! size of the caller provided region
+    size_t _capacity;
+
+    //! last key written, kept as position in the output
+    size_t _lastKeyOffset;
+    size_t _lastKeyLength;
 };
 
 
 } // torrentsync
 } // dht
 } // message
-
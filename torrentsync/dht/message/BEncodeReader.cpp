@@ -0,0 +1,237 @@
+#include <torrentsync/dht/message/BEncodeReader.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <sstream>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+const size_t BEncodeReader::MAX_KEY_LENGTH = 1024;
+
+//! strings can't be longer than this, it's already way bigger than any
+//! metadata we'd accept
+static const uint64_t MAX_STRING_LENGTH = UINT32_MAX;
+
+BEncodeReader::BEncodeReader(
+    BEncodeHandler& handler,
+    const size_t maxDepth ) :
+        _handler(handler),
+        _maxDepth(maxDepth)
+{
+    _stack.reserve(maxDepth);
+    reset();
+}
+
+void BEncodeReader::reset()
+{
+    _state       = VALUE;
+    _offset      = 0;
+    _expectKey   = false;
+    _valueOffset = 0;
+    _isKey       = false;
+    _remaining   = 0;
+    _digits      = 0;
+    _negative    = false;
+    _integer     = 0;
+    _stack.clear();
+    _key.clear();
+}
+
+void BEncodeReader::error( const char* what, const size_t offset ) const
+{
+    std::stringstream msg;
+    msg << "Malformed document - " << what << " at offset " << offset;
+    throw BEncodeException(msg.str());
+}
+
+void BEncodeReader::valueDone()
+{
+    _state = VALUE;
+    if (_stack.empty())
+        _state = DONE;
+    else if (inDictionary())
+        _expectKey = true;
+}
+
+void BEncodeReader::stringDone()
+{
+    if (_isKey)
+    {
+        _handler.key(utils::BufferView(_key),_valueOffset);
+        _key.clear();
+        _expectKey = false;
+        _state = VALUE;
+    }
+    else
+    {
+        valueDone();
+    }
+}
+
+size_t BEncodeReader::feed( const uint8_t* data, const size_t length )
+{
+    size_t i = 0;
+    while (i < length && _state != DONE)
+    {
+        const uint8_t c = data[i];
+        const size_t position = _offset+i;
+
+        switch (_state)
+        {
+        case VALUE:
+            if (c == 'e')
+            {
+                if (_stack.empty())
+                    error("end not in a structure",position);
+                if (inDictionary() && !_expectKey)
+                    error("key without value",position);
+                _stack.pop_back();
+                _handler.end(position);
+                ++i;
+                valueDone();
+            }
+            else if (inDictionary() && _expectKey && !isdigit(c))
+            {
+                error("dictionary key is not a string",position);
+            }
+            else if (c == 'd' || c == 'l')
+            {
+                if (_stack.size() >= _maxDepth)
+                    error("too many nested structures",position);
+                _stack.push_back(c);
+                if (c == 'd')
+                    _handler.beginDictionary(position);
+                else
+                    _handler.beginList(position);
+                _expectKey = c == 'd';
+                ++i;
+            }
+            else if (c == 'i')
+            {
+                _state       = INTEGER;
+                _valueOffset = position;
+                _integer     = 0;
+                _digits      = 0;
+                _negative    = false;
+                ++i;
+            }
+            else if (isdigit(c))
+            {
+                _state       = LENGTH;
+                _valueOffset = position;
+                _isKey       = inDictionary() && _expectKey;
+                _remaining   = 0;
+                _digits      = 0;
+            }
+            else
+            {
+                error("unexpected character",position);
+            }
+            break;
+
+        case LENGTH:
+            if (isdigit(c))
+            {
+                _remaining = _remaining*10 + (c - '0');
+                if (_remaining > MAX_STRING_LENGTH)
+                    error("string too long",_valueOffset);
+                ++_digits;
+                ++i;
+            }
+            else if (c == ':' && _digits > 0)
+            {
+                if (_isKey && _remaining > MAX_KEY_LENGTH)
+                    error("dictionary key too long",_valueOffset);
+                _state = STRING;
+                ++i;
+                if (_remaining == 0)
+                {
+                    if (!_isKey)
+                        _handler.string(utils::BufferView(),position+1,0);
+                    stringDone();
+                }
+            }
+            else
+            {
+                error("expecting a string length",position);
+            }
+            break;
+
+        case STRING:
+        {
+            const size_t available = std::min(length-i,_remaining);
+            const utils::BufferView chunk(data+i,available);
+            _remaining -= available;
+            i += available;
+
+            if (_isKey)
+            {
+                // keys completely in the chunk are not copied
+                if (_remaining == 0 && _key.empty())
+                {
+                    _handler.key(chunk,_valueOffset);
+                    _expectKey = false;
+                    _state = VALUE;
+                }
+                else
+                {
+                    _key.insert(_key.end(),chunk.begin(),chunk.end());
+                    if (_remaining == 0)
+                        stringDone();
+                }
+            }
+            else
+            {
+                _handler.string(chunk,position,_remaining);
+                if (_remaining == 0)
+                    stringDone();
+            }
+            break;
+        }
+
+        case INTEGER:
+            if (c == '-' && _digits == 0 && !_negative)
+            {
+                _negative = true;
+                ++i;
+            }
+            else if (isdigit(c))
+            {
+                const uint64_t digit = c - '0';
+                if (_integer > (static_cast<uint64_t>(INT64_MAX) - digit) / 10)
+                    error("integer out of range",_valueOffset);
+                _integer = _integer*10 + digit;
+                ++_digits;
+                ++i;
+            }
+            else if (c == 'e' && _digits > 0)
+            {
+                const int64_t value = static_cast<int64_t>(_integer);
+                _handler.integer(_negative ? -value : value,_valueOffset);
+                ++i;
+                valueDone();
+            }
+            else
+            {
+                error("expecting an integer",position);
+            }
+            break;
+
+        case DONE:
+            break;
+        }
+    }
+
+    _offset += i;
+    return i;
+}
+
+} // message
+} // dht
+} // torrentsync
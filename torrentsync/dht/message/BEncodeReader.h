@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/BufferView.h>
+#include <torrentsync/dht/message/BEncodeDecoder.h>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+/** Receives the events generated by BEncodeReader.
+ * Every offset is the position in the whole document, counting the bytes
+ * of every chunk fed to the reader.
+ */
+class BEncodeHandler
+{
+public:
+    virtual ~BEncodeHandler() = default;
+
+    //! a dictionary starts, offset of its 'd'
+    virtual void beginDictionary( const size_t offset ) {}
+
+    //! a list starts, offset of its 'l'
+    virtual void beginList( const size_t offset ) {}
+
+    //! the current dictionary or list ends, offset of its 'e'.
+    //! The raw structure spans from its begin offset up to offset included.
+    virtual void end( const size_t offset ) {}
+
+    //! a dictionary key, always delivered whole
+    //! @param key the key, valid only during the call
+    //! @param offset the offset of the key length prefix
+    virtual void key( const utils::BufferView& key, const size_t offset ) {}
+
+    /** a string value or a part of it.
+     * Long strings are delivered in more calls as the data arrives.
+     * @param data the available part, valid only during the call
+     * @param offset offset of the first byte of data
+     * @param remaining bytes of the string still to be delivered, 0 on the
+     *        last call
+     */
+    virtual void string(
+        const utils::BufferView& data,
+        const size_t offset,
+        const size_t remaining ) {}
+
+    //! an integer value, offset of its 'i'
+    virtual void integer( const int64_t value, const size_t offset ) {}
+};
+
+/** Streaming bencode reader.
+ * Parses a bencoded document fed in chunks of any size and signals its
+ * structure to a BEncodeHandler. Nothing but the open structures and
+ * dictionary keys split between chunks is kept in memory, so documents of
+ * any size can be parsed with bounded memory.
+ */
+class BEncodeReader : public boost::noncopyable
+{
+public:
+    //! Maximum length of a dictionary key
+    static const size_t MAX_KEY_LENGTH;
+
+    //! Constructor
+    //! @param handler the receiver of the events
+    //! @param maxDepth maximum nesting of structures allowed
+    BEncodeReader(
+        BEncodeHandler& handler,
+        const size_t maxDepth = BENCODE_MAX_DEPTH );
+
+    /** Parses the next chunk of the document.
+     * @param data the chunk
+     * @param length the chunk size
+     * @return the number of bytes used, less than length only if the document
+     *         ended inside the chunk.
+     * @throws BEncodeException in case the document is malformed
+     */
+    size_t feed( const uint8_t* data, const size_t length );
+
+    //! @return true when the whole document has been parsed
+    bool finished() const noexcept { return _state == DONE; }
+
+    //! @return the number of bytes parsed so far
+    size_t offset() const noexcept { return _offset; }
+
+    //! @return the number of open structures
+    size_t depth() const noexcept { return _stack.size(); }
+
+    //! restarts the reader to parse a new document
+    void reset();
+
+private:
+
+    typedef enum {
+        VALUE = 0,
+        LENGTH,
+        STRING,
+        INTEGER,
+        DONE
+    } state_t;
+
+    //! called after a complete value has been parsed
+    void valueDone();
+
+    //! called after the last byte of a string or key
+    void stringDone();
+
+    inline bool inDictionary() const
+    {
+        return !_stack.empty() && _stack.back() == 'd';
+    }
+
+    void error( const char* what, const size_t offset ) const;
+
+    BEncodeHandler& _handler;
+
+    const size_t _maxDepth;
+
+    state_t _state;
+
+    //! bytes parsed in the previous chunks
+    size_t _offset;
+
+    //! open structures, 'd' or 'l'
+    std::vector<uint8_t> _stack;
+
+    //! in a dictionary, true if the next string is a key
+    bool _expectKey;
+
+    //! offset of the value being parsed
+    size_t _valueOffset;
+
+    //! the string being parsed is a dictionary key
+    bool _isKey;
+
+    //! string bytes still to parse
+    size_t _remaining;
+
+    //! key bytes received in previous chunks
+    utils::Buffer _key;
+
+    //! digits parsed for the current length or integer
+    size_t _digits;
+
+    bool _negative;
+
+    uint64_t _integer;
+};
+
+} // message
+} // dht
+} // torrentsync
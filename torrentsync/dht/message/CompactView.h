@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include <torrentsync/dht/Node.h>
+#include <torrentsync/dht/NodeData.h>
+#include <torrentsync/utils/BufferView.h>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+//! A record of compact node info, node ID and IPv4 endpoint (BEP 005)
+struct CompactNode
+{
+    static const size_t SIZE = PACKED_NODE_SIZE;
+
+    NodeData      id;
+    udp::endpoint endpoint;
+
+    //! decodes a record from SIZE bytes
+    static CompactNode read( const uint8_t* data )
+    {
+        CompactNode ret;
+        ret.id.readFrom(data);
+        ret.endpoint = Node::readEndpoint(data+NodeData::addressDataLength);
+        return ret;
+    }
+};
+
+/** Iterates the fixed size records of a compact string (e.g. "nodes")
+ * directly over the message bytes, decoding every record on the stack
+ * when dereferenced. A trailing incomplete record is ignored.
+ * The view references the data, which must outlive it.
+ * @tparam Record the decoded record, with a SIZE constant and a static
+ *         read(const uint8_t*) function
+ */
+template <class Record>
+class CompactView
+{
+public:
+    class const_iterator : public std::iterator<std::forward_iterator_tag,Record>
+    {
+    public:
+        const_iterator() : _position(nullptr) {}
+
+        explicit const_iterator( const uint8_t* position ) : _position(position) {}
+
+        Record operator*() const { return Record::read(_position); }
+
+        const_iterator& operator++() { _position += Record::SIZE; return *this; }
+
+        const_iterator operator++(int)
+        {
+            const_iterator ret(*this);
+            ++(*this);
+            return ret;
+        }
+
+        bool operator==( const const_iterator& it ) const { return _position == it._position; }
+        bool operator!=( const const_iterator& it ) const { return _position != it._position; }
+
+        //! @return the raw bytes of the record
+        utils::BufferView raw() const { return utils::BufferView(_position,Record::SIZE); }
+
+    private:
+        const uint8_t* _position;
+    };
+
+    CompactView() = default;
+
+    explicit CompactView( const utils::BufferView& data ) : _data(data) {}
+
+    const_iterator begin() const { return const_iterator(_data.data()); }
+    const_iterator end()   const { return const_iterator(_data.data()+size()*Record::SIZE); }
+
+    //! @return the number of complete records
+    size_t size() const noexcept { return _data.size() / Record::SIZE; }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    //! @return the record at index, must be less than size()
+    Record operator[]( const size_t index ) const
+    {
+        return Record::read(_data.data()+index*Record::SIZE);
+    }
+
+private:
+    utils::BufferView _data;
+};
+
+typedef CompactView<CompactNode> CompactNodeView;
+
+} /* message */
+} /* dht */
+} /* torrentsync */
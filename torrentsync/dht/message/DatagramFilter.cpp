@@ -0,0 +1,109 @@
+#include <torrentsync/dht/message/DatagramFilter.h>
+
+#include <cassert>
+#include <cstring>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+//! the smallest message with a type, "d1:y1:re"
+static const size_t MIN_KRPC_SIZE = 8;
+
+//! digits allowed in the length prefix of the first key
+static const size_t MAX_KEY_DIGITS = 3;
+
+//! the message type key with the value length, followed by the type
+static const char TYPE_KEY[] = "1:y1:";
+
+DatagramFilter::DatagramFilter()
+{
+    for( auto& counter : _counters )
+        counter.store(0,std::memory_order_relaxed);
+}
+
+DatagramFilter::reason_t DatagramFilter::verify(
+    const uint8_t* data,
+    const size_t length ) noexcept
+{
+    if (length == 0)
+        return EMPTY;
+    if (length < MIN_KRPC_SIZE)
+        return TOO_SHORT;
+    if (data[0] != 'd' || data[length-1] != 'e')
+        return NOT_DICTIONARY;
+
+    // the first key length must be followed by ':' and fit in the datagram
+    size_t keyLength = 0;
+    size_t position  = 1;
+    while (position < length && position <= MAX_KEY_DIGITS &&
+           data[position] >= '0' && data[position] <= '9')
+    {
+        keyLength = keyLength*10 + (data[position] - '0');
+        ++position;
+    }
+    if (position == 1 || position >= length || data[position] != ':' ||
+        keyLength == 0 || keyLength > length-position-1)
+        return BAD_LENGTH;
+
+    // look for the type key, "1:y1:" and the type must fit before the
+    // final 'e'
+    const size_t keySize = sizeof(TYPE_KEY)-1;
+    const uint8_t* const end = data+length-1;
+    for( const uint8_t* it = data+1; it+keySize < end; ++it )
+    {
+        it = static_cast<const uint8_t*>(memchr(it,'1',end-keySize-it));
+        if (!it)
+            break;
+        if (memcmp(it,TYPE_KEY,keySize) == 0)
+        {
+            const uint8_t type = it[keySize];
+            if (type == 'q' || type == 'r' || type == 'e')
+                return ACCEPTED;
+        }
+    }
+    return MISSING_TYPE;
+}
+
+DatagramFilter::reason_t DatagramFilter::check(
+    const uint8_t* data,
+    const size_t length ) noexcept
+{
+    const reason_t reason = verify(data,length);
+    count(reason);
+    return reason;
+}
+
+void DatagramFilter::count( const reason_t reason ) noexcept
+{
+    assert(reason < REASON_COUNT);
+    _counters[reason].fetch_add(1,std::memory_order_relaxed);
+}
+
+uint64_t DatagramFilter::getCount( const reason_t reason ) const noexcept
+{
+    assert(reason < REASON_COUNT);
+    return _counters[reason].load(std::memory_order_relaxed);
+}
+
+const char* DatagramFilter::reasonToString( const reason_t reason ) noexcept
+{
+    switch (reason)
+    {
+    case ACCEPTED:       return "accepted";
+    case EMPTY:          return "empty";
+    case TOO_SHORT:      return "too short";
+    case NOT_DICTIONARY: return "not a dictionary";
+    case BAD_LENGTH:     return "bad length prefix";
+    case MISSING_TYPE:   return "missing message type";
+    case MALFORMED:      return "malformed";
+    default:             return "unknown";
+    }
+}
+
+} /* message */
+} /* dht */
+} /* torrentsync */
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+/** Cheap checks on received datagrams before the KRPC parsing.
+ * Rejects with a few byte comparisons the traffic that can't be a KRPC
+ * message (scans, uTP, tracker packets...) so it doesn't go through the
+ * parser and its exceptions. Passing the filter doesn't mean the message
+ * is valid. Keeps a counter for every outcome, updated atomically so it
+ * can be shared by more receiving threads.
+ */
+class DatagramFilter : public boost::noncopyable
+{
+public:
+    typedef enum
+    {
+        ACCEPTED = 0,
+        EMPTY,           //!< no data
+        TOO_SHORT,       //!< shorter than the smallest KRPC message
+        NOT_DICTIONARY,  //!< not starting with 'd' or not ending with 'e'
+        BAD_LENGTH,      //!< the first key has no valid length prefix
+        MISSING_TYPE,    //!< no "y" key with a valid message type
+        MALFORMED,       //!< accepted but failed the full parsing
+        REASON_COUNT
+    } reason_t;
+
+    DatagramFilter();
+
+    /** verifies the datagram and counts the result
+     * @param data the datagram
+     * @param length size of the datagram
+     * @return ACCEPTED or the reason to drop the datagram
+     */
+    reason_t check( const uint8_t* data, const size_t length ) noexcept;
+
+    //! counts a datagram dropped after the filter, e.g. MALFORMED
+    void count( const reason_t reason ) noexcept;
+
+    //! @return the number of datagrams with the outcome
+    uint64_t getCount( const reason_t reason ) const noexcept;
+
+    //! @return the description of the outcome
+    static const char* reasonToString( const reason_t reason ) noexcept;
+
+private:
+
+    //! the checks, without counting
+    static reason_t verify( const uint8_t* data, const size_t length ) noexcept;
+
+    std::array<std::atomic<uint64_t>,REASON_COUNT> _counters;
+};
+
+} /* message */
+} /* dht */
+} /* torrentsync */
@@ -0,0 +1,39 @@
+#include <torrentsync/dht/message/KRPC.h>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+static void rebaseField(
+    KRPC::field_t& field,
+    const uint8_t* from,
+    const uint8_t* to )
+{
+    if (!!field)
+    {
+        field = utils::BufferView(
+            to + (field->data() - from),
+            field->size());
+    }
+}
+
+void KRPC::rebase( const uint8_t* from, const uint8_t* to )
+{
+    rebaseField(txid,from,to);
+    rebaseField(y,from,to);
+    rebaseField(q,from,to);
+    rebaseField(v,from,to);
+    rebaseField(id,from,to);
+    rebaseField(target,from,to);
+    rebaseField(nodes,from,to);
+    rebaseField(token,from,to);
+    rebaseField(info_hash,from,to);
+    rebaseField(error,from,to);
+}
+
+} // message
+} // dht
+} // torrentsync
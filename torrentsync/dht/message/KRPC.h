@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+#include <boost/optional.hpp>
+
+#include <torrentsync/utils/BufferView.h>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+/** Typed representation of a KRPC message (BEP 005).
+ * Every field references the memory the message was parsed from, which must
+ * outlive the structure. Keys not part of the schema are skipped while
+ * parsing, see BEncodeDecoder::parseKRPC.
+ */
+struct KRPC
+{
+    typedef boost::optional<utils::BufferView> field_t;
+
+    //! Kind of message, derived from the "y" and "q" fields while parsing
+    typedef enum
+    {
+        UNKNOWN = 0,     //!< missing or unsupported message type
+        PING_QUERY,
+        FIND_NODE_QUERY,
+        UNKNOWN_QUERY,   //!< a query not implemented, or without name
+        REPLY,
+        ERROR,
+        KIND_COUNT
+    } kind_t;
+
+    //! the kind of the message
+    kind_t kind = UNKNOWN;
+
+    //! "t" transaction ID
+    field_t txid;
+
+    //! "y" message type, a member of the Type namespace
+    field_t y;
+
+    //! "q" query name, a member of the Messages namespace
+    field_t q;
+
+    //! "v" client version
+    field_t v;
+
+    //! "a/id" or "r/id" the sender node ID
+    field_t id;
+
+    //! "a/target" find_node target
+    field_t target;
+
+    //! "r/nodes" compact node info
+    field_t nodes;
+
+    //! "a/token" or "r/token" announce token
+    field_t token;
+
+    //! "a/info_hash" get_peers and announce_peer infohash
+    field_t info_hash;
+
+    //! "a/port" announce_peer port
+    boost::optional<uint16_t> port;
+
+    //! "e" the whole bencoded error list
+    field_t error;
+
+    //! moves every field from the memory starting at from to the memory
+    //! starting at to. Used when the parsed data is copied.
+    void rebase( const uint8_t* from, const uint8_t* to );
+};
+
+} // message
+} // dht
+} // torrentsync
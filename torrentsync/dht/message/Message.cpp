@@ -2,9 +2,6 @@
 #include <torrentsync/dht/message/query/Ping.h>
 #include <torrentsync/dht/message/query/FindNode.h>
 
-#include <boost/iostreams/stream.hpp>
-#include <boost/iostreams/device/array.hpp>
-
 #include <map>
 
 namespace torrentsync
@@ -41,13 +38,29 @@ namespace Messages
     const std::string FindNode = "find_node";
 };
 
-namespace bio = boost::iostreams;
+//! constructor
+Message::Message(
+    const utils::BufferView& bytes,
+    const KRPC& krpc ) : _bytes(bytes), _krpc(krpc)
+{
+}
 
-typedef bio::stream<bio::array_source> array_stream;
+Message::Message( const Message& m ) :
+    _raw(m._bytes.begin(),m._bytes.end()), _bytes(_raw), _krpc(m._krpc)
+{
+    _krpc.rebase(m._bytes.data(),_raw.data());
+}
 
-//! constructor
-Message::Message(const DataMap& data) : _data(data)
+Message& Message::operator=( const Message& m )
 {
+    if (this != &m)
+    {
+        _raw.assign(m._bytes.begin(),m._bytes.end());
+        _bytes = utils::BufferView(_raw);
+        _krpc  = m._krpc;
+        _krpc.rebase(m._bytes.data(),_raw.data());
+    }
+    return *this;
 }
 
 std::shared_ptr<Message> Message::parseMessage( const utils::Buffer& buffer )
@@ -59,17 +72,65 @@ std::shared_ptr<Message> Message::parseMessage(
     const utils::Buffer& buffer,
     const size_t length )
 {
-    bio::array_source source(reinterpret_cast<const char*>(buffer.data()),length);
-    bio::stream<bio::array_source> in(source);
-    return parseMessage(in);
+    assert(length <= buffer.size());
+    utils::Buffer raw(buffer.cbegin(),buffer.cbegin()+length);
+
+    // moving the buffer keeps the data, and the fields, in place
+    std::shared_ptr<Message> message = buildMessage(utils::BufferView(raw),nullptr);
+    message->_raw = std::move(raw);
+    return message;
 }
 
 std::shared_ptr<Message> Message::parseMessage( std::istream& istream )
 {
-    BEncodeDecoder decoder;
+    utils::Buffer raw(
+        (std::istreambuf_iterator<char>(istream)),
+        std::istreambuf_iterator<char>());
+    return parseMessage(raw);
+}
+
+std::shared_ptr<Message> Message::parseMessage(
+    const uint8_t* data,
+    const size_t size,
+    utils::Arena& arena )
+{
+    return buildMessage(utils::BufferView(data,size),&arena);
+}
+
+namespace
+{
+//! destroys a message allocated from an arena, the memory stays there
+struct ArenaDelete
+{
+    template <class T>
+    void operator()( T* p ) const { p->~T(); }
+};
+}
+
+template <class T>
+std::shared_ptr<Message> Message::create(
+    const utils::BufferView& bytes,
+    const KRPC& krpc,
+    utils::Arena* arena )
+{
+    if (!arena)
+        return std::shared_ptr<Message>(new T(bytes,krpc));
+
+    void* memory = arena->allocate(sizeof(T),alignof(T));
+    return std::shared_ptr<Message>(
+        new (memory) T(bytes,krpc),
+        ArenaDelete(),
+        utils::ArenaAllocator<T>(*arena));
+}
+
+std::shared_ptr<Message> Message::buildMessage(
+    const utils::BufferView& bytes,
+    utils::Arena* arena )
+{
+    KRPC krpc;
     try
     {
-        decoder.parseMessage(istream);
+        BEncodeDecoder().parseKRPC(bytes.data(),bytes.size(),krpc);
     }
     catch( const BEncodeException& e )
     {
@@ -77,109 +138,82 @@ std::shared_ptr<Message> Message::parseMessage( std::istream& istream )
         ss << "Couldn't parse message: " << e.what();
         throw MalformedMessageException(ss.str());
     }
-    
-    auto type = find( Field::Type, decoder.getData() );
-    if (!type)
-        throw MalformedMessageException("Couldn't find message type");
 
-    std::shared_ptr<Message> message;
-    if (*type == Type::Query)
-    {
-        auto msgType = find(Field::Query, decoder.getData() );
-        if (!msgType)
-            throw MalformedMessageException("Couldn't find message name");
-        
-        if( *msgType == Messages::Ping)
-        {
-            message.reset(new query::Ping(decoder.getData()));
-        }
-        else if ( *msgType == Messages::FindNode )
-        {
-            message.reset(new query::FindNode(decoder.getData()));
-        }
-        else
-        {
-            throw MalformedMessageException("Unknown message name");
-        }
-    }
-    else if (*type == Type::Reply)
+    switch (krpc.kind)
     {
+    case KRPC::PING_QUERY:
+        return create<query::Ping>(bytes,krpc,arena);
+    case KRPC::FIND_NODE_QUERY:
+        return create<query::FindNode>(bytes,krpc,arena);
+    case KRPC::UNKNOWN_QUERY:
+        require(krpc.q,"Couldn't find message name");
+        throw MalformedMessageException("Unknown message name");
+    case KRPC::REPLY:
+    case KRPC::ERROR:
         //@TODO use validators to verify the message or 
         // create classes for the replies.
-        message.reset(new Message(decoder.getData()));
-    }
-    else
-    {
-        assert(*type == Type::Error);
         //! @TODO error message parsing
+        return create<Message>(bytes,krpc,arena);
+    default:
+        require(krpc.y,"Couldn't find message type");
+        throw MalformedMessageException("Unknown message type");
     }
-    return message;
 }
 
-const utils::Buffer Message::getType() const
+utils::BufferView Message::getType() const
 {
-    auto type = find( Field::Type );
-    if (!type)
-        throw MalformedMessageException("Couldn't find message type");
-    return *type;
+    return require(_krpc.y,"Couldn't find message type");
 }
 
-const utils::Buffer Message::getTransactionID() const
+utils::BufferView Message::getTransactionID() const
 {
-    auto token = find( Field::TransactionID);
-    if (!token)
-        throw MalformedMessageException("Couldn't find token");
-    return *token;
+    return require(_krpc.txid,"Couldn't find token");
 }
 
-const utils::Buffer Message::getID() const
+utils::BufferView Message::getID() const
 {
-    const std::string path =
-        (getType() == Type::Reply ? Field::Reply : Field::Arguments) 
-            + "/" + Field::PeerID;
-    auto id = find(path);
-    if (!id)
-        throw MalformedMessageException("Couldn't find peer id");
-    return *id;
+    return require(_krpc.id,"Couldn't find peer id");
 }
 
-const boost::optional<utils::Buffer> Message::find(
-    const std::string& key) const
+utils::BufferView Message::require(
+    const KRPC::field_t& field,
+    const char* message )
 {
-    return find(key,_data);
+    if (!field)
+        throw MalformedMessageException(message);
+    return *field;
 }
 
 const std::string Message::string() const
 {
     std::stringstream message;
-    std::for_each( _data.begin(), _data.end(), [&](
-        const DataMap::value_type& t)
+    auto print = [&]( const char* name, const KRPC::field_t& field )
     {
-        message << t.first << ":" << pretty_print(t.second) << std::endl;
-    });
+        if (!!field)
+            message << name << ":" << pretty_print(field->data(),field->size()) << std::endl;
+    };
+    print("t",_krpc.txid);
+    print("y",_krpc.y);
+    print("q",_krpc.q);
+    print("v",_krpc.v);
+    print("id",_krpc.id);
+    print("target",_krpc.target);
+    print("nodes",_krpc.nodes);
+    print("token",_krpc.token);
+    print("info_hash",_krpc.info_hash);
+    if (!!_krpc.port)
+        message << "port:" << *_krpc.port << std::endl;
+    print("e",_krpc.error);
     return message.str();
 }
 
-const boost::optional<utils::Buffer> Message::find(
-    const std::string& key,
-    const DataMap& data)
+std::ostream& operator<<(
+    std::ostream& stream,
+    const Message& message)
 {
-    boost::optional<utils::Buffer> ret;
-    DataMap::const_iterator it = data.find(key); 
-    if ( it != data.end() )
-    {
-        ret = it->second;
-    }
-    return ret;
+    return stream << message.string();
 }
 
 } /* message */
 } /* dht */
 } /* torrentsync */
-
-std::ostream& operator<<(
-    std::ostream& stream,
-    const torrentsync::dht::message::Message& message)
-{
-    return stream << message.string();
-}
@@ -5,6 +5,7 @@
 #include <memory>
 #include <torrentsync/dht/message/BEncodeDecoder.h>
 #include <torrentsync/dht/NodeData.h>
+#include <torrentsync/utils/Arena.h>
 
 namespace torrentsync
 {
@@ -58,7 +59,7 @@ public:
 
     Message( Message&& ) = default;
     
-    Message( const Message& ) = default;
+    Message( const Message& );
     
     /*! Parse a generic message and returns an instance of it.
      * This method must be used to parse messages.
@@ -74,27 +75,45 @@ public:
     static std::shared_ptr<Message> parseMessage(
         const utils::Buffer& buffer,
         const size_t size );
+
+    /*! Parses a message in place, without copying the data.
+     * The message and its control block are allocated from the arena.
+     * The message references data, which must outlive it, and must not be
+     * used after the arena is reset. Copying the message makes it
+     * independent from data.
+     * @param data the bencoded message
+     * @param size size of data
+     * @param arena the memory for the message
+     * @return a shared pointer with the message
+     * @throw MalformedMessageException in case the message is not valid
+     */
+    static std::shared_ptr<Message> parseMessage(
+        const uint8_t* data,
+        const size_t size,
+        utils::Arena& arena );
         
     //! returns the type of the message
     //! @return a member of Type namespace
     //! @throw MalformedMessageException in case the field is not available.
-    const utils::Buffer getType() const;
+    utils::BufferView getType() const;
  
     //! Returns a buffer containing the transaction ID of the message.
     //! Must be reimplemented in every subclass
     //! @return transaction id
-    const utils::Buffer getTransactionID() const;
+    utils::BufferView getTransactionID() const;
 
     //! returns the node address of the remote node. Must be implemented
     //! by every subclass
     //! @return a NodeData instance
     //! @throw MalformedMessageException in case the data is not available or
     //! the message is an error (it's mandatory otherwise).
-    const utils::Buffer getID() const;
+    utils::BufferView getID() const;
+
+    //! @return the kind of message, the instance is of the matching class
+    KRPC::kind_t getKind() const noexcept { return _krpc.kind; }
 
-    //! returns an optional buffer from the data map if found.
-    const boost::optional<utils::Buffer> find(
-        const std::string& key) const;
+    //! returns the parsed KRPC fields, valid as long as the message is
+    const KRPC& getFields() const noexcept { return _krpc; }
     
     //! converts the message to a human readable representation
     const std::string string() const;
@@ -102,24 +121,54 @@ public:
     //! move assignment
     Message& operator=( Message&& ) = default;
 
+    //! copy assignment
+    Message& operator=( const Message& );
+
 protected:
     //! Default constructor
     Message() = default;
 
-    //! Constructor 
-    Message(const DataMap& data);
-
-    //! Map containing all the data for the message
-    DataMap _data;
-
-    //! returns an optional buffer from the data map if found.
-    static const boost::optional<utils::Buffer> find(
-        const std::string& key,
-        const DataMap& data);
+    //! Constructor
+    //! @param bytes the bencoded message, not copied
+    //! @param krpc the fields parsed from bytes
+    Message(
+        const utils::BufferView& bytes,
+        const KRPC& krpc );
+
+    //! the bencoded message when owned by the instance
+    utils::Buffer _raw;
+
+    //! the bencoded message, in _raw or borrowed. The fields reference it
+    utils::BufferView _bytes;
+
+    //! fields of the message
+    KRPC _krpc;
+
+    //! creates the message instance matching the parsed data
+    //! @throw MalformedMessageException in case the message is not valid
+    //! @param bytes the bencoded message, referenced by the instance
+    //! @param arena where to allocate the message, if any
+    static std::shared_ptr<Message> buildMessage(
+        const utils::BufferView& bytes,
+        utils::Arena* arena );
+
+    //! allocates a message of class T from the arena, or from the heap
+    template <class T>
+    static std::shared_ptr<Message> create(
+        const utils::BufferView& bytes,
+        const KRPC& krpc,
+        utils::Arena* arena );
+
+    //! returns the field value
+    //! @throw MalformedMessageException with the message in case the field is
+    //!        not set
+    static utils::BufferView require(
+        const KRPC::field_t& field,
+        const char* message );
 };
 
+std::ostream& operator<<( std::ostream&, const Message& );
+
 } /* message */
 } /* dht */
 } /* torrentsync */
-
-std::ostream& operator<<( std::ostream&, const torrentsync::dht::message::Message& );
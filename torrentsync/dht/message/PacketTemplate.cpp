@@ -0,0 +1,49 @@
+#include <torrentsync/dht/message/PacketTemplate.h>
+#include <torrentsync/dht/message/BEncodeEncoder.h>
+#include <torrentsync/dht/NodeData.h>
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace torrentsync
+{
+namespace dht
+{
+namespace message
+{
+
+size_t PacketTemplate::size( const utils::BufferView& transactionID ) const
+{
+    return _headSize + BEncodeEncoder::elementSize(transactionID.size()) + _tailSize;
+}
+
+size_t PacketTemplate::write(
+    uint8_t* output,
+    const size_t capacity,
+    const utils::BufferView& transactionID,
+    const NodeData& id,
+    const NodeData* target ) const
+{
+    assert((_targetOffset == npos) == (target == nullptr));
+    assert(!transactionID.empty());
+
+    const size_t total = size(transactionID);
+    if (total > capacity)
+        throw std::length_error("Encoded data exceeds the output buffer");
+
+    memcpy(output,_head,_headSize);
+    id.writeTo(output+_idOffset);
+    if (target)
+        target->writeTo(output+_targetOffset);
+
+    uint8_t* out = BEncodeEncoder::writeLength(output+_headSize,transactionID.size());
+    memcpy(out,transactionID.data(),transactionID.size());
+    memcpy(out+transactionID.size(),_tail,_tailSize);
+
+    return total;
+}
+
+} /* message */
+} /* dht */
+} /* torrentsync */
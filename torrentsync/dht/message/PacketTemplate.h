@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include <torrentsync/utils/BufferView.h>
+
+namespace torrentsync
+{
+namespace dht
+{
+
+class NodeData;
+
+namespace message
+{
+
+//! 20 bytes placeholder for a node ID in a PacketTemplate
+#define PACKET_TEMPLATE_NODE_ID "00000000000000000000"
+
+/** Pre-encoded KRPC message with a fixed shape.
+ * The transaction ID is the only field of variable length and, sorting
+ * between the arguments and the message type, splits the message in a
+ * constant head and tail. Building a message copies the head, patches the
+ * node IDs at their known offsets and appends the transaction ID and the
+ * tail.
+ */
+class PacketTemplate
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    /** Constructor
+     * @param head the message up to the transaction ID key included
+     * @param tail the message after the transaction ID
+     * @param idOffset position of our node ID in head
+     * @param targetOffset position of the target ID in head, if any
+     */
+    template <size_t HEAD, size_t TAIL>
+    constexpr PacketTemplate(
+        const char (&head)[HEAD],
+        const char (&tail)[TAIL],
+        const size_t idOffset,
+        const size_t targetOffset = npos ) :
+            _head(head), _headSize(HEAD-1),
+            _tail(tail), _tailSize(TAIL-1),
+            _idOffset(idOffset), _targetOffset(targetOffset)
+    {}
+
+    //! @return the size of the message with the transaction ID
+    size_t size( const utils::BufferView& transactionID ) const;
+
+    /** writes the message
+     * @param output where the message is written
+     * @param capacity size of output
+     * @param transactionID the ID
+     * @param id our node ID
+     * @param target the target ID, only if the template has one
+     * @return the size of the message
+     * @throws std::length_error if output is too small
+     */
+    size_t write(
+        uint8_t* output,
+        const size_t capacity,
+        const utils::BufferView& transactionID,
+        const NodeData& id,
+        const NodeData* target = nullptr ) const;
+
+private:
+    const char*  _head;
+    const size_t _headSize;
+    const char*  _tail;
+    const size_t _tailSize;
+    const size_t _idOffset;
+    const size_t _targetOffset;
+};
+
+} /* message */
+} /* dht */
+} /* torrentsync */
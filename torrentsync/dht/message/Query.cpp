@@ -8,17 +8,15 @@ namespace message
 {
 
 //! constructor
-Query::Query(const DataMap& data) : Message(data)
+Query::Query(
+    const utils::BufferView& bytes,
+    const KRPC& krpc ) : Message(bytes,krpc)
 {
 }
 
-const utils::Buffer Query::getMessageType() const
+utils::BufferView Query::getMessageType() const
 {
-    const std::string path = Type::Query;
-    auto id = find(path);
-    if (!id)
-        throw MalformedMessageException("Couldn't find message type");
-    return *id;
+    return require(_krpc.q,"Couldn't find message type");
 }
 
 } /* message */
@@ -30,7 +30,7 @@ public:
     //! object.
     //! @return a member of the Querys namespace if it's a query. If it's a reply it will be empty
     //! @throw MalformedQueryException in case the field is not available.
-    const utils::Buffer getMessageType() const;
+    utils::BufferView getMessageType() const;
 
     Query& operator=( Query&& ) = default;
     
@@ -41,7 +41,9 @@ protected:
     Query() = default;
 
     //! Constructor 
-    Query(const DataMap& data);
+    Query(
+        const utils::BufferView& bytes,
+        const KRPC& krpc );
 };
 
 } /* message */
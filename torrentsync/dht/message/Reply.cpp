@@ -11,10 +11,6 @@ Reply::~Reply()
 {
 }
 
-Reply::Reply( const DataMap& data ) : Message(data)
-{
-}
-
 Reply::Reply( Message&& m ) : Message(m)
 {
 }
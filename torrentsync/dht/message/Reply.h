@@ -21,8 +21,6 @@ class Reply : public Message
 public:
     virtual ~Reply() = 0;
 
-    Reply( const DataMap& );
-    
     Reply( Message&& );
     
     Reply( const Message& );
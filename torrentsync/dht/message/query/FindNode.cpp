@@ -1,4 +1,4 @@
-#include <torrentsync/dht/message/BEncodeEncoder.h>
+#include <torrentsync/dht/message/PacketTemplate.h>
 #include <torrentsync/dht/NodeData.h>
 #include <torrentsync/dht/Node.h>
 #include <torrentsync/dht/message/query/FindNode.h>
@@ -16,36 +16,54 @@ namespace query
 
 using namespace torrentsync;
 
-FindNode::FindNode(const DataMap& dataMap) : Query(dataMap)
+static constexpr PacketTemplate FIND_NODE_QUERY(
+    "d1:ad2:id20:" PACKET_TEMPLATE_NODE_ID "6:target20:" PACKET_TEMPLATE_NODE_ID
+        "e1:q9:find_node1:t",
+    "1:y1:qe",
+    sizeof("d1:ad2:id20:")-1,
+    sizeof("d1:ad2:id20:" PACKET_TEMPLATE_NODE_ID "6:target20:")-1);
+
+FindNode::FindNode(
+    const utils::BufferView& bytes,
+    const KRPC& krpc ) : Query(bytes,krpc)
 {
-    if (!find( Field::Arguments + "/" + Field::Target ))
+    if (!_krpc.id)
+        throw MalformedMessageException("Missing Peer ID in find_node query");
+    if (!_krpc.target)
         throw MalformedMessageException("Couldn't find Target");
+    if (_krpc.target->size() != NodeData::addressDataLength)
+        throw MalformedMessageException("Wrong Target size in find_node query");
 }
 
 const utils::Buffer FindNode::make( 
-    const utils::Buffer& transactionID,
+    const utils::BufferView& transactionID,
     const dht::NodeData& source,
     const dht::NodeData& target)
 {
-    BEncodeEncoder enc;
-    enc.startDictionary();
-    enc.addElement(Field::Arguments);
-    enc.startDictionary();
-    enc.addDictionaryElement(Field::PeerID,source.write());
-    enc.addDictionaryElement(Field::Target,target.write());
-    enc.endDictionary();
-    enc.addDictionaryElement(Field::Query,Messages::FindNode); 
-    enc.addDictionaryElement(Field::TransactionID,transactionID);
-    enc.addDictionaryElement(Field::Type,Type::Query); 
-    enc.endDictionary();
-    return enc.value();
+    utils::Buffer ret(encodedSize(transactionID));
+    make(ret.data(),ret.size(),transactionID,source,target);
+    return ret;
+}
+
+size_t FindNode::make(
+    uint8_t* output,
+    const size_t capacity,
+    const utils::BufferView& transactionID,
+    const dht::NodeData& source,
+    const dht::NodeData& target)
+{
+    return FIND_NODE_QUERY.write(output,capacity,transactionID,source,&target);
+}
+
+size_t FindNode::encodedSize( const utils::BufferView& transactionID )
+{
+    return FIND_NODE_QUERY.size(transactionID);
 }
 
-utils::Buffer FindNode::getTarget()
+utils::BufferView FindNode::getTarget() const
 {
-    auto token = find( Field::Arguments + "/" + Field::Target );
-    assert(!!token);
-    return *token;
+    assert(!!_krpc.target);
+    return *_krpc.target;
 }
 
 } /* query */
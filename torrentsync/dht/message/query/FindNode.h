@@ -24,8 +24,10 @@ namespace query
 class FindNode : public dht::message::Query
 {
 public:
-    //! FindNode constructor to initialize the class from a raw data map
-    FindNode(const DataMap& dataMap);
+    //! FindNode constructor to initialize the class from a parsed message
+    FindNode(
+        const utils::BufferView& bytes,
+        const KRPC& krpc );
 
     FindNode(FindNode&&) = default;
     
@@ -38,12 +40,31 @@ public:
      * @param target the target address
      */
     static const utils::Buffer make( 
-        const utils::Buffer& transactionID,
+        const utils::BufferView& transactionID,
         const dht::NodeData& source,
         const dht::NodeData& target);
 
+    /** writes a FindNode message without allocating memory
+     * @param output where the message is written
+     * @param capacity size of output, at least encodedSize(transactionID)
+     * @param transactionID the ID
+     * @param source source address (should be our own address)
+     * @param target the target address
+     * @return the size of the message
+     * @throws std::length_error if output is too small
+     */
+    static size_t make(
+        uint8_t* output,
+        const size_t capacity,
+        const utils::BufferView& transactionID,
+        const dht::NodeData& source,
+        const dht::NodeData& target);
+
+    //! @return the exact size of a message created with make()
+    static size_t encodedSize( const utils::BufferView& transactionID );
+
     //! returns the target node
-    utils::Buffer getTarget();
+    utils::BufferView getTarget() const;
     
     FindNode& operator=( FindNode&& ) = default;
 };
@@ -1,4 +1,4 @@
-#include <torrentsync/dht/message/BEncodeEncoder.h>
+#include <torrentsync/dht/message/PacketTemplate.h>
 #include <torrentsync/dht/NodeData.h>
 #include <torrentsync/dht/message/query/Ping.h>
 #include <torrentsync/utils/Buffer.h>
@@ -14,27 +14,40 @@ namespace query
 
 using namespace torrentsync;
 
-Ping::Ping(const DataMap& dataMap) : dht::message::Query(dataMap)
+static constexpr PacketTemplate PING_QUERY(
+    "d1:ad2:id20:" PACKET_TEMPLATE_NODE_ID "e1:q4:ping1:t",
+    "1:y1:qe",
+    sizeof("d1:ad2:id20:")-1);
+
+Ping::Ping(
+    const utils::BufferView& bytes,
+    const KRPC& krpc ) : dht::message::Query(bytes,krpc)
 {
-    if (!find(Field::Arguments + "/" + Field::PeerID))
+    if (!_krpc.id)
         throw MalformedMessageException("Missing Peer ID in Ping Reply");
 }
 
 const utils::Buffer Ping::make( 
-    const utils::Buffer& transactionID,
+    const utils::BufferView& transactionID,
+    const torrentsync::dht::NodeData& source)
+{
+    utils::Buffer ret(encodedSize(transactionID));
+    make(ret.data(),ret.size(),transactionID,source);
+    return ret;
+}
+
+size_t Ping::make(
+    uint8_t* output,
+    const size_t capacity,
+    const utils::BufferView& transactionID,
     const torrentsync::dht::NodeData& source)
 {
-    BEncodeEncoder enc;
-    enc.startDictionary();
-    enc.addElement(Field::Arguments);
-    enc.startDictionary();
-    enc.addDictionaryElement(Field::PeerID,source.write());
-    enc.endDictionary();
-    enc.addDictionaryElement(Field::Query,Messages::Ping); 
-    enc.addDictionaryElement(Field::TransactionID,transactionID);
-    enc.addDictionaryElement(Field::Type,Type::Query);
-    enc.endDictionary();
-    return enc.value();
+    return PING_QUERY.write(output,capacity,transactionID,source);
+}
+
+size_t Ping::encodedSize( const utils::BufferView& transactionID )
+{
+    return PING_QUERY.size(transactionID);
 }
 
 } /* query */
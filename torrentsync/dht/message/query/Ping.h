@@ -20,8 +20,10 @@ namespace query
 class Ping : public dht::message::Query
 {
 public:
-    //! Ping constructor to initialize the class from a raw data map
-    Ping(const DataMap& dataMap);
+    //! Ping constructor to initialize the class from a parsed message
+    Ping(
+        const utils::BufferView& bytes,
+        const KRPC& krpc );
     
     Ping( Ping&& ) = default;
     
@@ -32,9 +34,26 @@ public:
     //! @param transactionID the ID
     //! @param source source address (should be our own address)
     static const utils::Buffer make( 
-        const utils::Buffer& transactionID,
+        const utils::BufferView& transactionID,
         const dht::NodeData& address);
 
+    /** writes a Ping message without allocating memory
+     * @param output where the message is written
+     * @param capacity size of output, at least encodedSize(transactionID)
+     * @param transactionID the ID
+     * @param source source address (should be our own address)
+     * @return the size of the message
+     * @throws std::length_error if output is too small
+     */
+    static size_t make(
+        uint8_t* output,
+        const size_t capacity,
+        const utils::BufferView& transactionID,
+        const dht::NodeData& address);
+
+    //! @return the exact size of a message created with make()
+    static size_t encodedSize( const utils::BufferView& transactionID );
+
     Ping& operator=( Ping&& ) = default;
 };
  
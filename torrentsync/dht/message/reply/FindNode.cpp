@@ -16,63 +16,91 @@ namespace reply
 
 using namespace torrentsync;
 
-FindNode::FindNode(const DataMap& dataMap) : dht::message::Reply(dataMap)
+const utils::Buffer FindNode::make( 
+    const utils::BufferView& transactionID,
+    const dht::NodeData& source,
+    const std::function<boost::optional<dht::NodeSPtr> ()> nodes)
 {
-    check();
+    // sized for the most nodes, shrinking doesn't reallocate
+    utils::Buffer ret(encodedSize(transactionID,DHT_FIND_NODE_COUNT));
+    ret.resize(make(ret.data(),ret.size(),transactionID,source,nodes));
+    return ret;
 }
 
-const utils::Buffer FindNode::make( 
-    const utils::Buffer& transactionID,
+size_t FindNode::make(
+    uint8_t* output,
+    const size_t capacity,
+    const utils::BufferView& transactionID,
     const dht::NodeData& source,
     const std::function<boost::optional<dht::NodeSPtr> ()> nodes)
 {
-    utils::Buffer nodeData(PACKED_NODE_SIZE*DHT_FIND_NODE_COUNT);
+    uint8_t nodeData[PACKED_NODE_SIZE*DHT_FIND_NODE_COUNT];
     
+    // DHT_FIND_NODE_COUNT nodes at most, the yield isn't asked for more
     size_t bufferIndex = 0;
-    for ( auto it = nodes(); !!it; it = nodes() )
+    boost::optional<dht::NodeSPtr> node;
+    while ( bufferIndex < sizeof(nodeData) && !!(node = nodes()) )
     {
-        const utils::Buffer data = (*it)->getPackedNode();
-        assert(bufferIndex + data.size() <= nodeData.size());
-        std::copy(data.cbegin(),data.cend(),nodeData.begin()+bufferIndex);
+        (*node)->writePackedNode(nodeData+bufferIndex);
         bufferIndex += PACKED_NODE_SIZE;
     }
-    nodeData.resize(bufferIndex);
     
-    BEncodeEncoder enc;
+    BEncodeEncoder enc(output,capacity);
     enc.startDictionary();
     enc.addElement(Field::Reply);
     enc.startDictionary();
-    enc.addDictionaryElement(Field::PeerID,source.write());
-    enc.addDictionaryElement(Field::Nodes,nodeData);
+    source.writeTo(enc.reserveDictionaryElement(Field::PeerID,NodeData::addressDataLength));
+    std::copy(nodeData,nodeData+bufferIndex,
+        enc.reserveDictionaryElement(Field::Nodes,bufferIndex));
     enc.endDictionary();
     enc.addDictionaryElement(Field::TransactionID,transactionID);
     enc.addDictionaryElement(Field::Type,Type::Reply); 
     enc.endDictionary();
-    return enc.value();
+    return enc.size();
 }
 
-std::vector<dht::NodeSPtr> FindNode::getNodes() const
+size_t FindNode::encodedSize(
+    const utils::BufferView& transactionID,
+    const size_t nodeCount )
 {
-    auto token = find( Field::Reply + "/" + Field::Nodes );
-    assert(!!token);
+    return 4 + // dictionaries
+        BEncodeEncoder::elementSize(Field::Reply) +
+        BEncodeEncoder::elementSize(Field::PeerID) +
+        BEncodeEncoder::elementSize(NodeData::addressDataLength) +
+        BEncodeEncoder::elementSize(Field::Nodes) +
+        BEncodeEncoder::elementSize(nodeCount*PACKED_NODE_SIZE) +
+        BEncodeEncoder::elementSize(Field::TransactionID) +
+        BEncodeEncoder::elementSize(transactionID.size()) +
+        BEncodeEncoder::elementSize(Field::Type) +
+        BEncodeEncoder::elementSize(Type::Reply);
+}
 
-    const utils::Buffer& buff = *token;
+std::vector<dht::NodeSPtr> FindNode::getNodes() const
+{
+    const CompactNodeView view = getCompactNodes();
 
     std::vector<dht::NodeSPtr> nodes;
+    nodes.reserve(view.size());
     
-    for( auto it = buff.begin(); it+PACKED_NODE_SIZE <= buff.end(); it += PACKED_NODE_SIZE )
+    for( const CompactNode& node : view )
     {
-        nodes.push_back(NodeSPtr(new Node(it,it+PACKED_NODE_SIZE)));
+        nodes.push_back(makeNode(node.id,node.endpoint));
     }
    
     return nodes;
 }
 
+CompactNodeView FindNode::getCompactNodes() const
+{
+    assert(!!_krpc.nodes);
+    return CompactNodeView(*_krpc.nodes);
+}
+
 void FindNode::check() const
 {
-    if (!find(Field::Reply + "/" + Field::PeerID))
-        throw MalformedMessageException("Missing nodes in find_node reply");
-    if (!find(Field::Reply + "/" + Field::Nodes))
+    if (!_krpc.id)
+        throw MalformedMessageException("Missing Peer ID in find_node reply");
+    if (!_krpc.nodes)
         throw MalformedMessageException("Missing nodes in find_node reply");
 }
 
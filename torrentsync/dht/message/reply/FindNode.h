@@ -1,6 +1,7 @@
 #pragma once
 
 #include <torrentsync/dht/message/Reply.h>
+#include <torrentsync/dht/message/CompactView.h>
 #include <torrentsync/utils/Buffer.h>
 #include <torrentsync/dht/Node.h>
 #include <boost/optional.hpp>
@@ -25,9 +26,6 @@ namespace reply
 class FindNode : public dht::message::Reply
 {
 public:
-    //! FindNode constructor to initialize the class from a raw data map
-    FindNode(const DataMap& dataMap);
-
     FindNode(FindNode&&) = default;
 
     FindNode( Message&& );
@@ -42,15 +40,45 @@ public:
      * @param source source address (should be our own address)
      * @param target the target address
      * @param yield a function that returns the closest nodes to send 
-     *              until an invalid value is returned
+     *              until an invalid value is returned, the first
+     *              DHT_FIND_NODE_COUNT are sent
      */
     static const utils::Buffer make( 
-        const utils::Buffer& transactionID,
+        const utils::BufferView& transactionID,
         const dht::NodeData& source,
-        const std::function<boost::optional<std::shared_ptr<Node> >()> yield);
+        const std::function<boost::optional<NodeSPtr>()> yield);
+
+    /** writes a FindNode message reply without allocating memory
+     * @param output where the message is written
+     * @param capacity size of output, at least
+     *                 encodedSize(transactionID,DHT_FIND_NODE_COUNT)
+     * @param transactionID the ID
+     * @param source source address (should be our own address)
+     * @param yield a function that returns the closest nodes to send 
+     *              until an invalid value is returned, the first
+     *              DHT_FIND_NODE_COUNT are sent
+     * @return the size of the message
+     * @throws std::length_error if output is too small
+     */
+    static size_t make(
+        uint8_t* output,
+        const size_t capacity,
+        const utils::BufferView& transactionID,
+        const dht::NodeData& source,
+        const std::function<boost::optional<NodeSPtr>()> yield);
+
+    //! @return the exact size of a message created with make() with
+    //!         nodeCount nodes
+    static size_t encodedSize(
+        const utils::BufferView& transactionID,
+        const size_t nodeCount );
 
     //! returns the parsed nodes
     std::vector<dht::NodeSPtr> getNodes() const;
+
+    //! returns a view over the nodes in the message, decoding them on
+    //! the fly without allocations. Valid as long as the message is.
+    CompactNodeView getCompactNodes() const;
     
     FindNode& operator=( FindNode&& ) = default;
 
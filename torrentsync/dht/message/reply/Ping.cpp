@@ -1,4 +1,4 @@
-#include <torrentsync/dht/message/BEncodeEncoder.h>
+#include <torrentsync/dht/message/PacketTemplate.h>
 #include <torrentsync/dht/NodeData.h>
 #include <torrentsync/dht/message/reply/Ping.h>
 #include <torrentsync/utils/Buffer.h>
@@ -14,25 +14,32 @@ namespace reply
 
 using namespace torrentsync;
 
-Ping::Ping(const DataMap& dataMap) : dht::message::Reply(dataMap)
+static constexpr PacketTemplate PING_REPLY(
+    "d1:rd2:id20:" PACKET_TEMPLATE_NODE_ID "e1:t",
+    "1:y1:re",
+    sizeof("d1:rd2:id20:")-1);
+
+const utils::Buffer Ping::make( 
+    const utils::BufferView& transactionID,
+    const dht::NodeData& source)
 {
-    check();
+    utils::Buffer ret(encodedSize(transactionID));
+    make(ret.data(),ret.size(),transactionID,source);
+    return ret;
 }
 
-const utils::Buffer Ping::make( 
-    const utils::Buffer& transactionID,
+size_t Ping::make(
+    uint8_t* output,
+    const size_t capacity,
+    const utils::BufferView& transactionID,
     const dht::NodeData& source)
 {
-    BEncodeEncoder enc;
-    enc.startDictionary();
-    enc.addElement(Field::Reply);
-    enc.startDictionary();
-    enc.addDictionaryElement(Field::PeerID,source.write());
-    enc.endDictionary();
-    enc.addDictionaryElement(Field::TransactionID,transactionID);
-    enc.addDictionaryElement(Field::Type,Type::Reply);
-    enc.endDictionary();
-    return enc.value();
+    return PING_REPLY.write(output,capacity,transactionID,source);
+}
+
+size_t Ping::encodedSize( const utils::BufferView& transactionID )
+{
+    return PING_REPLY.size(transactionID);
 }
 
 Ping::Ping( Message&& m ) : Reply(m)
@@ -47,7 +54,7 @@ Ping::Ping( const Message& m ) : Reply(m)
 
 void Ping::check() const
 {
-    if (!find(Field::Reply + "/" + Field::PeerID))
+    if (!_krpc.id)
         throw MalformedMessageException("Missing Peer ID in Ping Reply");
 }
 
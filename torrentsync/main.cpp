@@ -1,6 +1,8 @@
 #include <torrentsync/utils/log/Logger.h>
 #include <torrentsync/App.h>
 
+#include <iostream>
+
 using namespace torrentsync::utils::log;
 
 int main()
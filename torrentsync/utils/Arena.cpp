@@ -0,0 +1,93 @@
+#include <torrentsync/utils/Arena.h>
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+const size_t Arena::BLOCK_SIZE = 16 * 1024;
+
+Arena::Arena( const size_t blockSize ) :
+    _blockSize(blockSize),
+    _current(0),
+    _offset(0),
+    _usedBefore(0)
+{
+    assert(blockSize > 0);
+    _blocks.reserve(4);
+    _blocks.push_back(Block{static_cast<uint8_t*>(::operator new(_blockSize)),_blockSize});
+}
+
+Arena::~Arena()
+{
+    for( const Block& block : _blocks )
+        ::operator delete(block.data);
+}
+
+void* Arena::allocate(
+    const size_t size,
+    const size_t alignment )
+{
+    assert(alignment > 0 && (alignment & (alignment-1)) == 0);
+
+    const Block* block = &_blocks[_current];
+    uintptr_t address = reinterpret_cast<uintptr_t>(block->data) + _offset;
+    size_t padding = (alignment - (address & (alignment-1))) & (alignment-1);
+
+    if (_offset + padding + size > block->size)
+    {
+        nextBlock(size,alignment);
+        block   = &_blocks[_current];
+        address = reinterpret_cast<uintptr_t>(block->data);
+        padding = (alignment - (address & (alignment-1))) & (alignment-1);
+    }
+
+    uint8_t* const ret = block->data + _offset + padding;
+    _offset += padding + size;
+    return ret;
+}
+
+void Arena::nextBlock( const size_t size, const size_t alignment )
+{
+    const size_t next = _current+1;
+
+    // reuse the blocks kept from before the last reset when big enough
+    if (next >= _blocks.size() || _blocks[next].size < size+alignment)
+    {
+        _blocks.reserve(_blocks.size()+1); // the insertion can't throw later
+        const size_t blockSize = std::max(_blockSize,size+alignment);
+        const Block block{static_cast<uint8_t*>(::operator new(blockSize)),blockSize};
+        _blocks.insert(_blocks.begin()+next,block);
+    }
+
+    _usedBefore += _offset;
+    _offset  = 0;
+    _current = next;
+}
+
+void Arena::reset() noexcept
+{
+    _current    = 0;
+    _offset     = 0;
+    _usedBefore = 0;
+}
+
+size_t Arena::used() const noexcept
+{
+    return _usedBefore + _offset;
+}
+
+size_t Arena::capacity() const noexcept
+{
+    size_t ret = 0;
+    for( const Block& block : _blocks )
+        ret += block.size;
+    return ret;
+}
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Monotonic memory arena.
+ * Memory is taken sequentially from blocks and released all at once with
+ * reset(). The blocks are kept between resets, so once the arena has grown
+ * to the peak usage no more calls to the system allocator are made.
+ * Not thread safe.
+ */
+class Arena : public boost::noncopyable
+{
+public:
+    //! default size of a block
+    static const size_t BLOCK_SIZE;
+
+    //! Constructor
+    //! @param blockSize the size of the blocks, larger allocations get a
+    //!        block of their own
+    explicit Arena( const size_t blockSize = BLOCK_SIZE );
+
+    ~Arena();
+
+    /** allocates memory valid until the next reset
+     * @param size the bytes to allocate
+     * @param alignment must be a power of 2
+     * @throws std::bad_alloc
+     */
+    void* allocate(
+        const size_t size,
+        const size_t alignment = alignof(std::max_align_t) );
+
+    //! releases every allocation, the memory is kept for reuse
+    void reset() noexcept;
+
+    //! @return the bytes allocated since the last reset, padding included
+    size_t used() const noexcept;
+
+    //! @return the bytes reserved from the system allocator
+    size_t capacity() const noexcept;
+
+private:
+    struct Block
+    {
+        uint8_t* data;
+        size_t   size;
+    };
+
+    //! moves to a block with at least size+alignment bytes
+    void nextBlock( const size_t size, const size_t alignment );
+
+    const size_t _blockSize;
+
+    std::vector<Block> _blocks;
+
+    //! block in use
+    size_t _current;
+
+    //! position in the current block
+    size_t _offset;
+
+    //! bytes used in the blocks before the current one
+    size_t _usedBefore;
+};
+
+/** std compatible allocator taking memory from an Arena.
+ * Deallocation is a no-op: the memory is released by Arena::reset.
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator( Arena& arena ) noexcept : _arena(&arena) {}
+
+    template <class U>
+    ArenaAllocator( const ArenaAllocator<U>& other ) noexcept : _arena(&other.arena()) {}
+
+    T* allocate( const size_t n )
+    {
+        return static_cast<T*>(_arena->allocate(n*sizeof(T),alignof(T)));
+    }
+
+    void deallocate( T*, const size_t ) noexcept {}
+
+    Arena& arena() const noexcept { return *_arena; }
+
+    template <class U>
+    struct rebind { typedef ArenaAllocator<U> other; };
+
+private:
+    Arena* _arena;
+};
+
+template <class T, class U>
+inline bool operator==( const ArenaAllocator<T>& a, const ArenaAllocator<U>& b ) noexcept
+{
+    return &a.arena() == &b.arena();
+}
+
+template <class T, class U>
+inline bool operator!=( const ArenaAllocator<T>& a, const ArenaAllocator<U>& b ) noexcept
+{
+    return !(a == b);
+}
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,266 @@
+#include <torrentsync/utils/BatchedSocket.h>
+#include <torrentsync/utils/Finally.h>
+#include <torrentsync/utils/log/Logger.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+const size_t BatchedSocket::DEFAULT_BATCH_SIZE;
+
+BatchedSocket::BatchedSocket(
+    boost::asio::ip::udp::socket& socket,
+    const size_t bufferSize,
+    const SendQueue::Config& config,
+    const size_t batchSize ) :
+        _socket(socket),
+        _batch_size(batchSize),
+        _ring(batchSize,bufferSize),
+        _recv_iovecs(batchSize),
+        _recv_headers(batchSize),
+        _empty({nullptr,0,endpoint_t()}),
+        _queue(config),
+        _timer(socket.get_executor()),
+        _send_iovecs(batchSize),
+        _send_headers(batchSize),
+        _flushing(false),
+        _waiting_tokens(false)
+{
+}
+
+BatchedSocket::~BatchedSocket()
+{
+    // the pending handlers are called with operation_aborted and don't
+    // access the object
+    boost::system::error_code error;
+    if (_socket.is_open())
+        _socket.cancel(error);
+    _timer.cancel(error);
+}
+
+void BatchedSocket::startReceive( const receive_handler_t& handler )
+{
+    _handler = handler;
+    waitReceive();
+}
+
+void BatchedSocket::waitReceive()
+{
+    _socket.async_wait(
+        boost::asio::ip::udp::socket::wait_read,
+        [this]( const boost::system::error_code& error )
+        {
+            if (error == boost::asio::error::operation_aborted)
+                return;
+
+            if (error)
+            {
+                _handler(error,_empty);
+            }
+            else
+            {
+                receive();
+            }
+            waitReceive();
+        });
+}
+
+void BatchedSocket::receive()
+{
+    // the slots are released by the end of the previous batch
+    assert(_ring.available() == _ring.capacity());
+    const size_t count = _ring.available();
+    for( size_t i = 0; i < count; ++i )
+    {
+        ReceiveRing::Slot& slot = _ring.next(i);
+        _recv_iovecs[i].iov_base = slot.data;
+        _recv_iovecs[i].iov_len  = _ring.slotSize();
+
+        msghdr& header = _recv_headers[i].msg_hdr;
+        memset(&header,0,sizeof(header));
+        header.msg_name    = slot.sender.data();
+        header.msg_namelen = slot.sender.capacity();
+        header.msg_iov     = &_recv_iovecs[i];
+        header.msg_iovlen  = 1;
+    }
+
+    int received;
+    do
+    {
+        received = recvmmsg(_socket.native_handle(),_recv_headers.data(),
+            count,MSG_DONTWAIT,nullptr);
+    } while (received < 0 && errno == EINTR);
+
+    if (received < 0)
+    {
+        // spurious wake up
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return;
+
+        const boost::system::error_code error(errno,boost::system::system_category());
+        _handler(error,_empty);
+        return;
+    }
+
+    for( int i = 0; i < received; ++i )
+    {
+        ReceiveRing::Slot& slot = _ring.next(i);
+        slot.length = _recv_headers[i].msg_len;
+        slot.sender.resize(_recv_headers[i].msg_hdr.msg_namelen);
+    }
+    _ring.acquire(received);
+
+    while (_ring.size() > 0)
+    {
+        // a datagram failing doesn't stop the batch nor the next wait
+        Finally release([this](){ _ring.release(); });
+        try
+        {
+            _handler(boost::system::error_code(),_ring.front());
+        }
+        catch( const std::exception& e )
+        {
+            LOG(ERROR,"BatchedSocket * receive handler failed on a datagram from " <<
+                _ring.front().sender << ": " << e.what());
+        }
+    }
+}
+
+bool BatchedSocket::send(
+    const Buffer& buffer,
+    const endpoint_t& destination,
+    const SendQueue::class_t cls )
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+
+    if (!_queue.push(cls,buffer,destination))
+        return false;
+
+    if (!_flushing)
+    {
+        _flushing = true;
+        boost::asio::post(_socket.get_executor(),[this]() { flush(); });
+    }
+    else if (_waiting_tokens &&
+        _queue.nextReady(SendQueue::clock::now()) == SendQueue::clock::duration::zero())
+    {
+        // the flush waits for a limited class, this one can't wait behind it
+        boost::system::error_code error;
+        _timer.cancel(error);
+        _waiting_tokens = false;
+        boost::asio::post(_socket.get_executor(),[this]() { flush(); });
+    }
+    return true;
+}
+
+size_t BatchedSocket::queued() const
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    return _queue.size()+_sending.size();
+}
+
+SendQueue::Counters BatchedSocket::getCounters( const SendQueue::class_t cls ) const
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    return _queue.getCounters(cls);
+}
+
+void BatchedSocket::waitSend()
+{
+    _socket.async_wait(
+        boost::asio::ip::udp::socket::wait_write,
+        [this]( const boost::system::error_code& error )
+        {
+            if (error == boost::asio::error::operation_aborted)
+                return;
+            flush();
+        });
+}
+
+void BatchedSocket::waitTokens( const SendQueue::clock::duration& delay )
+{
+    _waiting_tokens = true;
+    _timer.expires_after(delay);
+    _timer.async_wait(
+        [this]( const boost::system::error_code& error )
+        {
+            if (error == boost::asio::error::operation_aborted)
+                return;
+            flush();
+        });
+}
+
+void BatchedSocket::flush()
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    _waiting_tokens = false;
+
+    for(;;)
+    {
+        // what the socket refused last time goes first
+        const SendQueue::clock::time_point now = SendQueue::clock::now();
+        SendQueue::Datagram datagram;
+        while (_sending.size() < _batch_size && _queue.pop(datagram,now))
+            _sending.push_back(std::move(datagram));
+
+        if (_sending.empty())
+            break;
+
+        const size_t count = _sending.size();
+        for( size_t i = 0; i < count; ++i )
+        {
+            SendQueue::Datagram& datagram = _sending[i];
+            _send_iovecs[i].iov_base = datagram.buffer.data();
+            _send_iovecs[i].iov_len  = datagram.buffer.size();
+
+            msghdr& header = _send_headers[i].msg_hdr;
+            memset(&header,0,sizeof(header));
+            header.msg_name    = datagram.destination.data();
+            header.msg_namelen = datagram.destination.size();
+            header.msg_iov     = &_send_iovecs[i];
+            header.msg_iovlen  = 1;
+        }
+
+        const int sent = sendmmsg(_socket.native_handle(),_send_headers.data(),
+            count,MSG_DONTWAIT);
+
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            // the socket buffer is full, the rest waits
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                waitSend();
+                return;
+            }
+
+            // the first datagram can't be sent
+            LOG(DEBUG,"BatchedSocket * send to " << _sending.front().destination <<
+                " failed: " << strerror(errno));
+            _sending.erase(_sending.begin());
+            continue;
+        }
+
+        _sending.erase(_sending.begin(),_sending.begin()+sent);
+    }
+
+    // the rate limits hold the rest
+    if (!_queue.empty())
+    {
+        waitTokens(_queue.nextReady(SendQueue::clock::now()));
+        return;
+    }
+
+    _flushing = false;
+}
+
+}; // utils
+}; // torrentsync
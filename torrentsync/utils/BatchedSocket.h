@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <torrentsync/utils/Buffer.h>
+#include <torrentsync/utils/ReceiveRing.h>
+#include <torrentsync/utils/SendQueue.h>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Receives and sends the datagrams of an UDP socket in batches.
+ * Instead of a read per datagram, it waits for the socket to be readable
+ * on the io_service and drains up to batchSize datagrams with a single
+ * recvmmsg, straight into the slots of a ReceiveRing. The datagrams to
+ * send go to a SendQueue and are flushed, batchSize at a time, with
+ * sendmmsg; if the socket buffer is full the flush waits for the socket to
+ * be writable, if the rate limits hold the queue it waits on a timer.
+ * The socket must be open, and bound to receive, and must not be used
+ * directly while the batches are in progress. Sending is thread safe, the
+ * handler is called from the io_service.
+ */
+class BatchedSocket : public boost::noncopyable
+{
+public:
+    typedef boost::asio::ip::udp::endpoint endpoint_t;
+
+    /** called for every datagram received, or for the receive errors
+     * @param error the error, if any
+     * @param slot holding the datagram, released when the handler returns.
+     *        Empty in case of errors.
+     */
+    typedef std::function<void (
+        const boost::system::error_code& error,
+        const ReceiveRing::Slot& slot)> receive_handler_t;
+
+    //! default number of datagrams per system call
+    static const size_t DEFAULT_BATCH_SIZE = 32;
+
+    /** Constructor
+     * @param socket the socket, used by reference
+     * @param bufferSize the largest datagram received
+     * @param config the limits of the send queue
+     * @param batchSize the datagrams received and sent per system call
+     * @throws std::invalid_argument if batchSize is 0
+     */
+    BatchedSocket(
+        boost::asio::ip::udp::socket& socket,
+        const size_t bufferSize,
+        const SendQueue::Config& config = SendQueue::Config(),
+        const size_t batchSize = DEFAULT_BATCH_SIZE );
+
+    //! cancels the operations on the socket
+    ~BatchedSocket();
+
+    //! starts waiting for datagrams, each one is passed to the handler. An
+    //! exception thrown by the handler is logged and drops the datagram.
+    void startReceive( const receive_handler_t& handler );
+
+    /** queues a datagram to be sent
+     * @param cls the traffic class
+     * @return false if the queue is full and the datagram dropped
+     */
+    bool send(
+        const Buffer& buffer,
+        const endpoint_t& destination,
+        const SendQueue::class_t cls = SendQueue::REPLY );
+
+    //! @return the datagrams waiting to be sent
+    size_t queued() const;
+
+    //! @return the counters of the send queue for a class
+    SendQueue::Counters getCounters( const SendQueue::class_t cls ) const;
+
+    //! @return the limits of the send queue
+    const SendQueue::Config& getConfig() const noexcept { return _queue.getConfig(); }
+
+private:
+
+    //! waits for the socket to be readable
+    void waitReceive();
+
+    //! reads the datagrams available, at most a batch
+    void receive();
+
+    //! waits for the socket to be writable to flush the queue
+    void waitSend();
+
+    //! waits for the rate limits to allow the next datagram
+    void waitTokens( const SendQueue::clock::duration& delay );
+
+    //! sends the queue until it's empty or the socket buffer is full
+    void flush();
+
+    boost::asio::ip::udp::socket& _socket;
+
+    const size_t _batch_size;
+
+    receive_handler_t _handler;
+
+    //! ************** receive batch *****************
+
+    ReceiveRing          _ring;
+    std::vector<iovec>   _recv_iovecs;
+    std::vector<mmsghdr> _recv_headers;
+
+    //! passed to the handler with the errors
+    const ReceiveRing::Slot _empty;
+
+    //! ************** send queue *****************
+
+    mutable std::mutex _send_mutex;
+
+    SendQueue _queue;
+
+    //! taken from the queue and not sent yet, the next to send
+    std::vector<SendQueue::Datagram> _sending;
+
+    //! wakes up the flush held by the rate limits
+    boost::asio::steady_timer _timer;
+
+    std::vector<iovec>   _send_iovecs;
+    std::vector<mmsghdr> _send_headers;
+
+    //! a flush is scheduled or waiting for the socket
+    bool _flushing;
+
+    //! the flush is waiting on the timer for the rate limits
+    bool _waiting_tokens;
+};
+
+}; // utils
+}; // torrentsync
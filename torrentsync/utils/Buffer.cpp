@@ -80,7 +80,7 @@ std::ostream& operator<<(
 {
     const auto flags = stream.flags();
     stream << std::hex;
-    for( auto it = buff._buff.cbegin(); it != buff._buff.cend(); ++it )
+    for( auto it = buff._begin; it != buff._end; ++it )
     {
         if ( std::isprint(*it))
         {
@@ -30,8 +30,12 @@ std::ostream& operator<<( std::ostream& stream, const torrentsync::utils::Buffer
 //! until a c-string terminator ('\0') is found.
 struct pretty_print
 {
-    const torrentsync::utils::Buffer& _buff;
-    pretty_print(const torrentsync::utils::Buffer& buff) : _buff(buff) {}
+    const uint8_t* _begin;
+    const uint8_t* _end;
+    pretty_print(const torrentsync::utils::Buffer& buff) :
+        _begin(buff.data()), _end(buff.data()+buff.size()) {}
+    pretty_print(const uint8_t* data, const size_t size) :
+        _begin(data), _end(data+size) {}
 };
 
 std::ostream& operator<<( std::ostream& stream, const pretty_print& buff );
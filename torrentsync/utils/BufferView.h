@@ -0,0 +1,91 @@
+#pragma once
+
+#include <torrentsync/utils/Buffer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <ostream>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/*! Non-owning view over a range of bytes.
+    The view is valid only as long as the underlying memory is, usually the
+    receive buffer of a datagram. Use toBuffer() to take a copy of the data.
+ */
+class BufferView
+{
+public:
+    typedef const uint8_t* const_iterator;
+
+    BufferView() noexcept : _data(nullptr), _size(0) {}
+
+    BufferView( const uint8_t* data, const size_t size ) noexcept :
+        _data(data), _size(size) {}
+
+    BufferView( const Buffer& buff ) noexcept :
+        _data(buff.data()), _size(buff.size()) {}
+
+    inline const uint8_t* data()    const noexcept { return _data; }
+    inline size_t size()            const noexcept { return _size; }
+    inline bool empty()             const noexcept { return _size == 0; }
+
+    inline const_iterator begin()   const noexcept { return _data; }
+    inline const_iterator end()     const noexcept { return _data+_size; }
+    inline const_iterator cbegin()  const noexcept { return _data; }
+    inline const_iterator cend()    const noexcept { return _data+_size; }
+
+    inline uint8_t operator[]( const size_t i ) const noexcept { return _data[i]; }
+
+    //! copies the viewed data in a new Buffer
+    inline Buffer toBuffer() const { return Buffer(begin(),end()); }
+
+    inline bool operator==( const BufferView& v ) const noexcept
+    {
+        return _size == v._size &&
+            (_size == 0 || std::memcmp(_data,v._data,_size) == 0);
+    }
+
+    inline bool operator!=( const BufferView& v ) const noexcept
+    {
+        return !(*this == v);
+    }
+
+    inline bool operator==( const std::string& s ) const noexcept
+    {
+        return _size == s.size() &&
+            (_size == 0 || std::memcmp(_data,s.data(),_size) == 0);
+    }
+
+    inline bool operator!=( const std::string& s ) const noexcept
+    {
+        return !(*this == s);
+    }
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+};
+
+inline bool operator==( const Buffer& buff, const BufferView& view ) noexcept
+{
+    return view == BufferView(buff);
+}
+
+inline bool operator!=( const Buffer& buff, const BufferView& view ) noexcept
+{
+    return view != BufferView(buff);
+}
+
+inline std::ostream& operator<<( std::ostream& stream, const BufferView& view )
+{
+    std::for_each( view.begin(), view.end(), [&](const uint8_t c) { stream << c; });
+    return stream;
+}
+
+}; // utils
+}; // torrentsync
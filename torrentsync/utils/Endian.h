@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <endian.h>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/* Big-endian (network order) loads and stores from unaligned memory.
+ * memcpy is turned by the compiler in a single move, followed by a byte
+ * swap on little-endian machines.
+ */
+
+inline uint64_t loadBE64( const uint8_t* data ) noexcept
+{
+    uint64_t value;
+    memcpy(&value,data,sizeof(value));
+    return be64toh(value);
+}
+
+inline uint32_t loadBE32( const uint8_t* data ) noexcept
+{
+    uint32_t value;
+    memcpy(&value,data,sizeof(value));
+    return be32toh(value);
+}
+
+inline uint16_t loadBE16( const uint8_t* data ) noexcept
+{
+    uint16_t value;
+    memcpy(&value,data,sizeof(value));
+    return be16toh(value);
+}
+
+inline void storeBE64( uint8_t* out, const uint64_t value ) noexcept
+{
+    const uint64_t be = htobe64(value);
+    memcpy(out,&be,sizeof(be));
+}
+
+inline void storeBE32( uint8_t* out, const uint32_t value ) noexcept
+{
+    const uint32_t be = htobe32(value);
+    memcpy(out,&be,sizeof(be));
+}
+
+inline void storeBE16( uint8_t* out, const uint16_t value ) noexcept
+{
+    const uint16_t be = htobe16(value);
+    memcpy(out,&be,sizeof(be));
+}
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,66 @@
+#include <torrentsync/utils/GracePeriod.h>
+
+#include <functional>
+#include <thread>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+const size_t GracePeriod::SLOTS;
+
+//! the slot of the calling thread
+static size_t threadSlot() noexcept
+{
+    static thread_local const size_t slot =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) % GracePeriod::SLOTS;
+    return slot;
+}
+
+GracePeriod::GracePeriod() : _phase(0)
+{
+    for( Slot& slot : _slots )
+    {
+        slot.readers[0].store(0);
+        slot.readers[1].store(0);
+    }
+}
+
+size_t GracePeriod::enter() noexcept
+{
+    const size_t slot  = threadSlot();
+    const size_t phase = _phase.load();
+    _slots[slot].readers[phase].fetch_add(1);
+    return slot*2 + phase;
+}
+
+void GracePeriod::leave( const size_t token ) noexcept
+{
+    _slots[token/2].readers[token%2].fetch_sub(1);
+}
+
+// A reader which read the phase before a flip may join it after the wait on
+// that phase is over, still reading the version current at that time; the
+// second flip waits for it as well, so both phases are drained once.
+void GracePeriod::synchronize() noexcept
+{
+    for( int i = 0; i < 2; ++i )
+    {
+        const size_t phase = _phase.load();
+        _phase.store(phase ^ 1);
+        wait(phase);
+    }
+}
+
+void GracePeriod::wait( const size_t phase ) const noexcept
+{
+    for( const Slot& slot : _slots )
+    {
+        while (slot.readers[phase].load() != 0)
+            std::this_thread::yield();
+    }
+}
+
+}; // utils
+}; // torrentsync
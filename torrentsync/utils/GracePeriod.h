@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Tracks the readers of a structure updated by copy, so that a writer knows
+ * when a replaced version can't be referenced anymore (the grace period of
+ * the read-copy-update scheme).
+ * A reader marks the current phase in a counter picked by its thread, so the
+ * readers don't contend with each other and never wait for the writers.
+ * A writer publishes the new version, then calls synchronize() before
+ * freeing the old one. Writers must be serialized.
+ */
+class GracePeriod : public boost::noncopyable
+{
+public:
+    //! number of reader counters, the threads are spread among them
+    static const size_t SLOTS = 32;
+
+    //! Marks a read section for its whole lifetime
+    class ReadGuard : public boost::noncopyable
+    {
+    public:
+        explicit ReadGuard( GracePeriod& period ) noexcept :
+            _period(period), _token(period.enter()) {}
+
+        ~ReadGuard() { _period.leave(_token); }
+
+    private:
+        GracePeriod& _period;
+        const size_t _token;
+    };
+
+    GracePeriod();
+
+    /** starts a read section
+     * @return the token to pass to leave()
+     */
+    size_t enter() noexcept;
+
+    //! ends a read section
+    void leave( const size_t token ) noexcept;
+
+    //! waits until every read section started before the call is over
+    void synchronize() noexcept;
+
+private:
+
+    //! waits until no reader is in the phase
+    void wait( const size_t phase ) const noexcept;
+
+    //! the counters of one slot, in a cache line of its own
+    struct alignas(64) Slot
+    {
+        std::atomic<size_t> readers[2];
+    };
+
+    std::array<Slot,SLOTS> _slots;
+
+    //! the phase the new readers join, 0 or 1
+    std::atomic<size_t> _phase;
+};
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,56 @@
+#include <torrentsync/utils/MappedFile.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+MappedFile::MappedFile( const std::string& path ) :
+    _data(nullptr),
+    _size(0)
+{
+    const int fd = open(path.c_str(),O_RDONLY|O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno,std::system_category(),"open " + path);
+
+    struct stat info;
+    if (fstat(fd,&info) != 0)
+    {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error,std::system_category(),"stat " + path);
+    }
+
+    _size = static_cast<size_t>(info.st_size);
+    if (_size > 0)
+    {
+        void* const data = mmap(nullptr,_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (data == MAP_FAILED)
+        {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error,std::system_category(),"mmap " + path);
+        }
+        _data = static_cast<const uint8_t*>(data);
+    }
+
+    // the mapping stays valid once the file is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+        munmap(const_cast<uint8_t*>(_data),_size);
+}
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** A file mapped read-only in memory.
+ * The pages are loaded by the kernel when first accessed, opening a large
+ * file costs no read.
+ */
+class MappedFile : public boost::noncopyable
+{
+public:
+    //! Constructor
+    //! @param path the file to map
+    //! @throws std::system_error if the file can't be opened or mapped
+    explicit MappedFile( const std::string& path );
+
+    ~MappedFile();
+
+    //! @return the contents of the file, nullptr if empty
+    const uint8_t* data() const noexcept { return _data; }
+
+    //! @return the size of the file
+    size_t size() const noexcept { return _size; }
+
+private:
+    const uint8_t* _data;
+    size_t         _size;
+};
+
+}; // utils
+}; // torrentsync
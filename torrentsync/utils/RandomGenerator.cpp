@@ -1,6 +1,8 @@
-#include <ctime>
+#include <cerrno>
+#include <cstring>
 #include <random>
-#include <mutex>
+
+#include <sys/random.h>
 
 #include <torrentsync/utils/RandomGenerator.h>
 
@@ -9,39 +11,59 @@ namespace torrentsync
 namespace utils
 {
 
-class RandomGeneratorImpl : public RandomGenerator
+RandomGenerator& RandomGenerator::getInstance()
+{
+    static thread_local RandomGenerator generator;
+    return generator;
+}
+
+RandomGenerator::RandomGenerator()
 {
-public:
-    RandomGeneratorImpl() : dist(0)
+    uint8_t* const seed = reinterpret_cast<uint8_t*>(_state);
+    size_t filled = 0;
+    while (filled < sizeof(_state))
     {
-        gen.seed(static_cast<unsigned int>(std::time(0)));
+        const ssize_t ret = getrandom(seed+filled,sizeof(_state)-filled,0);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            break;
+        filled += static_cast<size_t>(ret);
     }
 
-    virtual uint32_t get()
+    // getrandom not available, std::random_device is the best left
+    if (filled < sizeof(_state))
     {
-        return dist(gen);
+        std::random_device device;
+        for( uint64_t& word : _state )
+            word = (static_cast<uint64_t>(device()) << 32) | device();
     }
 
-private:
-    std::mt19937 gen;
-    std::uniform_int_distribution<uint32_t> dist;
-};
-
-std::unique_ptr<RandomGenerator> RandomGenerator::generator;
+    // the all zero state would only ever generate zeros
+    if ((_state[0] | _state[1] | _state[2] | _state[3]) == 0)
+        _state[0] = 1;
+}
 
-RandomGenerator& RandomGenerator::getInstance()
+RandomGenerator::RandomGenerator( const uint64_t seed[4] ) noexcept
 {
-    static std::mutex mutex;      
-    std::lock_guard<std::mutex> lock(mutex);
-    if (!generator.get())
-    {
-        generator.reset(new RandomGeneratorImpl());
-    }
-    return *generator;
+    memcpy(_state,seed,sizeof(_state));
+    if ((_state[0] | _state[1] | _state[2] | _state[3]) == 0)
+        _state[0] = 1;
 }
 
-RandomGenerator::RandomGenerator()
+void RandomGenerator::fill( uint8_t* data, const size_t length ) noexcept
 {
+    size_t i = 0;
+    for( ; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t) )
+    {
+        const uint64_t value = next();
+        memcpy(data+i,&value,sizeof(value));
+    }
+    if (i < length)
+    {
+        const uint64_t value = next();
+        memcpy(data+i,&value,length-i);
+    }
 }
 
 }; // utils
@@ -1,28 +1,68 @@
 #pragma once
 
-#include <memory>
+#include <cstddef>
 #include <cstdint>
 
+#include <boost/noncopyable.hpp>
+
 namespace torrentsync
 {
 namespace utils
 {
 
-class RandomGenerator
+/** Fast pseudo random generator, xoshiro256**.
+ * Every thread has its own generator, seeded from the kernel entropy pool
+ * (getrandom), so no lock is taken. Not suitable for cryptography.
+ */
+class RandomGenerator : public boost::noncopyable
 {
 public:
 
+    //! @return the generator of the calling thread
     static RandomGenerator& getInstance();
 
-    virtual uint32_t get()=0;
+    //! @return 32 random bits
+    uint32_t get() noexcept { return static_cast<uint32_t>(next() >> 32); }
 
-protected:
-    RandomGenerator();
+    //! @return 64 random bits
+    uint64_t get64() noexcept { return next(); }
+
+    //! fills a memory region with random bytes
+    void fill( uint8_t* data, const size_t length ) noexcept;
+
+    //! Constructor
+    //! @param seed 4 words of seed, not all zero
+    explicit RandomGenerator( const uint64_t seed[4] ) noexcept;
 
 private:
-    static std::unique_ptr<RandomGenerator> generator;
+    //! seeded from the kernel
+    RandomGenerator();
+
+    inline uint64_t next() noexcept;
 
+    static inline uint64_t rotl( const uint64_t x, const int k ) noexcept
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t _state[4];
 };
 
+uint64_t RandomGenerator::next() noexcept
+{
+    const uint64_t result = rotl(_state[1] * 5, 7) * 9;
+    const uint64_t t = _state[1] << 17;
+
+    _state[2] ^= _state[0];
+    _state[3] ^= _state[1];
+    _state[1] ^= _state[2];
+    _state[0] ^= _state[3];
+
+    _state[2] ^= t;
+    _state[3] = rotl(_state[3], 45);
+
+    return result;
+}
+
 }; // utils
 }; // torrentsync
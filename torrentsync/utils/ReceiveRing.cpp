@@ -0,0 +1,45 @@
+#include <torrentsync/utils/ReceiveRing.h>
+
+#include <cassert>
+#include <stdexcept>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+ReceiveRing::ReceiveRing(
+    const size_t slots,
+    const size_t slotSize ) :
+        _slot_size(slotSize),
+        _slots(slots),
+        _tail(0),
+        _count(0)
+{
+    if (slots == 0)
+        throw std::invalid_argument("The receive ring can't be empty");
+
+    // default initialized, the datagrams overwrite it anyway
+    _memory.reset(new uint8_t[slots*slotSize]);
+    for( size_t i = 0; i < slots; ++i )
+    {
+        _slots[i].data   = _memory.get()+i*slotSize;
+        _slots[i].length = 0;
+    }
+}
+
+void ReceiveRing::acquire( const size_t count ) noexcept
+{
+    assert(count <= available());
+    _count += count;
+}
+
+void ReceiveRing::release() noexcept
+{
+    assert(_count > 0);
+    _tail = (_tail+1) % _slots.size();
+    --_count;
+}
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Fixed ring of receive slots, each one a buffer with the length and the
+ * sender of the datagram it holds.
+ * The buffers are allocated at once when the ring is built and are never
+ * initialized nor reallocated. The free slots are filled and acquired at
+ * the head, the acquired ones are processed and released in the same order
+ * at the tail.
+ * Not thread safe.
+ */
+class ReceiveRing : public boost::noncopyable
+{
+public:
+    struct Slot
+    {
+        //! the buffer, slotSize bytes
+        uint8_t* data;
+
+        //! bytes of the datagram
+        size_t length;
+
+        boost::asio::ip::udp::endpoint sender;
+    };
+
+    /** Constructor
+     * @param slots number of slots
+     * @param slotSize bytes of every buffer
+     * @throws std::invalid_argument if slots is 0
+     */
+    ReceiveRing(
+        const size_t slots,
+        const size_t slotSize );
+
+    //! @return the slots in the ring
+    size_t capacity() const noexcept { return _slots.size(); }
+
+    //! @return the bytes of every buffer
+    size_t slotSize() const noexcept { return _slot_size; }
+
+    //! @return the slots acquired and not released
+    size_t size() const noexcept { return _count; }
+
+    //! @return the free slots
+    size_t available() const noexcept { return _slots.size()-_count; }
+
+    //! @return the free slot after index others, index < available()
+    Slot& next( const size_t index ) noexcept
+    {
+        return _slots[(_tail+_count+index) % _slots.size()];
+    }
+
+    //! acquires the first count free slots, once filled
+    void acquire( const size_t count ) noexcept;
+
+    //! @return the oldest acquired slot
+    Slot& front() noexcept { return _slots[_tail]; }
+
+    //! releases the oldest acquired slot
+    void release() noexcept;
+
+private:
+    const size_t _slot_size;
+
+    std::unique_ptr<uint8_t[]> _memory;
+
+    std::vector<Slot> _slots;
+
+    //! the oldest acquired slot
+    size_t _tail;
+
+    size_t _count;
+};
+
+}; // utils
+}; // torrentsync
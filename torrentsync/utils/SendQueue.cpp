@@ -0,0 +1,140 @@
+#include <torrentsync/utils/SendQueue.h>
+
+#include <algorithm>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+const size_t SendQueue::DEFAULT_MAX_QUEUE;
+
+SendQueue::Config::Config( const size_t maxQueue ) :
+    maxQueue(maxQueue)
+{
+    limits[REPLY]       = Limits{0,0};
+    limits[LOOKUP]      = Limits{200,50};
+    limits[MAINTENANCE] = Limits{50,10};
+}
+
+SendQueue::SendQueue( const Config& config ) :
+    _config(config),
+    _size(0)
+{
+    const clock::time_point now = clock::now();
+    for( size_t i = 0; i < CLASS_COUNT; ++i )
+    {
+        _buckets[i].tokens = _config.limits[i].burst;
+        _buckets[i].last   = now;
+    }
+}
+
+bool SendQueue::push(
+    const class_t cls,
+    const Buffer& buffer,
+    const endpoint_t& destination )
+{
+    if (_size >= _config.maxQueue)
+    {
+        // the lowest class below this one pays for it
+        size_t victim = CLASS_COUNT-1;
+        while (victim > static_cast<size_t>(cls) && _queues[victim].empty())
+            --victim;
+
+        if (victim == static_cast<size_t>(cls))
+        {
+            ++_counters[cls].dropped;
+            return false;
+        }
+
+        _queues[victim].pop_back();
+        ++_counters[victim].dropped;
+        --_counters[victim].depth;
+        --_size;
+    }
+
+    _queues[cls].push_back(Datagram{buffer,destination});
+    Counters& counters = _counters[cls];
+    ++counters.queued;
+    ++counters.depth;
+    counters.maxDepth = std::max(counters.maxDepth,counters.depth);
+    ++_size;
+    return true;
+}
+
+double SendQueue::tokens(
+    const class_t cls,
+    const clock::time_point now ) const noexcept
+{
+    const Limits& limits = _config.limits[cls];
+    const Bucket& bucket = _buckets[cls];
+    const std::chrono::duration<double> elapsed = now - bucket.last;
+    return std::min(limits.burst,
+        bucket.tokens + std::max(elapsed.count(),0.0)*limits.rate);
+}
+
+bool SendQueue::pop(
+    Datagram& out,
+    const clock::time_point now )
+{
+    for( size_t i = 0; i < CLASS_COUNT; ++i )
+    {
+        const class_t cls = static_cast<class_t>(i);
+        if (_queues[cls].empty())
+            continue;
+
+        if (_config.limits[cls].rate > 0)
+        {
+            const double available = tokens(cls,now);
+            if (available < 1)
+                continue;
+            _buckets[cls].tokens = available-1;
+            _buckets[cls].last   = now;
+        }
+
+        out = std::move(_queues[cls].front());
+        _queues[cls].pop_front();
+        ++_counters[cls].sent;
+        --_counters[cls].depth;
+        --_size;
+        return true;
+    }
+    return false;
+}
+
+SendQueue::clock::duration SendQueue::nextReady(
+    const clock::time_point now ) const noexcept
+{
+    clock::duration next = clock::duration::max();
+    for( size_t i = 0; i < CLASS_COUNT; ++i )
+    {
+        const class_t cls = static_cast<class_t>(i);
+        if (_queues[cls].empty())
+            continue;
+
+        const double rate = _config.limits[cls].rate;
+        const double missing = rate > 0 ? 1-tokens(cls,now) : 0;
+        if (missing <= 0)
+            return clock::duration::zero();
+
+        // rounded up, to wake up once the token is there
+        const std::chrono::duration<double> wait(missing/rate);
+        next = std::min(next,
+            std::chrono::duration_cast<clock::duration>(wait)+clock::duration(1));
+    }
+    return next;
+}
+
+const char* SendQueue::classToString( const class_t cls ) noexcept
+{
+    switch (cls)
+    {
+    case REPLY:       return "reply";
+    case LOOKUP:      return "lookup";
+    case MAINTENANCE: return "maintenance";
+    default:          return "unknown";
+    }
+}
+
+}; // utils
+}; // torrentsync
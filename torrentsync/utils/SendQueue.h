@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <torrentsync/utils/Buffer.h>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Queue of the datagrams to send, split in traffic classes.
+ * The classes are served in priority order, each one limited by a token
+ * bucket: a datagram over the rate of its class waits in the queue. Once
+ * the queue is full a datagram makes room dropping the newest one of a
+ * lower class, so under bursts the maintenance is delayed and dropped
+ * before the replies.
+ * Not thread safe.
+ */
+class SendQueue : public boost::noncopyable
+{
+public:
+    typedef std::chrono::steady_clock clock;
+    typedef boost::asio::ip::udp::endpoint endpoint_t;
+
+    //! the traffic classes, the highest priority first
+    enum class_t
+    {
+        REPLY = 0,   //!< replies to the queries of the other nodes
+        LOOKUP,      //!< our own searches
+        MAINTENANCE, //!< pings and refreshes of the table
+        CLASS_COUNT
+    };
+
+    //! default limit of the datagrams waiting in the queue
+    static const size_t DEFAULT_MAX_QUEUE = 100;
+
+    struct Datagram
+    {
+        Buffer     buffer;
+        endpoint_t destination;
+    };
+
+    //! the token bucket of a class
+    struct Limits
+    {
+        //! datagrams per second, 0 for no limit
+        double rate;
+
+        //! datagrams sent at once after being idle, at least 1 if limited
+        double burst;
+    };
+
+    struct Config
+    {
+        //! default limits, replies are not limited
+        explicit Config( const size_t maxQueue = DEFAULT_MAX_QUEUE );
+
+        //! datagrams waiting in all the classes
+        size_t maxQueue;
+
+        //! limits of every class, by class_t
+        std::array<Limits,CLASS_COUNT> limits;
+    };
+
+    struct Counters
+    {
+        //! datagrams accepted in the queue
+        size_t queued   = 0;
+
+        //! datagrams taken from the queue to be sent
+        size_t sent     = 0;
+
+        //! datagrams refused, or removed to make room for another class
+        size_t dropped  = 0;
+
+        //! datagrams waiting
+        size_t depth    = 0;
+
+        //! the largest depth reached
+        size_t maxDepth = 0;
+    };
+
+    explicit SendQueue( const Config& config = Config() );
+
+    /** queues a datagram. When the queue is full the newest datagram of the
+     * lowest class lower than this one is dropped to make room, if any.
+     * @return false if the datagram was dropped instead
+     */
+    bool push(
+        const class_t cls,
+        const Buffer& buffer,
+        const endpoint_t& destination );
+
+    /** takes the next datagram allowed by the limits, the highest class first
+     * @param out the datagram
+     * @param now the current time
+     * @return false if none can be sent now
+     */
+    bool pop(
+        Datagram& out,
+        const clock::time_point now );
+
+    //! @return how long before a datagram can be sent, zero if now,
+    //!         duration::max() if the queue is empty
+    clock::duration nextReady( const clock::time_point now ) const noexcept;
+
+    //! @return datagrams waiting in every class
+    size_t size() const noexcept { return _size; }
+
+    bool empty() const noexcept { return _size == 0; }
+
+    const Counters& getCounters( const class_t cls ) const noexcept { return _counters[cls]; }
+
+    const Config& getConfig() const noexcept { return _config; }
+
+    static const char* classToString( const class_t cls ) noexcept;
+
+private:
+
+    //! tokens of a class at a time, refilled at the rate
+    struct Bucket
+    {
+        double            tokens;
+        clock::time_point last;
+    };
+
+    //! @return the tokens of the class at now
+    double tokens(
+        const class_t cls,
+        const clock::time_point now ) const noexcept;
+
+    const Config _config;
+
+    std::array<std::deque<Datagram>,CLASS_COUNT> _queues;
+
+    std::array<Bucket,CLASS_COUNT> _buckets;
+
+    std::array<Counters,CLASS_COUNT> _counters;
+
+    size_t _size;
+};
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,89 @@
+#include <torrentsync/utils/SlabPool.h>
+
+#include <algorithm>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+const size_t SlabPool::SLAB_SIZE = 64*1024;
+
+//! rounds up size to a multiple of alignment
+static size_t roundUp( const size_t size, const size_t alignment ) noexcept
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+SlabPool::SlabPool(
+    const size_t slotSize,
+    const size_t alignment,
+    const size_t slabSize ) :
+        _slotSize(roundUp(std::max(slotSize,sizeof(FreeSlot)),
+            std::max(alignment,alignof(FreeSlot)))),
+        _slotsPerSlab(std::max<size_t>(slabSize/_slotSize,1)),
+        _free(nullptr),
+        _used(0)
+{
+}
+
+SlabPool::~SlabPool()
+{
+    for( void* slab : _slabs )
+        ::operator delete(slab);
+}
+
+void* SlabPool::allocate()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_free)
+        grow();
+
+    FreeSlot* const slot = _free;
+    _free = slot->next;
+    ++_used;
+    return slot;
+}
+
+void SlabPool::deallocate( void* slot ) noexcept
+{
+    if (!slot)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    FreeSlot* const free = static_cast<FreeSlot*>(slot);
+    free->next = _free;
+    _free = free;
+    --_used;
+}
+
+void SlabPool::grow()
+{
+    _slabs.reserve(_slabs.size()+1);
+    uint8_t* const slab = static_cast<uint8_t*>(
+        ::operator new(_slotsPerSlab*_slotSize));
+    _slabs.push_back(slab);
+
+    // linked in address order, the first allocations are sequential
+    for( size_t i = _slotsPerSlab; i > 0; --i )
+    {
+        FreeSlot* const slot = reinterpret_cast<FreeSlot*>(slab + (i-1)*_slotSize);
+        slot->next = _free;
+        _free = slot;
+    }
+}
+
+size_t SlabPool::used() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _used;
+}
+
+size_t SlabPool::capacity() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slabs.size()*_slotsPerSlab;
+}
+
+}; // utils
+}; // torrentsync
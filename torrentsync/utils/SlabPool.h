@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Pool of fixed size slots.
+ * The slots are carved from large slabs and recycled through a free list,
+ * so an allocation costs neither a call to the system allocator nor its
+ * per-block header. The slabs are kept until the pool is destroyed.
+ * Thread safe.
+ */
+class SlabPool : public boost::noncopyable
+{
+public:
+    //! default size of a slab
+    static const size_t SLAB_SIZE;
+
+    /** Constructor
+     * @param slotSize size of the slots, rounded up to the alignment
+     * @param alignment of the slots, at most alignof(std::max_align_t)
+     * @param slabSize size of the slabs, at least one slot
+     */
+    SlabPool(
+        const size_t slotSize,
+        const size_t alignment = alignof(std::max_align_t),
+        const size_t slabSize = SLAB_SIZE );
+
+    ~SlabPool();
+
+    //! @return a slot
+    //! @throws std::bad_alloc
+    void* allocate();
+
+    //! returns a slot to the pool
+    void deallocate( void* slot ) noexcept;
+
+    //! @return the size of the slots
+    size_t slotSize() const noexcept { return _slotSize; }
+
+    //! @return the slots in use
+    size_t used() const noexcept;
+
+    //! @return the slots reserved in the slabs
+    size_t capacity() const noexcept;
+
+    /** The pool shared by every allocation of the same size and alignment.
+     * Never destroyed, the slots can be released at any time.
+     */
+    template <size_t SlotSize, size_t Alignment>
+    static SlabPool& instance()
+    {
+        static_assert(Alignment <= alignof(std::max_align_t),
+            "Over-aligned slots are not supported");
+        static SlabPool* const pool = new SlabPool(SlotSize,Alignment);
+        return *pool;
+    }
+
+private:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    //! allocates a new slab, adding its slots to the free list
+    void grow();
+
+    mutable std::mutex _mutex;
+
+    const size_t _slotSize;
+    const size_t _slotsPerSlab;
+
+    FreeSlot* _free;
+    std::vector<void*> _slabs;
+    size_t _used;
+};
+
+/** Standard allocator taking the single objects from the SlabPool of their
+ * size, e.g. for std::allocate_shared which puts the object and its
+ * reference counts in a single slot.
+ */
+template <class T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    PoolAllocator() noexcept {}
+
+    template <class U>
+    PoolAllocator( const PoolAllocator<U>& ) noexcept {}
+
+    T* allocate( const size_t n )
+    {
+        if (n != 1)
+            return static_cast<T*>(::operator new(n*sizeof(T)));
+        return static_cast<T*>(pool().allocate());
+    }
+
+    void deallocate( T* p, const size_t n ) noexcept
+    {
+        if (n != 1)
+            ::operator delete(p);
+        else
+            pool().deallocate(p);
+    }
+
+    //! @return the pool of the allocator
+    static SlabPool& pool() { return SlabPool::instance<sizeof(T),alignof(T)>(); }
+};
+
+template <class T, class U>
+bool operator==( const PoolAllocator<T>&, const PoolAllocator<U>& ) noexcept { return true; }
+
+template <class T, class U>
+bool operator!=( const PoolAllocator<T>&, const PoolAllocator<U>& ) noexcept { return false; }
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,256 @@
+#include <torrentsync/utils/TimerWheel.h>
+
+#include <algorithm>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+const TimerWheel::duration TimerWheel::TICK = std::chrono::milliseconds(100);
+
+const size_t   TimerWheel::SLOT_BITS;
+const size_t   TimerWheel::SLOTS;
+const size_t   TimerWheel::LEVELS;
+const uint64_t TimerWheel::MAX_TICKS;
+const uint32_t TimerWheel::NIL;
+
+TimerWheel::TimerWheel(
+    boost::asio::io_service& io_service,
+    const duration& tick ) :
+        _now(0),
+        _size(0),
+        _tick(tick),
+        _timer(io_service),
+        _started(false)
+{
+    _slots.fill(NIL);
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+TimerWheel::handle_t TimerWheel::schedule(
+    const duration& delay,
+    const callback_t& callback )
+{
+    // expires at the ticks-th tick from now, _now being the next one
+    uint64_t ticks = delay <= duration::zero() ? 1 :
+        static_cast<uint64_t>((delay + _tick - duration(1)) / _tick);
+    ticks = std::min(ticks,MAX_TICKS);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    uint32_t index;
+    if (_free.empty())
+    {
+        index = static_cast<uint32_t>(_entries.size());
+        _entries.push_back(Entry());
+        _entries.back().generation = 0;
+    }
+    else
+    {
+        index = _free.back();
+        _free.pop_back();
+    }
+
+    Entry& entry = _entries[index];
+    entry.deadline = _now + ticks - 1;
+    entry.callback = callback;
+    link(index);
+    ++_size;
+
+    return (static_cast<handle_t>(entry.generation) << 32) | (index+1);
+}
+
+bool TimerWheel::cancel( const handle_t handle ) noexcept
+{
+    const uint32_t index      = static_cast<uint32_t>(handle) - 1;
+    const uint32_t generation = static_cast<uint32_t>(handle >> 32);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (index >= _entries.size())
+        return false;
+
+    const Entry& entry = _entries[index];
+    if (entry.slot == NIL || entry.generation != generation)
+        return false;
+
+    unlink(index);
+    release(index);
+    return true;
+}
+
+void TimerWheel::link( const uint32_t index ) noexcept
+{
+    Entry& entry = _entries[index];
+    entry.deadline = std::max(entry.deadline,_now);
+
+    // the level is chosen by how far the deadline is, the slot by the
+    // deadline itself so that it doesn't move until cascaded
+    const uint64_t delta = entry.deadline - _now;
+    size_t level = 0;
+    while (level < LEVELS-1 && delta >= (static_cast<uint64_t>(1) << (SLOT_BITS*(level+1))))
+        ++level;
+
+    const size_t slot = level*SLOTS +
+        ((entry.deadline >> (SLOT_BITS*level)) & (SLOTS-1));
+
+    entry.slot = static_cast<uint32_t>(slot);
+    entry.prev = NIL;
+    entry.next = _slots[slot];
+    if (entry.next != NIL)
+        _entries[entry.next].prev = index;
+    _slots[slot] = index;
+}
+
+void TimerWheel::unlink( const uint32_t index ) noexcept
+{
+    Entry& entry = _entries[index];
+    if (entry.prev == NIL)
+        _slots[entry.slot] = entry.next;
+    else
+        _entries[entry.prev].next = entry.next;
+
+    if (entry.next != NIL)
+        _entries[entry.next].prev = entry.prev;
+}
+
+void TimerWheel::release( const uint32_t index ) noexcept
+{
+    Entry& entry = _entries[index];
+    entry.callback = nullptr;
+    entry.slot = NIL;
+    ++entry.generation;
+    _free.push_back(index);
+    --_size;
+}
+
+size_t TimerWheel::cascade( const size_t level ) noexcept
+{
+    const size_t index = (_now >> (SLOT_BITS*level)) & (SLOTS-1);
+
+    uint32_t it = _slots[level*SLOTS + index];
+    _slots[level*SLOTS + index] = NIL;
+    while (it != NIL)
+    {
+        const uint32_t next = _entries[it].next;
+        link(it);
+        it = next;
+    }
+    return index;
+}
+
+void TimerWheel::tick( std::vector<callback_t>& expired )
+{
+    const size_t index = _now & (SLOTS-1);
+
+    // when a wheel wraps around the next slot of the upper one is moved down
+    if (index == 0)
+    {
+        for( size_t level = 1; level < LEVELS && cascade(level) == 0; ++level )
+            ;
+    }
+
+    uint32_t it = _slots[index];
+    _slots[index] = NIL;
+    while (it != NIL)
+    {
+        const uint32_t next = _entries[it].next;
+        expired.push_back(std::move(_entries[it].callback));
+        release(it);
+        it = next;
+    }
+
+    ++_now;
+}
+
+size_t TimerWheel::advance( const uint64_t ticks )
+{
+    size_t count = 0;
+    std::vector<callback_t> expired;
+
+    for( uint64_t i = 0; i < ticks; ++i )
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            // nothing to cascade or expire, skip the remaining ticks
+            if (_size == 0)
+            {
+                _now += ticks-i;
+                break;
+            }
+            tick(expired);
+        }
+
+        for( callback_t& callback : expired )
+            callback();
+        count += expired.size();
+        expired.clear();
+    }
+
+    return count;
+}
+
+void TimerWheel::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_started)
+        return;
+
+    _started = true;
+    _last = std::chrono::steady_clock::now();
+    arm();
+}
+
+void TimerWheel::stop()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _started = false;
+    _timer.cancel();
+}
+
+void TimerWheel::arm()
+{
+    _timer.expires_at(_last + _tick);
+    _timer.async_wait([this]( const boost::system::error_code& e ) {
+        if (e == boost::asio::error::operation_aborted)
+            return;
+
+        uint64_t elapsed;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_started)
+                return;
+
+            // the ticks lost while the io_service was busy are caught up
+            elapsed = (std::chrono::steady_clock::now() - _last) / _tick;
+            _last += elapsed * _tick;
+        }
+
+        advance(elapsed);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_started)
+            arm();
+    });
+}
+
+size_t TimerWheel::size() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _size;
+}
+
+uint64_t TimerWheel::now() const noexcept
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _now;
+}
+
+}; // utils
+}; // torrentsync
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace torrentsync
+{
+namespace utils
+{
+
+/** Hierarchical timing wheel.
+ * The timers are kept in LEVELS wheels of SLOTS slots, every level counting
+ * SLOTS times slower than the one below; a timer sits in the slot of the
+ * level matching how far its deadline is and is moved down a level when
+ * the lower wheel wraps around. Scheduling, cancelling and expiring a timer
+ * are O(1), whatever the number of timers.
+ * Once started it ticks on the io_service, the callbacks are called from
+ * there and must not throw. Thread safe, the callbacks are called without
+ * locks held so they can schedule and cancel timers.
+ */
+class TimerWheel : public boost::noncopyable
+{
+public:
+    typedef std::function<void ()> callback_t;
+
+    //! identifies a scheduled timer, never 0
+    typedef uint64_t handle_t;
+
+    typedef std::chrono::steady_clock::duration duration;
+
+    //! default duration of a tick
+    static const duration TICK;
+
+    static const size_t SLOT_BITS = 6;
+    static const size_t SLOTS     = 1 << SLOT_BITS;
+    static const size_t LEVELS    = 4;
+
+    //! the farthest deadline in ticks, longer delays are shortened to it
+    static const uint64_t MAX_TICKS = (static_cast<uint64_t>(1) << (SLOT_BITS*LEVELS)) - 1;
+
+    /** Constructor
+     * @param io_service where the wheel ticks once started
+     * @param tick the resolution of the timers
+     */
+    TimerWheel(
+        boost::asio::io_service& io_service,
+        const duration& tick = TICK );
+
+    ~TimerWheel();
+
+    /** schedules a callback
+     * @param delay from now, rounded up to ticks. The timer expires with
+     *        the tick it falls in, so up to a tick early.
+     * @param callback called once after the delay
+     * @return the handle to cancel the timer
+     */
+    handle_t schedule(
+        const duration& delay,
+        const callback_t& callback );
+
+    /** cancels a timer
+     * @return false if the timer already expired or was cancelled
+     */
+    bool cancel( const handle_t handle ) noexcept;
+
+    //! starts ticking on the io_service
+    void start();
+
+    //! stops ticking, the timers are kept
+    void stop();
+
+    /** moves the time forward, calling the expired callbacks
+     * Called by the io_service timer, useful alone for testing.
+     * @param ticks number of ticks elapsed
+     * @return the number of callbacks called
+     */
+    size_t advance( const uint64_t ticks );
+
+    //! @return the number of scheduled timers
+    size_t size() const noexcept;
+
+    //! @return the ticks elapsed since the creation
+    uint64_t now() const noexcept;
+
+private:
+
+    static const uint32_t NIL = UINT32_MAX;
+
+    struct Entry
+    {
+        uint64_t   deadline;
+        callback_t callback;
+        uint32_t   prev;
+        uint32_t   next;
+        uint32_t   generation;
+        uint32_t   slot;  //!< index in _slots, NIL if free
+    };
+
+    //! places the entry in the slot for its deadline
+    void link( const uint32_t index ) noexcept;
+
+    //! removes the entry from its slot
+    void unlink( const uint32_t index ) noexcept;
+
+    //! releases the entry, invalidating its handle
+    void release( const uint32_t index ) noexcept;
+
+    //! processes the current tick, appending the expired callbacks
+    void tick( std::vector<callback_t>& expired );
+
+    //! moves the timers of the slot of a level to the lower levels
+    //! @return the slot index in the level
+    size_t cascade( const size_t level ) noexcept;
+
+    //! arms the io_service timer for the next tick
+    void arm();
+
+    mutable std::mutex _mutex;
+
+    std::vector<Entry>    _entries;
+    std::vector<uint32_t> _free;
+
+    //! heads of the lists of every slot, level after level
+    std::array<uint32_t,SLOTS*LEVELS> _slots;
+
+    //! the next tick to process
+    uint64_t _now;
+
+    size_t _size;
+
+    const duration _tick;
+
+    boost::asio::steady_timer _timer;
+    bool _started;
+
+    //! time of the last processed tick
+    std::chrono::steady_clock::time_point _last;
+};
+
+}; // utils
+}; // torrentsync
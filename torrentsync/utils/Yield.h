@@ -1,6 +1,8 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <functional>
+#include <iterator>
 #include <type_traits>
 
 namespace torrentsync
@@ -23,7 +25,7 @@ class Yield
 {
 public:
     typedef Iterator                            iterator_type;
-    typedef typename iterator_type::value_type  in_type;
+    typedef typename std::iterator_traits<iterator_type>::value_type in_type;
 
     typedef typename std::conditional<
         std::is_same<OutputType,void>::value,
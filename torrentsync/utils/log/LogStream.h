@@ -1,6 +1,7 @@
 #pragma once
 
 #include <torrentsync/utils/log/Log.h>
+#include <torrentsync/utils/Buffer.h>
 
 #include <assert.h>
 #include <boost/foreach.hpp>
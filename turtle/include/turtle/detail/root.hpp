@@ -13,7 +13,7 @@
 #include "group.hpp"
 #include "context.hpp"
 #include "child.hpp"
-#include <boost/test/utils/trivial_singleton.hpp>
+#include <boost/test/detail/global_typedef.hpp>
 #include <boost/optional.hpp>
 #include <ostream>
 #include <map>
@@ -22,7 +22,7 @@ namespace mock
 {
 namespace detail
 {
-    class root_t : public boost::unit_test::singleton< root_t >, public context
+    class root_t : public context
     {
     public:
         virtual void add( const void* p, verifiable& v,
@@ -122,6 +122,11 @@ namespace detail
     private:
         BOOST_TEST_SINGLETON_CONS( root_t );
     };
+    inline root_t& root_t::instance()
+    {
+        static root_t the_inst;
+        return the_inst;
+    }
     BOOST_TEST_SINGLETON_INST( root )
 }
 } // mock
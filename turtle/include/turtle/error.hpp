@@ -39,7 +39,7 @@ namespace mock
         static void fail( const char* message, const Context& context,
             const char* file = "unknown location", int line = 0 )
         {
-            boost::unit_test::framework::assertion_result( false );
+            boost::unit_test::framework::assertion_result( boost::unit_test::AR_FAILED );
             boost::unit_test::unit_test_log
                 << boost::unit_test::log::begin( file,
                     static_cast< std::size_t >( line ) )
@@ -51,7 +51,7 @@ namespace mock
         template< typename Context >
         static void call( const Context& context, const char* file, int line )
         {
-            boost::unit_test::framework::assertion_result( true );
+            boost::unit_test::framework::assertion_result( boost::unit_test::AR_PASSED );
             boost::unit_test::unit_test_log
                 << boost::unit_test::log::begin( file,
                     static_cast< std::size_t >( line ) )